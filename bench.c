@@ -0,0 +1,330 @@
+/*!
+    @file bench.c
+
+    @brief Times every operation in linearalgebra.h over a range of sizes on the GPU, the CPU backend and the automatic dispatch
+
+    @details
+    Usage: bench [--runs n] [--max-side n] [--csv path] [--json path]
+
+    Every row gives the average time of a run, GFLOP/s, the bytes the operation reads and writes per second and, for the GPU, how much of a run was spent on copies to the GPU, kernels and copies back as recorded by the profiler.
+    The rest of a run is launch overhead, the time spent enqueueing, waiting for the driver and between commands.
+    Without --csv the CSV is written to stdout.
+    Building with LINEARALGEBRA_BENCH_BLAS adds rows for cblas_sgemm and cblas_sgemv as a baseline.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <CL/cl.h>
+#include <linearalgebra.h>
+#ifdef LINEARALGEBRA_BENCH_BLAS
+#include <cblas.h>
+#endif
+
+/*!
+    @brief Runs of every operation that are not timed so buffers, kernels and the cost model are ready before timing starts
+*/
+#define BENCH_WARMUP_RUNS 2
+/*!
+    @brief Most profiler groups one benchmark can record
+*/
+#define BENCH_MAX_STATS 64
+
+typedef enum
+{
+    BENCH_SHAPES,
+    BENCH_DOT,
+    BENCH_GEMM,
+    BENCH_MATVEC
+} BenchKind;
+typedef struct
+{
+    const char *name;
+    BenchKind kind;
+    void (*shapes)(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c);
+} BenchOp;
+typedef struct
+{
+    const char *name;
+    DispatchMode mode;
+} BenchBackend;
+/*!
+    @brief One line of the results
+*/
+typedef struct
+{
+    const char *backend;
+    const char *op;
+    unsigned int r;
+    unsigned int c;
+    unsigned int c2;
+    unsigned int runs;
+    double mean;
+    double min;
+    double gflops;
+    double gbps;
+    double upload;
+    double kernel;
+    double download;
+    double overhead;
+} BenchResult;
+
+static const BenchOp ops[] = {
+    {"addShapesF", BENCH_SHAPES, addShapesF},
+    {"subtractShapesF", BENCH_SHAPES, subtractShapesF},
+    {"crossShapesF", BENCH_SHAPES, crossShapesF},
+    {"divideShapesF", BENCH_SHAPES, divideShapesF},
+    {"dotMatricesF", BENCH_DOT, NULL},
+    {"gemmF", BENCH_GEMM, NULL},
+    {"matVecF", BENCH_MATVEC, NULL}};
+static const BenchBackend backends[] = {
+    {"gpu", DISPATCH_GPU},
+    {"cpu", DISPATCH_CPU},
+    {"auto", DISPATCH_AUTO}};
+
+/*!
+    @brief Gives the time in milliseconds from an unspecified start
+*/
+static double now()
+{
+    struct timespec t;
+    timespec_get(&t, TIME_UTC);
+    return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+/*!
+    @brief Runs an operation once on an r by c shape, c2 is the columns of the second matrix of a dot product
+*/
+static void runOp(const BenchOp *op, const char *backend, const float *a, const float *b, float *out, const unsigned int r, const unsigned int c, const unsigned int c2)
+{
+#ifdef LINEARALGEBRA_BENCH_BLAS
+    if (strcmp(backend, "blas") == 0)
+    {
+        if (op->kind == BENCH_DOT || op->kind == BENCH_GEMM)
+        {
+            cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, r, c2, c, 1.0f, a, c, b, c2, 0.0f, out, c2);
+        }
+        else
+        {
+            cblas_sgemv(CblasRowMajor, CblasNoTrans, r, c, 1.0f, a, c, b, 1, 0.0f, out, 1);
+        }
+        return;
+    }
+#else
+    (void)backend;
+#endif
+    if (op->kind == BENCH_SHAPES)
+    {
+        op->shapes(a, b, out, r, c);
+    }
+    else if (op->kind == BENCH_DOT)
+    {
+        dotMatricesF(a, b, out, r, c, c2);
+    }
+    else if (op->kind == BENCH_GEMM)
+    {
+        /* A dense layer, the first row of b is the bias */
+        gemmF(a, b, out, r, c, c2, 1.0f, 0.0f, b, ACTIVATION_RELU);
+    }
+    else
+    {
+        matVecF(a, b, out, r, c);
+    }
+}
+/*!
+    @brief Times an operation on one size and fills in a result
+*/
+static void benchOp(const BenchOp *op, const char *backend, const int profile, const float *a, const float *b, float *out, const unsigned int r, const unsigned int c, const unsigned int c2, const unsigned int runs, BenchResult *result)
+{
+    for (unsigned int i = 0; i < BENCH_WARMUP_RUNS; i++)
+    {
+        runOp(op, backend, a, b, out, r, c, c2);
+    }
+    if (profile)
+    {
+        clearProfiler();
+        startProfiler();
+    }
+    double total = 0;
+    double min = 0;
+    for (unsigned int i = 0; i < runs; i++)
+    {
+        const double start = now();
+        runOp(op, backend, a, b, out, r, c, c2);
+        const double time = now() - start;
+        total += time;
+        min = i == 0 || time < min ? time : min;
+    }
+    memset(result, 0, sizeof(BenchResult));
+    result->backend = backend;
+    result->op = op->name;
+    result->r = r;
+    result->c = c;
+    result->c2 = op->kind == BENCH_DOT || op->kind == BENCH_GEMM ? c2 : op->kind == BENCH_MATVEC ? 1 : 0;
+    result->runs = runs;
+    result->mean = total / runs;
+    result->min = min;
+    double flops = (double)r * c;
+    double bytes = sizeof(float) * 3.0 * r * c;
+    if (op->kind == BENCH_DOT || op->kind == BENCH_GEMM)
+    {
+        flops = 2.0 * r * c * c2;
+        bytes = sizeof(float) * ((double)r * c + (double)c * c2 + (double)r * c2);
+    }
+    else if (op->kind == BENCH_MATVEC)
+    {
+        flops = 2.0 * r * c;
+        bytes = sizeof(float) * ((double)r * c + c + r);
+    }
+    result->gflops = flops / (result->mean * 1e6);
+    result->gbps = bytes / (result->mean * 1e6);
+    if (profile)
+    {
+        stopProfiler();
+        ProfileStats stats[BENCH_MAX_STATS];
+        unsigned int count = getProfileStats(stats, BENCH_MAX_STATS);
+        count = count < BENCH_MAX_STATS ? count : BENCH_MAX_STATS;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            double *field = stats[i].kind == PROFILE_UPLOAD ? &result->upload : stats[i].kind == PROFILE_KERNEL ? &result->kernel : &result->download;
+            *field += stats[i].total / runs;
+        }
+        clearProfiler();
+        const double busy = result->upload + result->kernel + result->download;
+        result->overhead = result->mean > busy ? result->mean - busy : 0;
+    }
+}
+static void writeCsv(FILE *file, const BenchResult *results, const unsigned int count)
+{
+    fprintf(file, "backend,op,r,c,c2,runs,mean_ms,min_ms,gflops,gbps,upload_ms,kernel_ms,download_ms,overhead_ms\n");
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const BenchResult *b = &results[i];
+        fprintf(file, "%s,%s,%u,%u,%u,%u,%.6f,%.6f,%.3f,%.3f,%.6f,%.6f,%.6f,%.6f\n", b->backend, b->op, b->r, b->c, b->c2, b->runs, b->mean, b->min, b->gflops, b->gbps, b->upload, b->kernel, b->download, b->overhead);
+    }
+}
+static void writeJson(FILE *file, const BenchResult *results, const unsigned int count)
+{
+    fprintf(file, "[\n");
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const BenchResult *b = &results[i];
+        fprintf(file, "  {\"backend\": \"%s\", \"op\": \"%s\", \"r\": %u, \"c\": %u, \"c2\": %u, \"runs\": %u, \"mean_ms\": %.6f, \"min_ms\": %.6f, \"gflops\": %.3f, \"gbps\": %.3f, \"upload_ms\": %.6f, \"kernel_ms\": %.6f, \"download_ms\": %.6f, \"overhead_ms\": %.6f}%s\n",
+                b->backend, b->op, b->r, b->c, b->c2, b->runs, b->mean, b->min, b->gflops, b->gbps, b->upload, b->kernel, b->download, b->overhead, i + 1 < count ? "," : "");
+    }
+    fprintf(file, "]\n");
+}
+/*!
+    @brief Gives the smallest side of the square shapes an operation is timed on, the sides double up to the largest
+*/
+static unsigned int firstSide(const BenchKind kind)
+{
+    return kind == BENCH_DOT || kind == BENCH_GEMM ? 64 : 128;
+}
+/*!
+    @brief Gives the largest side of the square shapes an operation is timed on
+*/
+static unsigned int lastSide(const BenchKind kind, const unsigned int max_side)
+{
+    const unsigned int side = kind == BENCH_DOT || kind == BENCH_GEMM ? 2048 : 4096;
+    return side < max_side ? side : max_side;
+}
+int main(int argc, char **argv)
+{
+    unsigned int runs = 10;
+    unsigned int max_side = 4096;
+    const char *csv_path = NULL;
+    const char *json_path = NULL;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--runs") == 0)
+        {
+            runs = (unsigned int)atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--max-side") == 0)
+        {
+            max_side = (unsigned int)atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--csv") == 0)
+        {
+            csv_path = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--json") == 0)
+        {
+            json_path = argv[i + 1];
+        }
+    }
+    runs = runs > 0 ? runs : 1;
+    gpuInit();
+    const size_t max_elements = (size_t)max_side * max_side;
+    float *a = createAlignedShapeF((unsigned int)max_elements, 0);
+    float *b = createAlignedShapeF((unsigned int)max_elements, 0);
+    float *out = createAlignedShapeF((unsigned int)max_elements, 0);
+    for (size_t i = 0; i < max_elements; i++)
+    {
+        a[i] = (float)(i % 17) * 0.25f - 2.0f;
+        b[i] = (float)(i % 13) * 0.5f + 1.0f;
+    }
+    const unsigned int op_count = sizeof(ops) / sizeof(ops[0]);
+    const unsigned int backend_count = sizeof(backends) / sizeof(backends[0]);
+    unsigned int capacity = 64;
+    unsigned int count = 0;
+    BenchResult *results = malloc(sizeof(BenchResult) * capacity);
+    for (unsigned int i = 0; i < op_count; i++)
+    {
+        for (unsigned int side = firstSide(ops[i].kind); side <= lastSide(ops[i].kind, max_side); side *= 2)
+        {
+            for (unsigned int j = 0; j < backend_count + 1; j++)
+            {
+                const char *backend = j < backend_count ? backends[j].name : "blas";
+#ifndef LINEARALGEBRA_BENCH_BLAS
+                if (j == backend_count)
+                {
+                    continue;
+                }
+#endif
+                if ((j == backend_count && ops[i].kind == BENCH_SHAPES) || (j < backend_count && backends[j].mode != DISPATCH_CPU && !gpuFound()))
+                {
+                    continue;
+                }
+                if (j < backend_count)
+                {
+                    setDispatchMode(backends[j].mode);
+                }
+                if (count == capacity)
+                {
+                    capacity *= 2;
+                    results = realloc(results, sizeof(BenchResult) * capacity);
+                }
+                benchOp(&ops[i], backend, j < backend_count && backends[j].mode == DISPATCH_GPU, a, b, out, side, side, side, runs, &results[count]);
+                fprintf(stderr, "%s %s %ux%u: %.3f ms, %.2f GFLOP/s\n", backend, ops[i].name, side, side, results[count].mean, results[count].gflops);
+                count++;
+            }
+        }
+    }
+    setDispatchMode(DISPATCH_AUTO);
+    FILE *csv = csv_path != NULL ? fopen(csv_path, "w") : stdout;
+    if (csv != NULL)
+    {
+        writeCsv(csv, results, count);
+        if (csv != stdout)
+        {
+            fclose(csv);
+        }
+    }
+    if (json_path != NULL)
+    {
+        FILE *json = fopen(json_path, "w");
+        if (json != NULL)
+        {
+            writeJson(json, results, count);
+            fclose(json);
+        }
+    }
+    free(results);
+    freeAlignedShapeF(a);
+    freeAlignedShapeF(b);
+    freeAlignedShapeF(out);
+    gpuClean();
+    return 0;
+}
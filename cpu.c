@@ -0,0 +1,1043 @@
+/*!
+    @file cpu.c
+*/
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <CL/cl.h>
+#include <linearalgebra.h>
+#include <cpu.h>
+
+/*!
+    @brief The AVX2 and FMA loops are compiled on their own with CPU_AVX2 and only run if cpuInit() finds that the processor supports them, so the library still runs on x86 processors without them
+*/
+#if defined(LINEARALGEBRA_AVX2) && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CPU_HAS_AVX2_LOOPS
+#define CPU_AVX2 __attribute__((target("avx2,fma")))
+#include <immintrin.h>
+#elif defined(LINEARALGEBRA_AVX2) && (defined(_M_X64) || defined(_M_IX86)) && defined(_MSC_VER)
+#define CPU_HAS_AVX2_LOOPS
+#define CPU_AVX2
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE CpuThread;
+typedef CRITICAL_SECTION CpuMutex;
+typedef CONDITION_VARIABLE CpuCond;
+#define cpuMutexInit(m) InitializeCriticalSection(m)
+#define cpuMutexDestroy(m) DeleteCriticalSection(m)
+#define cpuLock(m) EnterCriticalSection(m)
+#define cpuUnlock(m) LeaveCriticalSection(m)
+#define cpuCondInit(c) InitializeConditionVariable(c)
+#define cpuCondDestroy(c)
+#define cpuWait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define cpuWakeAll(c) WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+#include <unistd.h>
+typedef pthread_t CpuThread;
+typedef pthread_mutex_t CpuMutex;
+typedef pthread_cond_t CpuCond;
+#define cpuMutexInit(m) pthread_mutex_init(m, NULL)
+#define cpuMutexDestroy(m) pthread_mutex_destroy(m)
+#define cpuLock(m) pthread_mutex_lock(m)
+#define cpuUnlock(m) pthread_mutex_unlock(m)
+#define cpuCondInit(c) pthread_cond_init(c, NULL)
+#define cpuCondDestroy(c) pthread_cond_destroy(c)
+#define cpuWait(c, m) pthread_cond_wait(c, m)
+#define cpuWakeAll(c) pthread_cond_broadcast(c)
+#endif
+
+/*!
+    @brief Most threads the CPU backend will start
+*/
+#define CPU_MAX_THREADS 64
+
+/*!
+    @brief Block sizes of the CPU dot product, a CPU_BLOCK_K by CPU_BLOCK_N block of s2 fits in the L2 cache and a row of it in the L1 cache
+*/
+#define CPU_BLOCK_M 32
+#define CPU_BLOCK_N 512
+#define CPU_BLOCK_K 256
+
+/*!
+    @brief Fewest elements an elementwise operation gives to one thread, smaller operations are not worth waking the workers for
+*/
+#define CPU_ELEMENTWISE_GRAIN 32768
+
+/*!
+    @brief Elements of an expression the CPU evaluates at a time, each operation on the right of another one keeps a block of them on the stack
+*/
+#define CPU_EXPR_BLOCK 256
+
+/*!
+    @brief A function that runs the items from begin up to end of a parallel loop
+*/
+typedef void (*CpuTask)(void *args, size_t begin, size_t end);
+
+/*!
+    @brief The worker threads and the loop they are running
+
+    @details
+    A loop is split into chunks of grain items which the caller and the workers take one at a time until there are none left, so slow threads do not hold up the others.
+    Only one loop runs on the workers at a time, a thread that starts a loop while another one is running runs all of it itself.
+*/
+static struct
+{
+    CpuThread threads[CPU_MAX_THREADS];
+    unsigned int count;
+    CpuMutex mutex;
+    CpuCond work;
+    CpuCond done;
+    CpuTask task;
+    void *args;
+    size_t n;
+    size_t grain;
+    size_t next;
+    unsigned int generation;
+    unsigned int busy;
+    int active;
+    int stop;
+} pool;
+
+#if defined(CPU_HAS_AVX2_LOOPS)
+/*!
+    @brief Whether the processor and the operating system support AVX2 and FMA, set by cpuInit()
+*/
+static int useAvx2;
+
+/*!
+    @brief Checks if the AVX2 and FMA loops can run, which needs the instructions and an operating system that saves the AVX registers
+*/
+static int supportsAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return 0;
+    }
+    __cpuid(info, 1);
+    const int fma = (info[2] & (1 << 12)) != 0;
+    const int osxsave = (info[2] & (1 << 27)) != 0;
+    __cpuidex(info, 7, 0);
+    const int avx2 = (info[1] & (1 << 5)) != 0;
+    return fma && avx2 && osxsave && (_xgetbv(0) & 6) == 6;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+/*!
+    @brief Takes and runs chunks of the current loop until there are none left, the mutex must be held and is held again when this returns
+*/
+static void runChunks()
+{
+    while (pool.next < pool.n)
+    {
+        const size_t begin = pool.next;
+        const size_t end = pool.n - begin < pool.grain ? pool.n : begin + pool.grain;
+        pool.next = end;
+        cpuUnlock(&pool.mutex);
+        pool.task(pool.args, begin, end);
+        cpuLock(&pool.mutex);
+    }
+}
+#ifdef _WIN32
+static DWORD WINAPI worker(LPVOID unused)
+#else
+static void *worker(void *unused)
+#endif
+{
+    (void)unused;
+    unsigned int generation = 0;
+    cpuLock(&pool.mutex);
+    while (1)
+    {
+        while (!pool.stop && pool.generation == generation)
+        {
+            cpuWait(&pool.work, &pool.mutex);
+        }
+        if (pool.stop)
+        {
+            break;
+        }
+        generation = pool.generation;
+        pool.busy++;
+        runChunks();
+        if (--pool.busy == 0)
+        {
+            cpuWakeAll(&pool.done);
+        }
+    }
+    cpuUnlock(&pool.mutex);
+    return 0;
+}
+/*!
+    @brief Runs task over n items on the calling thread and every worker, and returns once all of them are done
+*/
+static void parallelFor(CpuTask task, void *args, const size_t n, size_t grain)
+{
+    if (grain == 0)
+    {
+        grain = 1;
+    }
+    if (pool.count == 0 || n <= grain)
+    {
+        task(args, 0, n);
+        return;
+    }
+    cpuLock(&pool.mutex);
+    if (pool.active)
+    {
+        /* The workers are busy with a loop from another thread, which already keeps every processor busy */
+        cpuUnlock(&pool.mutex);
+        task(args, 0, n);
+        return;
+    }
+    pool.active = 1;
+    pool.task = task;
+    pool.args = args;
+    pool.n = n;
+    pool.grain = grain;
+    pool.next = 0;
+    pool.generation++;
+    cpuWakeAll(&pool.work);
+    runChunks();
+    /* Workers that have not woken up yet find no chunks left and finish straight away */
+    while (pool.busy > 0)
+    {
+        cpuWait(&pool.done, &pool.mutex);
+    }
+    pool.active = 0;
+    cpuUnlock(&pool.mutex);
+}
+/*!
+    @brief Gives the number of processors the threads can run on
+*/
+static unsigned int processorCount()
+{
+    const char *env = getenv("LINEARALGEBRA_CPU_THREADS");
+    if (env != NULL && atoi(env) > 0)
+    {
+        return (unsigned int)atoi(env);
+    }
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned int)count : 1;
+#endif
+}
+void cpuInit()
+{
+#if defined(CPU_HAS_AVX2_LOOPS)
+    useAvx2 = supportsAvx2();
+#endif
+    if (pool.count > 0)
+    {
+        return;
+    }
+    unsigned int threads = processorCount();
+    if (threads > CPU_MAX_THREADS)
+    {
+        threads = CPU_MAX_THREADS;
+    }
+    cpuMutexInit(&pool.mutex);
+    cpuCondInit(&pool.work);
+    cpuCondInit(&pool.done);
+    pool.stop = 0;
+    /* The calling thread is one of the threads so one less worker is started */
+    for (unsigned int i = 0; i + 1 < threads; i++)
+    {
+#ifdef _WIN32
+        pool.threads[pool.count] = CreateThread(NULL, 0, worker, NULL, 0, NULL);
+        if (pool.threads[pool.count] == NULL)
+        {
+            break;
+        }
+#else
+        if (pthread_create(&pool.threads[pool.count], NULL, worker, NULL) != 0)
+        {
+            break;
+        }
+#endif
+        pool.count++;
+    }
+}
+void cpuClean()
+{
+    if (pool.count == 0)
+    {
+        return;
+    }
+    cpuLock(&pool.mutex);
+    pool.stop = 1;
+    cpuWakeAll(&pool.work);
+    cpuUnlock(&pool.mutex);
+    for (unsigned int i = 0; i < pool.count; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(pool.threads[i], INFINITE);
+        CloseHandle(pool.threads[i]);
+#else
+        pthread_join(pool.threads[i], NULL);
+#endif
+    }
+    pool.count = 0;
+    cpuCondDestroy(&pool.work);
+    cpuCondDestroy(&pool.done);
+    cpuMutexDestroy(&pool.mutex);
+}
+unsigned int cpuThreads()
+{
+    return pool.count + 1;
+}
+
+typedef struct
+{
+    ShapeOp op;
+    const float *s1;
+    const float *s2;
+    float *s3;
+} ShapesArgs;
+
+#if defined(CPU_HAS_AVX2_LOOPS)
+/*!
+    @brief Runs an elementwise operation on the elements from begin up to end 8 at a time and gives where the elements that are left over start
+*/
+static CPU_AVX2 size_t shapesAvx2(const ShapesArgs *a, size_t begin, const size_t end)
+{
+    for (; begin + 8 <= end; begin += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(a->s1 + begin);
+        const __m256 y = _mm256_loadu_ps(a->s2 + begin);
+        __m256 z;
+        switch (a->op)
+        {
+        case SHAPE_SUBTRACT:
+            z = _mm256_sub_ps(x, y);
+            break;
+        case SHAPE_CROSS:
+            z = _mm256_mul_ps(x, y);
+            break;
+        case SHAPE_DIVIDE:
+            z = _mm256_div_ps(x, y);
+            break;
+        default:
+            z = _mm256_add_ps(x, y);
+            break;
+        }
+        _mm256_storeu_ps(a->s3 + begin, z);
+    }
+    return begin;
+}
+#endif
+/*!
+    @brief Runs an elementwise operation on the elements from begin up to end, 8 at a time with AVX2 or 4 at a time with NEON
+*/
+static void shapesTask(void *args, size_t begin, const size_t end)
+{
+    const ShapesArgs *a = args;
+#if defined(CPU_HAS_AVX2_LOOPS)
+    if (useAvx2)
+    {
+        begin = shapesAvx2(a, begin, end);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; begin + 4 <= end; begin += 4)
+    {
+        const float32x4_t x = vld1q_f32(a->s1 + begin);
+        const float32x4_t y = vld1q_f32(a->s2 + begin);
+        float32x4_t z;
+        switch (a->op)
+        {
+        case SHAPE_SUBTRACT:
+            z = vsubq_f32(x, y);
+            break;
+        case SHAPE_CROSS:
+            z = vmulq_f32(x, y);
+            break;
+        case SHAPE_DIVIDE:
+            z = vdivq_f32(x, y);
+            break;
+        default:
+            z = vaddq_f32(x, y);
+            break;
+        }
+        vst1q_f32(a->s3 + begin, z);
+    }
+#endif
+    for (; begin < end; begin++)
+    {
+        switch (a->op)
+        {
+        case SHAPE_SUBTRACT:
+            a->s3[begin] = a->s1[begin] - a->s2[begin];
+            break;
+        case SHAPE_CROSS:
+            a->s3[begin] = a->s1[begin] * a->s2[begin];
+            break;
+        case SHAPE_DIVIDE:
+            a->s3[begin] = a->s1[begin] / a->s2[begin];
+            break;
+        default:
+            a->s3[begin] = a->s1[begin] + a->s2[begin];
+            break;
+        }
+    }
+}
+void cpuShapesF(const ShapeOp op, const float *s1, const float *s2, float *s3, const size_t n)
+{
+    ShapesArgs args = {op, s1, s2, s3};
+    size_t grain = (n + cpuThreads() * 4 - 1) / (cpuThreads() * 4);
+    if (grain < CPU_ELEMENTWISE_GRAIN)
+    {
+        grain = CPU_ELEMENTWISE_GRAIN;
+    }
+    parallelFor(shapesTask, &args, n, grain);
+}
+/*!
+    @brief Runs an elementwise operation on n elements of x and the scalar k, each loop only has one operation in it so the compiler can vectorize it
+*/
+static void applyScalar(const ShapeOp op, const float *x, const float k, float *out, const size_t n)
+{
+    switch (op)
+    {
+    case SHAPE_SUBTRACT:
+        for (size_t i = 0; i < n; i++)
+        {
+            out[i] = x[i] - k;
+        }
+        break;
+    case SHAPE_CROSS:
+        for (size_t i = 0; i < n; i++)
+        {
+            out[i] = x[i] * k;
+        }
+        break;
+    case SHAPE_DIVIDE:
+        for (size_t i = 0; i < n; i++)
+        {
+            out[i] = x[i] / k;
+        }
+        break;
+    default:
+        for (size_t i = 0; i < n; i++)
+        {
+            out[i] = x[i] + k;
+        }
+        break;
+    }
+}
+
+typedef struct
+{
+    const ShapeExprF *e;
+    const float **inputs;
+    float *out;
+} ExprArgs;
+
+/*!
+    @brief Evaluates an expression on n elements starting at begin into dst
+
+    @details
+    The left node is evaluated straight into dst and inputs and scalars on the right are used where they are, so only right nodes that are operations need a block on the stack.
+*/
+static void exprBlock(const ShapeExprF *e, const float **inputs, const size_t begin, const size_t n, float *dst)
+{
+    if (e->kind == EXPR_INPUT)
+    {
+        memcpy(dst, inputs[e->index] + begin, sizeof(float) * n);
+        return;
+    }
+    if (e->kind == EXPR_SCALAR)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            dst[i] = e->value;
+        }
+        return;
+    }
+    exprBlock(e->a, inputs, begin, n, dst);
+    if (e->b->kind == EXPR_SCALAR)
+    {
+        applyScalar(e->op, dst, e->b->value, dst, n);
+        return;
+    }
+    float block[CPU_EXPR_BLOCK];
+    const float *right = block;
+    if (e->b->kind == EXPR_INPUT)
+    {
+        right = inputs[e->b->index] + begin;
+    }
+    else
+    {
+        exprBlock(e->b, inputs, begin, n, block);
+    }
+    ShapesArgs shapes = {e->op, dst, right, dst};
+    shapesTask(&shapes, 0, n);
+}
+static void exprTask(void *args, size_t begin, const size_t end)
+{
+    const ExprArgs *a = args;
+    for (; begin < end; begin += CPU_EXPR_BLOCK)
+    {
+        const size_t n = end - begin < CPU_EXPR_BLOCK ? end - begin : CPU_EXPR_BLOCK;
+        exprBlock(a->e, a->inputs, begin, n, a->out + begin);
+    }
+}
+void cpuExprF(const ShapeExprF *e, const float **inputs, float *out, const size_t n)
+{
+    ExprArgs args = {e, inputs, out};
+    parallelFor(exprTask, &args, n, CPU_ELEMENTWISE_GRAIN);
+}
+
+typedef struct
+{
+    ShapeOp op;
+    const float *s;
+    const float *v;
+    float k;
+    float *out;
+    unsigned int c;
+    BroadcastAxis axis;
+} BroadcastArgs;
+
+static void scalarTask(void *args, const size_t begin, const size_t end)
+{
+    const BroadcastArgs *a = args;
+    applyScalar(a->op, a->s + begin, a->k, a->out + begin, end - begin);
+}
+/*!
+    @brief Runs a broadcast operation on the rows from begin up to end, rows lined up with the vector run like two shapes and the others like a shape and a scalar
+*/
+static void broadcastTask(void *args, size_t begin, const size_t end)
+{
+    const BroadcastArgs *a = args;
+    for (; begin < end; begin++)
+    {
+        const float *row = a->s + begin * a->c;
+        float *out = a->out + begin * a->c;
+        if (a->axis == BROADCAST_ROWS)
+        {
+            ShapesArgs shapes = {a->op, row, a->v, out};
+            shapesTask(&shapes, 0, a->c);
+        }
+        else
+        {
+            applyScalar(a->op, row, a->v[begin], out, a->c);
+        }
+    }
+}
+void cpuScalarShapesF(const ShapeOp op, const float *s, const float k, float *out, const size_t n)
+{
+    BroadcastArgs args = {op, s, NULL, k, out, 0, BROADCAST_ROWS};
+    size_t grain = (n + cpuThreads() * 4 - 1) / (cpuThreads() * 4);
+    if (grain < CPU_ELEMENTWISE_GRAIN)
+    {
+        grain = CPU_ELEMENTWISE_GRAIN;
+    }
+    parallelFor(scalarTask, &args, n, grain);
+}
+void cpuBroadcastShapesF(const ShapeOp op, const float *s, const float *v, float *out, const unsigned int r, const unsigned int c, const BroadcastAxis axis)
+{
+    BroadcastArgs args = {op, s, v, 0.0f, out, c, axis};
+    /* Every chunk goes over at least CPU_ELEMENTWISE_GRAIN elements */
+    parallelFor(broadcastTask, &args, r, c > 0 ? (CPU_ELEMENTWISE_GRAIN + c - 1) / c : r);
+}
+#if defined(CPU_HAS_AVX2_LOOPS)
+/*!
+    @brief Adds a times x to y 8 elements at a time and gives where the elements that are left over start
+*/
+static CPU_AVX2 size_t axpyAvx2(float *y, const float *x, const float a, const size_t n)
+{
+    size_t i = 0;
+    const __m256 va = _mm256_set1_ps(a);
+    for (; i + 8 <= n; i += 8)
+    {
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+    }
+    return i;
+}
+/*!
+    @brief Gives the sum of the products of the first n / 8 * 8 elements of x and y
+*/
+static CPU_AVX2 float dotAvx2(const float *x, const float *y, const size_t n)
+{
+    __m256 acc = _mm256_setzero_ps();
+    for (size_t i = 0; i + 8 <= n; i += 8)
+    {
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), acc);
+    }
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    return _mm_cvtss_f32(half);
+}
+#endif
+/*!
+    @brief Adds a times x to y
+*/
+static void axpy(float *y, const float *x, const float a, const size_t n)
+{
+    size_t i = 0;
+#if defined(CPU_HAS_AVX2_LOOPS)
+    if (useAvx2)
+    {
+        i = axpyAvx2(y, x, a, n);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const float32x4_t va = vdupq_n_f32(a);
+    for (; i + 4 <= n; i += 4)
+    {
+        vst1q_f32(y + i, vfmaq_f32(vld1q_f32(y + i), va, vld1q_f32(x + i)));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        y[i] += a * x[i];
+    }
+}
+/*!
+    @brief Gives the sum of the products of the elements of x and y
+*/
+static float dot(const float *x, const float *y, const size_t n)
+{
+    size_t i = 0;
+    float sum = 0.0f;
+#if defined(CPU_HAS_AVX2_LOOPS)
+    if (useAvx2)
+    {
+        sum = dotAvx2(x, y, n);
+        i = n / 8 * 8;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4)
+    {
+        acc = vfmaq_f32(acc, vld1q_f32(x + i), vld1q_f32(y + i));
+    }
+    sum = vaddvq_f32(acc);
+#endif
+    for (; i < n; i++)
+    {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+typedef struct
+{
+    const float *s1;
+    const float *s2;
+    float *s3;
+    unsigned int r;
+    unsigned int c;
+    unsigned int c2;
+    float alpha;
+    float beta;
+    const float *bias;
+    Activation activation;
+    Transpose trans1;
+    Transpose trans2;
+    size_t ld1;
+    size_t ld2;
+    size_t ld3;
+} DotArgs;
+
+/*!
+    @brief Applies an activation the same way the dot product kernel does
+*/
+static float activate(const float x, const Activation activation)
+{
+    switch (activation)
+    {
+    case ACTIVATION_RELU:
+        return x > 0.0f ? x : 0.0f;
+    case ACTIVATION_GELU:
+        return 0.5f * x * (1.0f + tanhf(0.7978845608028654f * (x + 0.044715f * x * x * x)));
+    case ACTIVATION_SIGMOID:
+        return 1.0f / (1.0f + expf(-x));
+    default:
+        return x;
+    }
+}
+
+/*!
+    @brief Calculates the rows of s3 in the row blocks from begin up to end
+
+    @details
+    The columns of s3 and the shared dimension are split into blocks so the block of s2 being used stays in cache while every row of the row block goes over it.
+    The rows start at beta times s3 instead of zero, and the bias and activation are applied once a row block is done while it is still in cache.
+    r, c and c2 are the sizes after transposing and the ld fields are the elements between the starts of two rows as the matrices are stored.
+*/
+static void dotTask(void *args, const size_t begin, const size_t end)
+{
+    const DotArgs *a = args;
+    const size_t first = begin * CPU_BLOCK_M;
+    const size_t last = end * CPU_BLOCK_M < a->r ? end * CPU_BLOCK_M : a->r;
+    for (size_t i = first; i < last && a->beta != 1.0f; i++)
+    {
+        float *row = a->s3 + i * a->ld3;
+        if (a->beta == 0.0f)
+        {
+            memset(row, 0, sizeof(float) * a->c2);
+            continue;
+        }
+        for (size_t j = 0; j < a->c2; j++)
+        {
+            row[j] *= a->beta;
+        }
+    }
+    /* A transposed s2 is copied a block at a time into rows that follow each other so axpy() can still go along them */
+    float *packed = a->trans2 == TRANSPOSE ? malloc(sizeof(float) * CPU_BLOCK_K * CPU_BLOCK_N) : NULL;
+    for (size_t jc = 0; jc < a->c2; jc += CPU_BLOCK_N)
+    {
+        const size_t nc = a->c2 - jc < CPU_BLOCK_N ? a->c2 - jc : CPU_BLOCK_N;
+        for (size_t kc = 0; kc < a->c; kc += CPU_BLOCK_K)
+        {
+            const size_t kend = a->c - kc < CPU_BLOCK_K ? a->c : kc + CPU_BLOCK_K;
+            for (size_t j = 0; packed != NULL && j < nc; j++)
+            {
+                for (size_t k = kc; k < kend; k++)
+                {
+                    packed[(k - kc) * nc + j] = a->s2[(jc + j) * a->ld2 + k];
+                }
+            }
+            for (size_t i = first; i < last; i++)
+            {
+                float *row = a->s3 + i * a->ld3 + jc;
+                for (size_t k = kc; k < kend; k++)
+                {
+                    const float *s2_row = packed != NULL ? packed + (k - kc) * nc : a->s2 + k * a->ld2 + jc;
+                    const float s1_element = a->trans1 == TRANSPOSE ? a->s1[k * a->ld1 + i] : a->s1[i * a->ld1 + k];
+                    axpy(row, s2_row, a->alpha * s1_element, nc);
+                }
+            }
+        }
+    }
+    free(packed);
+    if (a->bias == NULL && a->activation == ACTIVATION_NONE)
+    {
+        return;
+    }
+    for (size_t i = first; i < last; i++)
+    {
+        float *row = a->s3 + i * a->ld3;
+        for (size_t j = 0; j < a->c2; j++)
+        {
+            row[j] = activate(a->bias != NULL ? row[j] + a->bias[j] : row[j], a->activation);
+        }
+    }
+}
+void cpuDotMatricesF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2)
+{
+    cpuGemmF(NO_TRANSPOSE, NO_TRANSPOSE, s1, c, s2, c2, s3, c2, r, c, c2, 1.0f, 0.0f, NULL, ACTIVATION_NONE);
+}
+void cpuGemmF(const Transpose trans1, const Transpose trans2, const float *s1, const unsigned int ld1, const float *s2, const unsigned int ld2, float *s3, const unsigned int ld3, const unsigned int r, const unsigned int c, const unsigned int c2, const float alpha, const float beta, const float *bias, const Activation activation)
+{
+    DotArgs args = {s1, s2, s3, r, c, c2, alpha, beta, bias, activation, trans1, trans2, ld1, ld2, ld3};
+    parallelFor(dotTask, &args, (r + CPU_BLOCK_M - 1) / CPU_BLOCK_M, 1);
+}
+
+typedef struct
+{
+    const float *m;
+    const float *v;
+    float *out;
+    unsigned int c;
+    size_t ld;
+} MatVecArgs;
+
+static void matVecTask(void *args, size_t begin, const size_t end)
+{
+    const MatVecArgs *a = args;
+    for (; begin < end; begin++)
+    {
+        a->out[begin] = dot(a->m + begin * a->ld, a->v, a->c);
+    }
+}
+/*!
+    @brief Calculates the elements of the product of a transposed matrix and a vector from begin up to end by adding the part of every stored row in that range
+*/
+static void matVecTransposedTask(void *args, const size_t begin, const size_t end)
+{
+    const MatVecArgs *a = args;
+    memset(a->out + begin, 0, sizeof(float) * (end - begin));
+    for (size_t k = 0; k < a->c; k++)
+    {
+        axpy(a->out + begin, a->m + k * a->ld + begin, a->v[k], end - begin);
+    }
+}
+void cpuMatVecF(const float *m, const float *v, float *out, const unsigned int r, const unsigned int c)
+{
+    cpuMatVecStridedF(NO_TRANSPOSE, m, c, v, out, r, c);
+}
+void cpuMatVecStridedF(const Transpose trans, const float *m, const unsigned int ld, const float *v, float *out, const unsigned int r, const unsigned int c)
+{
+    MatVecArgs args = {m, v, out, c, ld};
+    /* Every chunk reads at least CPU_ELEMENTWISE_GRAIN elements of the matrix */
+    const size_t grain = c > 0 ? (CPU_ELEMENTWISE_GRAIN + c - 1) / c : r;
+    parallelFor(trans == TRANSPOSE ? matVecTransposedTask : matVecTask, &args, r, grain);
+}
+
+typedef struct
+{
+    unsigned int op;
+    const float *s1;
+    const float *s2;
+    const float *shift;
+    double *values;
+    unsigned int *indices;
+    size_t length;
+    size_t chunk;
+    unsigned int r;
+    unsigned int c;
+} ReduceArgs;
+
+static double reduceIdentity(const unsigned int op)
+{
+    if (op == REDUCE_MAX || op == REDUCE_ARGMAX)
+    {
+        return -INFINITY;
+    }
+    return op == REDUCE_MIN ? INFINITY : 0.0;
+}
+/*!
+    @brief Gives what one element adds to a reduction, the same way the reduction kernels do
+*/
+static double reduceMap(const double x, const double y, const double shift, const unsigned int op)
+{
+    switch (op)
+    {
+    case REDUCE_NORM:
+        return x * x;
+    case REDUCE_LOG_SUM_EXP:
+        return exp(x - shift);
+    case REDUCE_DOT:
+        return x * y;
+    default:
+        return x;
+    }
+}
+static void reduceCombine(double *value, unsigned int *index, const double x, const unsigned int i, const unsigned int op)
+{
+    if (op == REDUCE_MAX)
+    {
+        *value = fmax(*value, x);
+    }
+    else if (op == REDUCE_MIN)
+    {
+        *value = fmin(*value, x);
+    }
+    else if (op == REDUCE_ARGMAX)
+    {
+        if (x > *value || (x == *value && i < *index))
+        {
+            *value = x;
+            *index = i;
+        }
+    }
+    else
+    {
+        *value += x;
+    }
+}
+static float reduceFinish(const double value, const unsigned int index, const double shift, const unsigned int op)
+{
+    if (op == REDUCE_NORM)
+    {
+        return (float)sqrt(value);
+    }
+    if (op == REDUCE_LOG_SUM_EXP)
+    {
+        return (float)(log(value) + shift);
+    }
+    return op == REDUCE_ARGMAX ? (float)index : (float)value;
+}
+/*!
+    @brief Reduces the elements from begin up to end of a line that starts at offset
+*/
+static void reduceLine(const ReduceArgs *a, const size_t offset, const size_t begin, const size_t end, const double shift, double *value, unsigned int *index)
+{
+    *value = reduceIdentity(a->op);
+    *index = UINT_MAX;
+    for (size_t i = begin; i < end; i++)
+    {
+        const double y = a->op == REDUCE_DOT ? a->s2[offset + i] : 0.0;
+        reduceCombine(value, index, reduceMap(a->s1[offset + i], y, shift, a->op), (unsigned int)i, a->op);
+    }
+}
+/*!
+    @brief Reduces the parts of a reduction of every element from begin up to end
+*/
+static void reduceChunksTask(void *args, size_t begin, const size_t end)
+{
+    const ReduceArgs *a = args;
+    const double shift = a->shift != NULL ? a->shift[0] : 0.0;
+    for (; begin < end; begin++)
+    {
+        const size_t last = (begin + 1) * a->chunk < a->length ? (begin + 1) * a->chunk : a->length;
+        reduceLine(a, 0, begin * a->chunk, last, shift, &a->values[begin], &a->indices[begin]);
+    }
+}
+/*!
+    @brief Reduces the rows from begin up to end
+*/
+static void reduceRowsTask(void *args, size_t begin, const size_t end)
+{
+    const ReduceArgs *a = args;
+    for (; begin < end; begin++)
+    {
+        const double shift = a->shift != NULL ? a->shift[begin] : 0.0;
+        reduceLine(a, begin * a->c, 0, a->c, shift, &a->values[begin], &a->indices[begin]);
+    }
+}
+/*!
+    @brief Reduces the columns from begin up to end, going over the rows in order so every row is read once from memory
+*/
+static void reduceColumnsTask(void *args, const size_t begin, const size_t end)
+{
+    const ReduceArgs *a = args;
+    for (size_t j = begin; j < end; j++)
+    {
+        a->values[j] = reduceIdentity(a->op);
+        a->indices[j] = UINT_MAX;
+    }
+    for (unsigned int i = 0; i < a->r; i++)
+    {
+        const size_t offset = (size_t)i * a->c;
+        for (size_t j = begin; j < end; j++)
+        {
+            const double shift = a->shift != NULL ? a->shift[j] : 0.0;
+            const double y = a->op == REDUCE_DOT ? a->s2[offset + j] : 0.0;
+            reduceCombine(&a->values[j], &a->indices[j], reduceMap(a->s1[offset + j], y, shift, a->op), i, a->op);
+        }
+    }
+}
+void cpuReduceF(const unsigned int op, const ReduceAxis axis, const float *s1, const float *s2, float *out, const unsigned int r, const unsigned int c)
+{
+    const unsigned int lines = axis == REDUCE_ALL ? 1 : axis == REDUCE_ROWS ? r : c;
+    if (lines == 0)
+    {
+        return;
+    }
+    float *shift = NULL;
+    if (op == REDUCE_LOG_SUM_EXP)
+    {
+        shift = malloc(sizeof(float) * lines);
+        cpuReduceF(REDUCE_MAX, axis, s1, s2, shift, r, c);
+    }
+    ReduceArgs args = {op, s1, s2, shift, NULL, NULL, (size_t)r * c, 0, r, c};
+    unsigned int parts = lines;
+    if (axis == REDUCE_ALL)
+    {
+        args.chunk = (args.length + cpuThreads() * 4 - 1) / (cpuThreads() * 4);
+        args.chunk = args.chunk < CPU_ELEMENTWISE_GRAIN ? CPU_ELEMENTWISE_GRAIN : args.chunk;
+        parts = (unsigned int)((args.length + args.chunk - 1) / args.chunk);
+        parts = parts < 1 ? 1 : parts;
+    }
+    args.values = malloc(sizeof(double) * parts);
+    args.indices = malloc(sizeof(unsigned int) * parts);
+    if (axis == REDUCE_ALL)
+    {
+        parallelFor(reduceChunksTask, &args, parts, 1);
+        for (unsigned int i = 1; i < parts; i++)
+        {
+            reduceCombine(&args.values[0], &args.indices[0], args.values[i], args.indices[i], op);
+        }
+    }
+    else if (axis == REDUCE_ROWS)
+    {
+        /* Every chunk reads at least CPU_ELEMENTWISE_GRAIN elements */
+        parallelFor(reduceRowsTask, &args, r, c > 0 ? (CPU_ELEMENTWISE_GRAIN + c - 1) / c : r);
+    }
+    else
+    {
+        parallelFor(reduceColumnsTask, &args, c, r > 0 ? (CPU_ELEMENTWISE_GRAIN + r - 1) / r : c);
+    }
+    const unsigned int results = axis == REDUCE_ALL ? 1 : parts;
+    for (unsigned int i = 0; i < results; i++)
+    {
+        out[i] = reduceFinish(args.values[i], args.indices[i], shift != NULL ? shift[i] : 0.0, op);
+    }
+    free(args.values);
+    free(args.indices);
+    free(shift);
+}
+
+typedef struct
+{
+    const unsigned int *rowPtr;
+    const unsigned int *cols;
+    const float *values;
+    const float *s2;
+    float *out;
+    unsigned int c2;
+} CsrArgs;
+
+static void csrMatVecTask(void *args, size_t begin, const size_t end)
+{
+    const CsrArgs *a = args;
+    for (; begin < end; begin++)
+    {
+        float sum = 0.0f;
+        for (unsigned int k = a->rowPtr[begin]; k < a->rowPtr[begin + 1]; k++)
+        {
+            sum += a->values[k] * a->s2[a->cols[k]];
+        }
+        a->out[begin] = sum;
+    }
+}
+/*!
+    @brief Calculates the rows of the product from begin up to end by adding the row of the dense matrix of every nonzero times its value
+*/
+static void csrDotTask(void *args, size_t begin, const size_t end)
+{
+    const CsrArgs *a = args;
+    for (; begin < end; begin++)
+    {
+        float *out = a->out + begin * a->c2;
+        memset(out, 0, sizeof(float) * a->c2);
+        for (unsigned int k = a->rowPtr[begin]; k < a->rowPtr[begin + 1]; k++)
+        {
+            axpy(out, a->s2 + (size_t)a->cols[k] * a->c2, a->values[k], a->c2);
+        }
+    }
+}
+/*!
+    @brief Gives the rows every chunk of a sparse product takes so that it does at least CPU_ELEMENTWISE_GRAIN multiplications on average
+*/
+static size_t csrGrain(const unsigned int *row_ptr, const unsigned int r, const unsigned int c2)
+{
+    const double work = (double)(row_ptr[r] - row_ptr[0]) * c2;
+    return work > 0 ? (size_t)(CPU_ELEMENTWISE_GRAIN * (double)r / work) + 1 : r;
+}
+void cpuCsrMatVecF(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const float *v, float *out, const unsigned int r)
+{
+    CsrArgs args = {row_ptr, cols, values, v, out, 1};
+    parallelFor(csrMatVecTask, &args, r, csrGrain(row_ptr, r, 1));
+}
+void cpuCsrDotMatricesF(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const float *s2, float *s3, const unsigned int r, const unsigned int c2)
+{
+    CsrArgs args = {row_ptr, cols, values, s2, s3, c2};
+    parallelFor(csrDotTask, &args, r, csrGrain(row_ptr, r, c2));
+}
@@ -0,0 +1,87 @@
+/*!
+    @file cpu.h
+
+    @brief The native CPU backend used when there is no GPU or when an operation is too small to be worth copying to the GPU
+
+    @details
+    Nothing in here is part of the public API, linearalgebra.h picks between these functions and the OpenCL kernels.
+    CL/cl.h and linearalgebra.h must be included before this file.
+*/
+
+/*!
+    @brief Starts the worker threads, the amount is the number of processors or the LINEARALGEBRA_CPU_THREADS environment variable if it is set
+*/
+void cpuInit();
+/*!
+    @brief Stops the worker threads
+*/
+void cpuClean();
+/*!
+    @brief Gives the number of threads that run the CPU operations, including the calling thread
+*/
+unsigned int cpuThreads();
+/*!
+    @brief A node of an elementwise expression, an input shape, a scalar or an operation on two nodes, see exprOpF()
+*/
+struct ShapeExprF
+{
+    enum
+    {
+        EXPR_INPUT,
+        EXPR_SCALAR,
+        EXPR_OP
+    } kind;
+    ShapeOp op;
+    unsigned int index;
+    float value;
+    ShapeExprF *a;
+    ShapeExprF *b;
+};
+/*!
+    @brief Runs one of the elementwise operations on n elements with SIMD and every worker thread
+*/
+void cpuShapesF(const ShapeOp op, const float *s1, const float *s2, float *s3, const size_t n);
+/*!
+    @brief Calculates the dot product of an r by c matrix and a c by c2 matrix with a cache blocked loop split over the worker threads
+*/
+void cpuDotMatricesF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2);
+/*!
+    @brief Calculates alpha times the dot product of s1 and s2, each used as it is stored or transposed, plus beta times s3 into s3, then adds the bias to every row and applies the activation, see gemmStridedF()
+*/
+void cpuGemmF(const Transpose trans1, const Transpose trans2, const float *s1, const unsigned int ld1, const float *s2, const unsigned int ld2, float *s3, const unsigned int ld3, const unsigned int r, const unsigned int c, const unsigned int c2, const float alpha, const float beta, const float *bias, const Activation activation);
+/*!
+    @brief Multiplies a vector with c elements by an r by c matrix, the rows are split over the worker threads
+*/
+void cpuMatVecF(const float *m, const float *v, float *out, const unsigned int r, const unsigned int c);
+/*!
+    @brief Multiplies a vector with c elements by an r by c matrix that is stored as it is or transposed with ld elements between the starts of its rows, see matVecStridedF()
+*/
+void cpuMatVecStridedF(const Transpose trans, const float *m, const unsigned int ld, const float *v, float *out, const unsigned int r, const unsigned int c);
+/*!
+    @brief Reduction op that sums the products of the elements of two shapes, it comes after the ones in ReduceOp and is only used inside the library
+*/
+#define REDUCE_DOT 6
+/*!
+    @brief Reduces an r by c shape along an axis, op is a ReduceOp or REDUCE_DOT in which case s2 is the second shape and otherwise it is not used
+*/
+void cpuReduceF(const unsigned int op, const ReduceAxis axis, const float *s1, const float *s2, float *out, const unsigned int r, const unsigned int c);
+/*!
+    @brief Runs one of the elementwise operations on n elements of s and the scalar k
+*/
+void cpuScalarShapesF(const ShapeOp op, const float *s, const float k, float *out, const size_t n);
+/*!
+    @brief Runs one of the elementwise operations on an r by c shape and a vector lined up with its rows or columns
+*/
+void cpuBroadcastShapesF(const ShapeOp op, const float *s, const float *v, float *out, const unsigned int r, const unsigned int c, const BroadcastAxis axis);
+/*!
+    @brief Evaluates an expression on n elements of its inputs in blocks that stay in the L1 cache, the blocks are split over the worker threads
+*/
+void cpuExprF(const ShapeExprF *e, const float **inputs, float *out, const size_t n);
+/*!
+    @brief Multiplies a vector by an r row sparse matrix in compressed sparse row form, the rows are split over the worker threads
+*/
+void cpuCsrMatVecF(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const float *v, float *out, const unsigned int r);
+/*!
+    @brief Calculates the dot product of an r row sparse matrix in compressed sparse row form and a dense matrix with c2 columns, the rows are split over the worker threads
+*/
+void cpuCsrDotMatricesF(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const float *s2, float *s3, const unsigned int r, const unsigned int c2);
@@ -36,6 +36,8 @@
 
     @ref createShapeF()
 
+    @ref createAlignedShapeF()
+
     @subsubsection otherFuncs Other Functions
 
     @ref matVecF()
@@ -55,141 +57,793 @@
 
     @ref createShapeF()
 
+    @ref createAlignedShapeF()
+
     @subsubsection otherMFuncs Other Functions
 
     @ref dotMatricesF()
 
     @ref matVecF()
+
+    @section precision Double and Half Precision
+    @ref DoubleOps
+
+    @ref HalfOps
+
+    @section batch Batched Operations
+    @ref BatchFOps
+
+    @section device Device Shapes
+    @ref DeviceFOps
+
+    @section broadcast Scalar and Broadcast Operations
+    @ref BroadcastFOps
+
+    @section gemm Fused Matrix Products
+    @ref GemmFOps
+
+    @section strided Transposed and Strided Products
+    @ref StridedFOps
+
+    @section sparse Sparse Matrices
+    @ref SparseFOps
+
+    @section reduce Reductions
+    @ref ReduceFOps
+
+    @section async Asynchronous Operations
+    @ref AsyncFOps
+
+    @section stream Streaming Operations
+    @ref StreamFOps
+
+    @section expr Fused Expressions
+    @ref ExprFOps
+
+    @section graph Command Graphs
+    @ref GraphFuncs
+
+    @section files Matrix Files
+    @ref FileFuncs
+
+    @section pool Buffer Pool
+    @ref PoolFuncs
+
+    @section profiler Profiler
+    @ref ProfilerFuncs
+
+    @section dispatch CPU and GPU Dispatch
+    @ref DispatchFuncs
+
+    @section tune Auto-Tuning
+    @ref TuneFuncs
+
+    @section devices Multiple Devices
+    @ref DeviceFuncs
+
+    @section threads Threads
+    @ref ThreadFuncs
+
+    @section errors Errors
+    @ref ErrorFuncs
 */
 
 /*!
     @page reference Function References
 
+    @ref addDeviceShapesF()
+
+    @ref addDeviceShapesFAsync()
+
+    @ref addShapesD()
+
+    @ref addShapesDAsync()
+
     @ref addShapesF()
 
+    @ref addShapesFAsync()
+
+    @ref addShapesH()
+
+    @ref addShapesHAsync()
+
+    @ref beginCommandGraph()
+
+    @ref broadcastDeviceShapesF()
+
+    @ref broadcastDeviceShapesFAsync()
+
+    @ref broadcastShapesF()
+
+    @ref broadcastShapesFAsync()
+
+    @ref calibrateDispatch()
+
+    @ref clearProfiler()
+
+    @ref createAlignedShapeF()
+
+    @ref createDeviceCsrF()
+
+    @ref createDeviceCsrFAsync()
+
+    @ref createDeviceShapeF()
+
+    @ref createDeviceShapeFAsync()
+
+    @ref createDeviceShapeFromFileF()
+
     @ref createShapeF()
 
+    @ref crossDeviceShapesF()
+
+    @ref crossDeviceShapesFAsync()
+
+    @ref crossShapesD()
+
+    @ref crossShapesDAsync()
+
     @ref crossShapesF()
 
+    @ref crossShapesFAsync()
+
+    @ref crossShapesH()
+
+    @ref crossShapesHAsync()
+
+    @ref csrDotDeviceMatricesF()
+
+    @ref csrDotDeviceMatricesFAsync()
+
+    @ref csrDotMatricesF()
+
+    @ref csrDotMatricesFAsync()
+
+    @ref csrMatVecDeviceF()
+
+    @ref csrMatVecDeviceFAsync()
+
+    @ref csrMatVecF()
+
+    @ref csrMatVecFAsync()
+
+    @ref divideDeviceShapesF()
+
+    @ref divideDeviceShapesFAsync()
+
+    @ref divideShapesD()
+
+    @ref divideShapesDAsync()
+
     @ref divideShapesF()
 
+    @ref divideShapesFAsync()
+
+    @ref divideShapesH()
+
+    @ref divideShapesHAsync()
+
+    @ref dotDeviceMatricesBatchedF()
+
+    @ref dotDeviceMatricesF()
+
+    @ref dotDeviceMatricesFAsync()
+
+    @ref dotDeviceVectorsF()
+
+    @ref dotDeviceVectorsFAsync()
+
+    @ref dotMatricesBatchedF()
+
+    @ref dotMatricesBatchedFAsync()
+
+    @ref dotMatricesD()
+
+    @ref dotMatricesDAsync()
+
     @ref dotMatricesF()
 
+    @ref dotMatricesFAsync()
+
+    @ref dotMatricesH()
+
+    @ref dotMatricesHAsync()
+
+    @ref dotMatricesStridedF()
+
+    @ref dotMatricesStridedFAsync()
+
+    @ref dotVectorsF()
+
+    @ref dotVectorsFAsync()
+
+    @ref downloadDeviceCsrF()
+
+    @ref downloadDeviceShapeF()
+
+    @ref downloadDeviceShapeFAsync()
+
+    @ref endCommandGraph()
+
+    @ref errorName()
+
+    @ref evalDeviceExprF()
+
+    @ref evalExprF()
+
+    @ref exprInputF()
+
+    @ref exprOpF()
+
+    @ref exprScalarF()
+
+    @ref freeAlignedShapeF()
+
+    @ref freeDeviceCsrF()
+
+    @ref freeDeviceShapeF()
+
+    @ref freeExprF()
+
+    @ref gemmDeviceF()
+
+    @ref gemmDeviceFAsync()
+
+    @ref gemmF()
+
+    @ref gemmFAsync()
+
+    @ref gemmStridedF()
+
+    @ref gemmStridedFAsync()
+
+    @ref getBufferPoolStats()
+
+    @ref getBuildLog()
+
+    @ref getCommandGraphInfo()
+
+    @ref getCostModel()
+
+    @ref getDeviceCsrSizeF()
+
+    @ref getDeviceShapeSizeF()
+
+    @ref getError()
+
+    @ref getMatrixFileData()
+
+    @ref getMatrixFileInfo()
+
+    @ref getProfileStats()
+
+    @ref getResourceStats()
+
+    @ref getTuneConfig()
+
     @ref gpuClean()
 
+    @ref gpuCreateContext()
+
+    @ref gpuCurrentDevice()
+
+    @ref gpuDevice()
+
+    @ref gpuDeviceCount()
+
+    @ref gpuFound()
+
     @ref gpuInit()
 
+    @ref gpuReleaseContext()
+
+    @ref gpuSupportsDouble()
+
+    @ref gpuSupportsHalf()
+
+    @ref gpuUseDevice()
+
+    @ref mapDeviceShapeF()
+
+    @ref mapMatrixFile()
+
+    @ref matVecBatchedF()
+
+    @ref matVecBatchedFAsync()
+
+    @ref matVecD()
+
+    @ref matVecDAsync()
+
+    @ref matVecDeviceBatchedF()
+
+    @ref matVecDeviceF()
+
+    @ref matVecDeviceFAsync()
+
     @ref matVecF()
 
+    @ref matVecFAsync()
+
+    @ref matVecH()
+
+    @ref matVecHAsync()
+
+    @ref matVecStridedF()
+
+    @ref matVecStridedFAsync()
+
+    @ref reduceDeviceShapeF()
+
+    @ref reduceDeviceShapeFAsync()
+
+    @ref reduceShapeF()
+
+    @ref reduceShapeFAsync()
+
+    @ref releaseCommandGraph()
+
+    @ref replayCommandGraph()
+
+    @ref replayCommandGraphAsync()
+
+    @ref saveMatrixFile()
+
+    @ref scalarDeviceShapesF()
+
+    @ref scalarDeviceShapesFAsync()
+
+    @ref scalarShapesF()
+
+    @ref scalarShapesFAsync()
+
+    @ref setBufferPoolLimit()
+
+    @ref setDeferredErrorChecking()
+
+    @ref setDispatchMode()
+
+    @ref setMultiDevice()
+
+    @ref startProfiler()
+
+    @ref stopProfiler()
+
+    @ref streamMatVecF()
+
+    @ref streamShapesF()
+
+    @ref subtractDeviceShapesF()
+
+    @ref subtractDeviceShapesFAsync()
+
+    @ref subtractShapesD()
+
+    @ref subtractShapesDAsync()
+
     @ref subtractShapesF()
+
+    @ref subtractShapesFAsync()
+
+    @ref subtractShapesH()
+
+    @ref subtractShapesHAsync()
+
+    @ref trimBufferPool()
+
+    @ref tuneKernels()
+
+    @ref unmapDeviceShapeF()
+
+    @ref unmapMatrixFile()
+
+    @ref writeProfileTrace()
 */
 
+/*!
+    @brief The kernels of one precision, gpuInit() makes one set for floats, one for doubles and one for halfs
+
+    @details
+    Every set uses the same names because they are all built from the same kernel source.
+*/
 typedef struct
 {
+    size_t elementSize;     /*!< Bytes in one element of a shape */
+    size_t accumulatorSize; /*!< Bytes in the type the kernels add up sums in */
+    unsigned int vectorWidth; /*!< Elements every work item of the elementwise kernels loads at once */
+    unsigned int dotTile;     /*!< Rows and columns of the block of the result every work group of the tiled dot product kernel computes */
+    unsigned int dotWork;     /*!< Rows and columns of the block of the result every work item of the tiled dot product kernel computes */
     cl_kernel addFKernel;
     cl_kernel subtractFKernel;
     cl_kernel crossFKernel;
     cl_kernel divideFKernel;
     cl_kernel dotFKernel;
     cl_kernel matVecFkernel;
+    cl_kernel matVecSumFKernel;
+    cl_kernel matVecTransposedFKernel;
+    cl_kernel dot4x4FKernel;
+    cl_kernel dot16x16FKernel;
+    cl_kernel matVec4x4FKernel;
+    cl_kernel reduceFKernel;
+    cl_kernel reduceColumnsFKernel;
+    cl_kernel reduceFinalFKernel;
+    cl_kernel scalarFKernel;
+    cl_kernel broadcastFKernel;
+    cl_kernel csrMatVecFKernel;
+    cl_kernel csrDotFKernel;
 } Kernels;
+/*!
+    @brief Number of size buckets in the buffer pool, bucket i holds buffers of BUFFER_POOL_MIN_SIZE << i bytes
+*/
+#define BUFFER_POOL_BUCKETS 48
+/*!
+    @brief Size in bytes of the buffers in the smallest bucket of the buffer pool
+*/
+#define BUFFER_POOL_MIN_SIZE 256
+typedef struct
+{
+    cl_mem *buffers[BUFFER_POOL_BUCKETS];
+    unsigned int counts[BUFFER_POOL_BUCKETS];
+    unsigned int capacities[BUFFER_POOL_BUCKETS];
+    size_t held;
+    size_t limit;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long created;
+    unsigned long long released;
+    size_t allocated;
+} BufferPool;
+/*!
+    @brief Counters of the buffer pool given by getBufferPoolStats()
+*/
+typedef struct
+{
+    unsigned long long hits;   /*!< Number of buffers that were taken from the pool */
+    unsigned long long misses; /*!< Number of buffers that had to be created because the pool had none of the right size */
+    size_t held;               /*!< Bytes of GPU memory held by unused buffers in the pool */
+    size_t limit;              /*!< Most bytes the pool will hold before it releases buffers instead */
+} BufferPoolStats;
+/*!
+    @brief Kinds of commands the profiler records
+*/
+typedef enum
+{
+    PROFILE_UPLOAD,
+    PROFILE_KERNEL,
+    PROFILE_DOWNLOAD
+} ProfileKind;
+/*!
+    @brief Size of the operation and kernel names the profiler keeps, a record without an operation is given its kernel name as the operation
+*/
+#define PROFILE_NAME_SIZE 64
+/*!
+    @brief One command recorded by the profiler, the times are in nanoseconds from the clock of the GPU
+*/
+typedef struct
+{
+    char op[PROFILE_NAME_SIZE];
+    char name[PROFILE_NAME_SIZE];
+    ProfileKind kind;
+    unsigned int r;
+    unsigned int c;
+    size_t bytes;
+    cl_event event;
+    cl_ulong queued;
+    cl_ulong submitted;
+    cl_ulong started;
+    cl_ulong ended;
+} ProfileRecord;
+typedef struct
+{
+    int enabled;
+    ProfileRecord *records;
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int resolved;
+    char op[PROFILE_NAME_SIZE];
+    unsigned int r;
+    unsigned int c;
+    cl_event scratch;
+} Profiler;
+/*!
+    @brief Timings of every recorded command with the same operation, name, kind and shape given by getProfileStats(), the times are in milliseconds
+*/
+typedef struct
+{
+    const char *op;     /*!< Function the commands were run by */
+    const char *name;   /*!< Kernel name, or upload or download for copies */
+    ProfileKind kind;   /*!< Whether the commands are copies to the GPU, kernels or copies from the GPU */
+    unsigned int r;     /*!< Rows of the shape the operation ran on */
+    unsigned int c;     /*!< Columns of the shape the operation ran on */
+    unsigned int count; /*!< Number of commands */
+    size_t bytes;       /*!< Bytes copied by all of the commands */
+    double total;       /*!< Time the GPU spent running all of the commands */
+    double mean;        /*!< Average time of a command */
+    double p50;         /*!< Median time of a command */
+    double p90;         /*!< Time that 90 percent of the commands were faster than */
+    double p99;         /*!< Time that 99 percent of the commands were faster than */
+    double max;         /*!< Time of the slowest command */
+    double queueDelay;  /*!< Average time from a command being enqueued to it starting */
+} ProfileStats;
+/*!
+    @brief Counts of the OpenCL objects the current device is holding given by getResourceStats(), under a steady load they stay flat so one that keeps growing is a leak
+*/
+typedef struct
+{
+    unsigned int events;                 /*!< Events the profiler holds until it has read their timings */
+    unsigned int pendingChecks;          /*!< Commands whose deferred error check has not run yet, see setDeferredErrorChecking() */
+    unsigned long long buffersCreated;   /*!< Buffers made by the device, for the buffer pool, wrapped host memory and device shapes */
+    unsigned long long buffersReleased;  /*!< Buffers released by the device */
+    size_t bufferBytes;                  /*!< Bytes of GPU memory in buffers the device made and has not released, including the ones held by the buffer pool */
+} ResourceStats;
+/*!
+    @brief Measured speeds of the GPU and the CPU backend which decide where float operations on host shapes run, see getCostModel()
+
+    @details
+    Latencies are in seconds, bandwidths in bytes per second and rates in elements per second, except for the dot product rates which are in multiply adds per second.
+*/
+typedef struct
+{
+    int calibrated;            /*!< 1 once the model has been measured or loaded */
+    double launchLatency;      /*!< Time to start a kernel and wait for it */
+    double uploadLatency;      /*!< Fixed cost of a copy to the GPU */
+    double uploadBandwidth;    /*!< Speed of copies to the GPU */
+    double downloadLatency;    /*!< Fixed cost of a copy from the GPU */
+    double downloadBandwidth;  /*!< Speed of copies from the GPU */
+    double gpuElementwiseRate; /*!< Speed of the elementwise kernels */
+    double gpuDotRate;         /*!< Speed of the dot product kernel */
+    double gpuMatVecRate;      /*!< Speed of the matrix vector kernels */
+    double cpuElementwiseRate; /*!< Speed of the CPU elementwise operations */
+    double cpuDotRate;         /*!< Speed of the CPU dot product */
+    double cpuMatVecRate;      /*!< Speed of the CPU matrix vector product */
+} CostModel;
+/*!
+    @brief Number of size classes the tuned work group sizes are picked for, see TuneConfig
+*/
+#define TUNE_SIZE_CLASSES 3
+/*!
+    @brief Work group sizes, tile sizes and vector width of the float kernels of a device, see getTuneConfig()
+
+    @details
+    The work group sizes are picked for each size class, class 0 is operations on fewer than 2^16 elements, class 1 fewer than 2^20 and class 2 the rest.
+    The vector width and the tile sizes are compiled into the kernels, so the same ones are used for every size class.
+*/
+typedef struct
+{
+    int tuned;                                        /*!< 1 once the settings have been tuned or loaded, otherwise they are the defaults */
+    unsigned int vectorWidth;                         /*!< Elements every work item of the elementwise kernels loads at once */
+    unsigned int dotTile;                             /*!< Rows and columns of the block of the result every work group of the dot product computes */
+    unsigned int dotTileK;                            /*!< Width of the tiles of both matrices that are staged in local memory */
+    unsigned int dotWork;                             /*!< Rows and columns of the block of the result every work item computes */
+    unsigned int elementwiseGroup[TUNE_SIZE_CLASSES]; /*!< Work group size of the elementwise, scalar and broadcast kernels */
+    unsigned int matVecGroup[TUNE_SIZE_CLASSES];      /*!< Largest work group size of the matrix vector kernel */
+} TuneConfig;
+/*!
+    @brief Picks where float operations on host shapes run, see setDispatchMode()
+*/
+typedef enum
+{
+    DISPATCH_AUTO,
+    DISPATCH_GPU,
+    DISPATCH_CPU
+} DispatchMode;
 typedef struct
 {
-    cl_event addFEvent;
-    cl_event subtractFEvent;
-    cl_event crossFEvent;
-    cl_event divideFEvent;
-    cl_event dotFEvent;
-    cl_event matVecFEvent;
-    cl_event s1Write;
-    cl_event s2Write;
-    cl_event s3Write;
-} Events;
+    char *source;
+    cl_program program;
+    cl_kernel kernel;
+} FusedKernel;
+/*!
+    @brief A recorded sequence of GPU commands that can be replayed with one call, see @ref GraphFuncs
+
+    @details
+    The struct is only defined inside of main.c so a CommandGraph can only be used through a pointer made by endCommandGraph().
+*/
+typedef struct CommandGraph CommandGraph;
+/*!
+    @brief The first failed status and the number of checks still to run that the event callbacks of deferred error checking write to, see setDeferredErrorChecking()
+
+    @details
+    It is allocated on its own so a callback the driver never delivers cannot write to a freed device.
+*/
 typedef struct
 {
-    cl_mem s1;
-    cl_mem s2;
-    cl_mem s3;
-} Buffers;
+    volatile cl_int status;
+    volatile cl_int pending;
+} DeferredChecks;
 typedef struct
 {
     Kernels kernels;
-    Events events;
-    Buffers buffers;
+    Kernels kernelsD;
+    Kernels kernelsH;
+    BufferPool pool;
+    Profiler profiler;
+    CostModel costs;
+    TuneConfig tune;
+    DispatchMode dispatchMode;
+    FusedKernel *fusedKernels;
+    unsigned int fusedCount;
+    CommandGraph *graph;
     cl_platform_id platform;
     cl_context context;
     cl_device_id device;
     cl_command_queue queue;
+    cl_command_queue uploadQueue;
+    cl_command_queue downloadQueue;
     cl_program program;
+    cl_program programD;
+    cl_program programH;
+    size_t maxWorkGroupSize;
+    cl_uint computeUnits;
+    cl_bool unifiedMemory;
+    cl_bool hasDevice;
     cl_int err;
+    cl_int status;
+    DeferredChecks *deferred;
+    int deferChecks;
+    char *buildLog;
 } GPU;
-
 /*!
-    @defgroup MultiFOps Matrix and Vector Operations
-    @brief This topic includes all the functions that can run for both matrices and vectors
-    @{
-*/
+    @brief A shape, matrix or vector, whose elements live in GPU memory
 
+    @details
+    The struct is only defined inside of main.c so a DeviceShapeF can only be used through a pointer made by createDeviceShapeF() or one of the device operations.
+*/
+typedef struct DeviceShapeF DeviceShapeF;
 /*!
-    @brief This functions is responsible for adding any of two shapes, matrices or vectors
+    @brief A sparse matrix in compressed sparse row form whose arrays live in GPU memory, see @ref SparseFOps
 
     @details
-    This function will take in 2 shapes and output the third shape which is the sum of the two shapes
-
-    @param base_s1 This is the address to the first shape to be summed
-    @param base_s2 This is the address to the second shape to be summed
-    @param base_s3 This is the address to the third shape which will contain the sum of the other two shapes
-    @param r This is the amount of rows in shapes 1 and 2
-    @param c This is the amount of columns in shapes 1 and 2
-
-    @remarks
-    The shape at *base_s3 does not need to have the correct size allocated, it only needs to have some space allocated in the heap.
-    This code will automatically allocate the right amount of space for the shape at *base_s3.
-    This function does not have any error checking so you need to make sure that you give the right params to get the right output.
-    This function is very similar to a few others see below
-
-    @see subtractShapesF()
-    @see crossShapesF()
-    @see divideShapesF()
+    The struct is only defined inside of main.c so a DeviceCsrF can only be used through a pointer made by createDeviceCsrF().
 */
-void addShapesF(float **base_s1, float **base_s2, float **base_s3, unsigned int r, unsigned int c);
+typedef struct DeviceCsrF DeviceCsrF;
 /*!
-    @brief This function is responsible for subtracting any of two shapes, matrices or vectors
-
-    @details This function will take in 2 shapes and output the third shape which will be the difference of the two shapes
-
-    @param base_s1 This is the address to the first shape which will be subtracted from by the second shape
-    @param base_s2 This is the address to the second shape which will subtract from the first shape
-    @param base_s3 This is the address to the third shape which will contain the difference of the first two shapes
-    @param r This is the amount of rows in shapes 1 and 2
-    @param c This is the amount of columns in shapes 1 and 2
-
-    @remarks
-    The shape at *base_s3 does not need to have the correct size allocated, it only needs to have some space allocated in the heap.
-    This code will automatically allocate the right amount of space for the shape at *base_s3
-    This function does not have any error checking so you need to make sure that you give the right params to get the right output.
+    @brief Picks one of the elementwise operations for the functions that can run any of them
+*/
+typedef enum
+{
+    SHAPE_ADD,
+    SHAPE_SUBTRACT,
+    SHAPE_CROSS,
+    SHAPE_DIVIDE
+} ShapeOp;
+/*!
+    @brief Picks how the vector of a broadcast operation lines up with the shape, see @ref BroadcastFOps
+*/
+typedef enum
+{
+    BROADCAST_ROWS,   /*!< The vector has one element per column and is applied to every row */
+    BROADCAST_COLUMNS /*!< The vector has one element per row and is applied to every column, element i goes with every element of row i */
+} BroadcastAxis;
+/*!
+    @brief Picks the function gemmF() applies to every element of its result, see @ref GemmFOps
+*/
+typedef enum
+{
+    ACTIVATION_NONE,    /*!< The elements are stored as they are */
+    ACTIVATION_RELU,    /*!< max(x, 0) */
+    ACTIVATION_GELU,    /*!< The tanh approximation of GELU, 0.5x(1 + tanh(sqrt(2 / pi)(x + 0.044715x^3))) */
+    ACTIVATION_SIGMOID  /*!< 1 / (1 + e^-x) */
+} Activation;
+/*!
+    @brief Picks whether a matrix of a strided product is used as it is stored or transposed, see @ref StridedFOps
+*/
+typedef enum
+{
+    NO_TRANSPOSE, /*!< The matrix is used as it is stored */
+    TRANSPOSE     /*!< The rows of the matrix as it is stored are used as its columns */
+} Transpose;
+/*!
+    @brief Picks what a reduction gives for the elements it goes over, see @ref ReduceFOps
+*/
+typedef enum
+{
+    REDUCE_SUM,         /*!< Sum of the elements */
+    REDUCE_MAX,         /*!< Largest element */
+    REDUCE_MIN,         /*!< Smallest element */
+    REDUCE_ARGMAX,      /*!< Index of the largest element, the first one if there are several */
+    REDUCE_NORM,        /*!< Square root of the sum of the squares of the elements */
+    REDUCE_LOG_SUM_EXP  /*!< Log of the sum of e to the power of the elements, the log of the softmax denominator, calculated without overflowing */
+} ReduceOp;
+/*!
+    @brief Picks which elements a reduction combines
+*/
+typedef enum
+{
+    REDUCE_ALL,     /*!< Every element, the result has one element */
+    REDUCE_ROWS,    /*!< Every row on its own, the result is a vector with one element per row */
+    REDUCE_COLUMNS  /*!< Every column on its own, the result is a vector with one element per column */
+} ReduceAxis;
+/*!
+    @brief An expression made of elementwise operations on shapes and scalars, see @ref ExprFOps
+
+    @details
+    The struct is only defined inside of main.c so a ShapeExprF can only be used through a pointer made by exprInputF(), exprScalarF() or exprOpF().
+*/
+typedef struct ShapeExprF ShapeExprF;
+/*!
+    @brief Picks the type of the elements of a matrix file, see @ref FileFuncs
+*/
+typedef enum
+{
+    MATRIX_FLOAT,  /*!< float, which the F functions take */
+    MATRIX_DOUBLE, /*!< double, which the D functions take */
+    MATRIX_HALF    /*!< cl_half, which the H functions take */
+} MatrixType;
+/*!
+    @brief A matrix file mapped into memory, see mapMatrixFile()
+
+    @details
+    The struct is only defined inside of main.c so a MatrixFile can only be used through a pointer made by mapMatrixFile().
+*/
+typedef struct MatrixFile MatrixFile;
+
+/*!
+    @defgroup MultiFOps Matrix and Vector Operations
+    @brief This topic includes all the functions that can run for both matrices and vectors
+    @{
+*/
+
+/*!
+    @brief This functions is responsible for adding any of two shapes, matrices or vectors
+
+    @details
+    This function will take in 2 shapes and output the third shape which is the sum of the two shapes
+
+    @param s1 This is the first shape to be summed
+    @param s2 This is the second shape to be summed
+    @param s3 This is the third shape which will contain the sum of the other two shapes
+    @param r This is the amount of rows in shapes 1 and 2
+    @param c This is the amount of columns in shapes 1 and 2
+
+    @remarks
+    The third shape must have correctly allocated space which is sizeof(float) * r * c.
+    The shapes can be any size, none of them are reallocated.
+    This function does not have any error checking so you need to make sure that you give the right params to get the right output.
+    This function is very similar to a few others see below
+
+    @see subtractShapesF()
+    @see crossShapesF()
+    @see divideShapesF()
+*/
+void addShapesF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c);
+/*!
+    @brief This function is responsible for subtracting any of two shapes, matrices or vectors
+
+    @details This function will take in 2 shapes and output the third shape which will be the difference of the two shapes
+
+    @param s1 This is the first shape which will be subtracted from by the second shape
+    @param s2 This is the second shape which will subtract from the first shape
+    @param s3 This is the third shape which will contain the difference of the first two shapes
+    @param r This is the amount of rows in shapes 1 and 2
+    @param c This is the amount of columns in shapes 1 and 2
+
+    @remarks
+    The third shape must have correctly allocated space which is sizeof(float) * r * c.
+    The shapes can be any size, none of them are reallocated.
+    This function does not have any error checking so you need to make sure that you give the right params to get the right output.
     This function is very similar to a few others see below
 
     @see addShapesF()
     @see crossShapesF()
     @see divideShapesF()
 */
-void subtractShapesF(float **base_s1, float **base_s2, float **base_s3, unsigned int r, unsigned int c);
+void subtractShapesF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c);
 /*!
     @brief This function is responsible for either crossing two matrices or multiplying two vectors
 
     @details
     This function will take in 2 shapes and output the third shape which will be the cross or regular product of the two shapes
 
-    @param base_s1 This is the address to the first shape which will be crossed or multiplied
-    @param base_s2 This is the address to the second shape which will be crossed or multiplied
-    @param base_s3 This is the address to the third shape which will contain the cross or regular product of the two shapes
+    @param s1 This is the first shape which will be crossed or multiplied
+    @param s2 This is the second shape which will be crossed or multiplied
+    @param s3 This is the third shape which will contain the cross or regular product of the two shapes
     @param r This is the amount of rows in shapes 1 and 2
     @param c This is the amount of columns in shapes 1 and 2
 
     @remarks
-    The shape at *base_s3 does not need to have the correct size allocated, it only needs to have some space allocated in the heap.
-    This code will automatically allocate the right amount of space for the shape at *base_s3
+    The third shape must have correctly allocated space which is sizeof(float) * r * c.
+    The shapes can be any size, none of them are reallocated.
     This function does not have any error checking so you need to make sure that you give the right params to get the right output.
     This function is very similar to a few others see below
 
@@ -197,21 +851,21 @@ void subtractShapesF(float **base_s1, float **base_s2, float **base_s3, unsigned
     @see crossShapesF()
     @see divideShapesF()
 */
-void crossShapesF(float **base_s1, float **base_s2, float **base_s3, unsigned int r, unsigned int c);
+void crossShapesF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c);
 /*!
     @brief This function is responsible for dividing any of two shapes, matrices or vectors
 
     @details This function will take in 2 shapes and output the third shape which will be the quotient of the two shapes
 
-    @param base_s1 This is the address to the first shape which will be the dividend
-    @param base_s2 This is the address to the second shape which will be the divisor
-    @param base_s3 This is the address to the third shape which will contain the quotient of the first two shapes
+    @param s1 This is the first shape which will be the dividend
+    @param s2 This is the second shape which will be the divisor
+    @param s3 This is the third shape which will contain the quotient of the first two shapes
     @param r This is the amount of rows in shapes 1 and 2
     @param c This is the amount of columns in shapes 1 and 2
 
     @remarks
-    The shape at *base_s3 does not need to have the correct size allocated, it only needs to have some space allocated in the heap.
-    This code will automatically allocate the right amount of space for the shape at *base_s3
+    The third shape must have correctly allocated space which is sizeof(float) * r * c.
+    The shapes can be any size, none of them are reallocated.
     This function does not have any error checking so you need to make sure that you give the right params to get the right output.
     This function is very similar to a few others see below
 
@@ -219,7 +873,7 @@ void crossShapesF(float **base_s1, float **base_s2, float **base_s3, unsigned in
     @see subtractShapesF()
     @see crossShapesF()
 */
-void divideShapesF(float **base_s1, float **base_s2, float **base_s3, unsigned int r, unsigned int c);
+void divideShapesF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c);
 /*!
     @brief This function create either a matrix or vector
 
@@ -232,6 +886,26 @@ void divideShapesF(float **base_s1, float **base_s2, float **base_s3, unsigned i
     @returns The shape with those requirements
 */
 float *createShapeF(const unsigned int n, const float fill_val);
+/*!
+    @brief This function creates either a matrix or vector in memory that the GPU can use without copying it
+
+    @details
+    The shape is page aligned and its size is rounded up to a whole page, the extra elements are set to 0.
+    On GPUs that share memory with the host, like most integrated GPUs, the operations use shapes made by this function directly instead of copying them to and from GPU memory.
+    On other GPUs it works the same as createShapeF().
+
+    @param n This is the number of elements in the shape, for matrices it is row * columns, and for vectors it is just columns
+    @param fill_val This is the default value that each element in the shape should be filled with
+
+    @returns The shape with those requirements, it must be freed with freeAlignedShapeF()
+*/
+float *createAlignedShapeF(const unsigned int n, const float fill_val);
+/*!
+    @brief Frees a shape made by createAlignedShapeF()
+
+    @param s The shape to free
+*/
+void freeAlignedShapeF(float *s);
 
 /*!
     @}
@@ -250,24 +924,2198 @@ float *createShapeF(const unsigned int n, const float fill_val);
     @remarks
     There is no error checking in this function.
     The third shape must have correctly allocated space which is sizeof(float) * r * c2
+    The matrices are multiplied in blocks, 64 by 64 unless the kernels are tuned or the GPU has smaller work groups, so r, c and c2 can be any size and are not limited by the work group size of the GPU.
     */
 void dotMatricesF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2);
 /*!
     @brief Multiplies a vector by a matrix
 
-    @param base_s1 Address to the matrix which will multiply the vector
-    @param base_s2 Address to the vector which will be multiplied by the matrix
-    @param base_s3 Address to the vector which will store the result
-    @param r Number of elements in the vector and the number of rows in the matrix
-    @param c Number of columns in the matrix
+    @param m The matrix which will multiply the vector
+    @param v The vector which will be multiplied by the matrix, it has c elements
+    @param out The vector which will store the result, it has r elements
+    @param r Number of rows in the matrix and the number of elements in the result
+    @param c Number of columns in the matrix and the number of elements in the vector
 
     @remarks
-    The vector at base_s3 must be allocated the correct space prior to this function being called.
+    The vector at out must be allocated the correct space prior to this function being called.
     Their is no error checking in this function.
+    Long rows are split between several work groups so c is not limited by the work group size of the GPU.
 */
-void matVecF(float **base_s1, float **base_s2, float **base_s3, unsigned int r, unsigned int c);
+void matVecF(const float *m, const float *v, float *out, const unsigned int r, const unsigned int c);
+
 /*!
-    @brief Initializes the GPU struct. Must be called before any of the other functions
+    @defgroup DoubleOps Double Precision Operations
+    @brief This topic includes the double versions of the elementwise, dot product and matrix vector functions
+
+    @details
+    These work the same way as the float versions but every shape holds double elements, so the output shapes must have sizeof(double) * the amount of elements allocated.
+    @{
+*/
+
+/*!
+    @brief Adds two shapes elementwise
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the sum of the two shapes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+
+    @see addShapesF()
+*/
+void addShapesD(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c);
+/*!
+    @brief Subtracts two shapes elementwise
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the difference of the two shapes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+
+    @see subtractShapesF()
+*/
+void subtractShapesD(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c);
+/*!
+    @brief Multiplies two shapes elementwise
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the product of the two shapes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+
+    @see crossShapesF()
+*/
+void crossShapesD(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c);
+/*!
+    @brief Divides two shapes elementwise
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the quotient of the two shapes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+
+    @see divideShapesF()
+*/
+void divideShapesD(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c);
+/*!
+    @brief Calculates the dot product of two matrices
+
+    @param s1 This is the first matrix which has r rows and c columns
+    @param s2 This is the second matrix which has c rows and c2 columns
+    @param s3 This will contain the dot product which has r rows and c2 columns
+    @param r This is the number of rows in the first and third matrices
+    @param c This is the number of columns in the first matrix and the number of rows in the second matrix
+    @param c2 This is the number of columns in the second and third matrices
+
+    @see dotMatricesF()
+*/
+void dotMatricesD(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c, const unsigned int c2);
+/*!
+    @brief Multiplies a vector by a matrix
+
+    @param m This is the matrix which has r rows and c columns
+    @param v This is the vector which has c elements
+    @param out This will contain the product which has r elements
+    @param r Number of rows in the matrix
+    @param c Number of columns in the matrix and the number of elements in the vector
+
+    @see matVecF()
+*/
+void matVecD(const double *m, const double *v, double *out, const unsigned int r, const unsigned int c);
+/*!
+    @brief Starts addShapesD() without waiting for it to finish
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the result once event completes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @see addShapesD()
+*/
+void addShapesDAsync(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Starts subtractShapesD() without waiting for it to finish
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the result once event completes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @see subtractShapesD()
+*/
+void subtractShapesDAsync(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Starts crossShapesD() without waiting for it to finish
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the result once event completes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @see crossShapesD()
+*/
+void crossShapesDAsync(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Starts divideShapesD() without waiting for it to finish
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the result once event completes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @see divideShapesD()
+*/
+void divideShapesDAsync(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Starts dotMatricesD() without waiting for it to finish
+
+    @param s1 This is the first matrix which has r rows and c columns
+    @param s2 This is the second matrix which has c rows and c2 columns
+    @param s3 This will contain the dot product once event completes
+    @param r This is the number of rows in the first and third matrices
+    @param c This is the number of columns in the first matrix and the number of rows in the second matrix
+    @param c2 This is the number of columns in the second and third matrices
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @see dotMatricesD()
+*/
+void dotMatricesDAsync(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c, const unsigned int c2, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Starts matVecD() without waiting for it to finish
+
+    @param m This is the matrix which has r rows and c columns
+    @param v This is the vector which has c elements
+    @param out This will contain the product once event completes
+    @param r Number of rows in the matrix
+    @param c Number of columns in the matrix and the number of elements in the vector
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @see matVecD()
+*/
+void matVecDAsync(const double *m, const double *v, double *out, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Checks if the GPU can run the double precision functions
+
+    @returns 1 if the GPU supports the cl_khr_fp64 extension, otherwise 0 and the double functions do nothing and fail with CL_INVALID_OPERATION, see getError()
+*/
+int gpuSupportsDouble();
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup HalfOps Half Precision Operations
+    @brief This topic includes the half versions of the elementwise, dot product and matrix vector functions
+
+    @details
+    These work the same way as the float versions but every shape holds cl_half elements, so the output shapes must have sizeof(cl_half) * the amount of elements allocated.
+    The elements are stored as 16 bit halfs but all of the math is done with floats, so products and sums only round once when they are stored.
+    @{
+*/
+
+/*!
+    @brief Adds two shapes elementwise
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the sum of the two shapes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+
+    @see addShapesF()
+*/
+void addShapesH(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c);
+/*!
+    @brief Subtracts two shapes elementwise
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the difference of the two shapes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+
+    @see subtractShapesF()
+*/
+void subtractShapesH(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c);
+/*!
+    @brief Multiplies two shapes elementwise
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the product of the two shapes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+
+    @see crossShapesF()
+*/
+void crossShapesH(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c);
+/*!
+    @brief Divides two shapes elementwise
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the quotient of the two shapes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+
+    @see divideShapesF()
+*/
+void divideShapesH(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c);
+/*!
+    @brief Calculates the dot product of two matrices
+
+    @param s1 This is the first matrix which has r rows and c columns
+    @param s2 This is the second matrix which has c rows and c2 columns
+    @param s3 This will contain the dot product which has r rows and c2 columns
+    @param r This is the number of rows in the first and third matrices
+    @param c This is the number of columns in the first matrix and the number of rows in the second matrix
+    @param c2 This is the number of columns in the second and third matrices
+
+    @see dotMatricesF()
+*/
+void dotMatricesH(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c, const unsigned int c2);
+/*!
+    @brief Multiplies a vector by a matrix
+
+    @param m This is the matrix which has r rows and c columns
+    @param v This is the vector which has c elements
+    @param out This will contain the product which has r elements
+    @param r Number of rows in the matrix
+    @param c Number of columns in the matrix and the number of elements in the vector
+
+    @see matVecF()
+*/
+void matVecH(const cl_half *m, const cl_half *v, cl_half *out, const unsigned int r, const unsigned int c);
+/*!
+    @brief Starts addShapesH() without waiting for it to finish
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the result once event completes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @see addShapesH()
+*/
+void addShapesHAsync(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Starts subtractShapesH() without waiting for it to finish
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the result once event completes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @see subtractShapesH()
+*/
+void subtractShapesHAsync(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Starts crossShapesH() without waiting for it to finish
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the result once event completes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @see crossShapesH()
+*/
+void crossShapesHAsync(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Starts divideShapesH() without waiting for it to finish
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This will contain the result once event completes
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @see divideShapesH()
+*/
+void divideShapesHAsync(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Starts dotMatricesH() without waiting for it to finish
+
+    @param s1 This is the first matrix which has r rows and c columns
+    @param s2 This is the second matrix which has c rows and c2 columns
+    @param s3 This will contain the dot product once event completes
+    @param r This is the number of rows in the first and third matrices
+    @param c This is the number of columns in the first matrix and the number of rows in the second matrix
+    @param c2 This is the number of columns in the second and third matrices
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @see dotMatricesH()
+*/
+void dotMatricesHAsync(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c, const unsigned int c2, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Starts matVecH() without waiting for it to finish
+
+    @param m This is the matrix which has r rows and c columns
+    @param v This is the vector which has c elements
+    @param out This will contain the product once event completes
+    @param r Number of rows in the matrix
+    @param c Number of columns in the matrix and the number of elements in the vector
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @see matVecH()
+*/
+void matVecHAsync(const cl_half *m, const cl_half *v, cl_half *out, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Checks if the GPU can run the half precision functions
+
+    @returns 1 if the GPU supports the cl_khr_fp16 extension, otherwise 0 and the half functions do nothing and fail with CL_INVALID_OPERATION, see getError()
+*/
+int gpuSupportsHalf();
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup BatchFOps Batched Operations
+    @brief This topic includes versions of the matrix operations that multiply many matrices with a single kernel
+
+    @details
+    Matrix number i of a batch starts stride elements after matrix number i - 1, so a stride of 0 uses the same matrix or vector for the whole batch.
+    The results are packed one after another with no space between them.
+    4 by 4 and 16 by 16 matrices have their own kernels so batches of small matrices do not waste most of the GPU.
+    @{
+*/
+
+/*!
+    @brief Calculates the dot products of a batch of pairs of matrices
+
+    @param s1 This is the first matrix of every pair, each one has r rows and c columns
+    @param s2 This is the second matrix of every pair, each one has c rows and c2 columns
+    @param s3 This will contain the batch dot products one after another, it must have sizeof(float) * batch * r * c2 allocated
+    @param r This is the number of rows in the first and third matrices
+    @param c This is the number of columns in the first matrices and the number of rows in the second matrices
+    @param c2 This is the number of columns in the second and third matrices
+    @param batch This is the number of pairs of matrices
+    @param stride1 This is the number of elements from the start of one first matrix to the start of the next one
+    @param stride2 This is the number of elements from the start of one second matrix to the start of the next one
+
+    @see dotMatricesF()
+*/
+void dotMatricesBatchedF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2, const unsigned int batch, const unsigned int stride1, const unsigned int stride2);
+/*!
+    @brief Multiplies a batch of vectors by a batch of matrices
+
+    @param m This is the matrices, each one has r rows and c columns
+    @param v This is the vectors, each one has c elements
+    @param out This will contain the batch results one after another, it must have sizeof(float) * batch * r allocated
+    @param r Number of rows in every matrix
+    @param c Number of columns in every matrix and the number of elements in every vector
+    @param batch This is the number of matrix vector products
+    @param stride_m This is the number of elements from the start of one matrix to the start of the next one
+    @param stride_v This is the number of elements from the start of one vector to the start of the next one
+
+    @see matVecF()
+*/
+void matVecBatchedF(const float *m, const float *v, float *out, const unsigned int r, const unsigned int c, const unsigned int batch, const unsigned int stride_m, const unsigned int stride_v);
+/*!
+    @brief Calculates the dot products of a batch of pairs of matrices without waiting for it to finish
+
+    @param s1 This is the first matrix of every pair, each one has r rows and c columns
+    @param s2 This is the second matrix of every pair, each one has c rows and c2 columns
+    @param s3 This will contain the batch dot products one after another, it must have sizeof(float) * batch * r * c2 allocated
+    @param r This is the number of rows in the first and third matrices
+    @param c This is the number of columns in the first matrices and the number of rows in the second matrices
+    @param c2 This is the number of columns in the second and third matrices
+    @param batch This is the number of pairs of matrices
+    @param stride1 This is the number of elements from the start of one first matrix to the start of the next one
+    @param stride2 This is the number of elements from the start of one second matrix to the start of the next one
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @see dotMatricesBatchedF()
+*/
+void dotMatricesBatchedFAsync(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2, const unsigned int batch, const unsigned int stride1, const unsigned int stride2, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Multiplies a batch of vectors by a batch of matrices without waiting for it to finish
+
+    @param m This is the matrices, each one has r rows and c columns
+    @param v This is the vectors, each one has c elements
+    @param out This will contain the batch results one after another, it must have sizeof(float) * batch * r allocated
+    @param r Number of rows in every matrix
+    @param c Number of columns in every matrix and the number of elements in every vector
+    @param batch This is the number of matrix vector products
+    @param stride_m This is the number of elements from the start of one matrix to the start of the next one
+    @param stride_v This is the number of elements from the start of one vector to the start of the next one
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @see matVecBatchedF()
+*/
+void matVecBatchedFAsync(const float *m, const float *v, float *out, const unsigned int r, const unsigned int c, const unsigned int batch, const unsigned int stride_m, const unsigned int stride_v, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Calculates the dot products of a batch of pairs of device matrices
+
+    @param s1 This holds the first matrix of every pair, each one has r rows and c columns
+    @param s2 This holds the second matrix of every pair, each one has c rows and c2 columns
+    @param r This is the number of rows in the first matrices
+    @param c This is the number of columns in the first matrices and the number of rows in the second matrices
+    @param c2 This is the number of columns in the second matrices
+    @param batch This is the number of pairs of matrices
+    @param stride1 This is the number of elements from the start of one first matrix to the start of the next one
+    @param stride2 This is the number of elements from the start of one second matrix to the start of the next one
+
+    @returns A new device matrix with batch * r rows and c2 columns with the dot products stacked on top of each other
+
+    @see dotDeviceMatricesF()
+*/
+DeviceShapeF *dotDeviceMatricesBatchedF(const DeviceShapeF *s1, const DeviceShapeF *s2, const unsigned int r, const unsigned int c, const unsigned int c2, const unsigned int batch, const unsigned int stride1, const unsigned int stride2);
+/*!
+    @brief Multiplies a batch of device vectors by a batch of device matrices
+
+    @param m This holds the matrices, each one has r rows and c columns
+    @param v This holds the vectors, each one has c elements
+    @param r Number of rows in every matrix
+    @param c Number of columns in every matrix and the number of elements in every vector
+    @param batch This is the number of matrix vector products
+    @param stride_m This is the number of elements from the start of one matrix to the start of the next one
+    @param stride_v This is the number of elements from the start of one vector to the start of the next one
+
+    @returns A new device matrix with batch rows and r columns, row i is the result of product i
+
+    @see matVecDeviceF()
+*/
+DeviceShapeF *matVecDeviceBatchedF(const DeviceShapeF *m, const DeviceShapeF *v, const unsigned int r, const unsigned int c, const unsigned int batch, const unsigned int stride_m, const unsigned int stride_v);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup DeviceFOps Device Shape Operations
+    @brief This topic includes the functions that keep shapes in GPU memory between operations
+
+    @details
+    The other functions copy their inputs to the GPU and copy the result back every time they are called.
+    These functions work on shapes that are already on the GPU and give back a new shape that is also on the GPU, so chained operations never copy anything to the host unless downloadDeviceShapeF() is called.
+    The operations only queue their work on the GPU and return right away, downloadDeviceShapeF() waits for all of it to finish.
+    Every DeviceShapeF that is given back must be freed with freeDeviceShapeF().
+    @{
+*/
+
+/*!
+    @brief Creates a shape in GPU memory
+
+    @param s The elements of the shape to copy to the GPU, this can be NULL to leave the elements uninitialized
+    @param r This is the amount of rows in the shape
+    @param c This is the amount of columns in the shape
+
+    @returns The new device shape
+*/
+DeviceShapeF *createDeviceShapeF(const float *s, const unsigned int r, const unsigned int c);
+/*!
+    @brief Copies a device shape back to the host
+
+    @param s The device shape to copy
+    @param out The host shape which will contain the elements, it must have sizeof(float) * r * c allocated
+
+    @remarks
+    This waits for every operation that was queued before it to finish.
+*/
+void downloadDeviceShapeF(const DeviceShapeF *s, float *out);
+/*!
+    @brief Gives the amount of rows and columns in a device shape
+
+    @param s The device shape
+    @param r This will contain the amount of rows
+    @param c This will contain the amount of columns
+*/
+void getDeviceShapeSizeF(const DeviceShapeF *s, unsigned int *r, unsigned int *c);
+/*!
+    @brief Gives a host pointer to the elements of a device shape
+
+    @details
+    On GPUs that share memory with the host the pointer points straight at the memory of the device shape, otherwise the elements are copied.
+    The elements can be read and changed until unmapDeviceShapeF() is called.
+
+    @param s The device shape to map
+
+    @returns The pointer to the elements
+*/
+float *mapDeviceShapeF(DeviceShapeF *s);
+/*!
+    @brief Gives back a pointer from mapDeviceShapeF() so the GPU can use the device shape again
+
+    @param s The device shape that was mapped
+    @param mapped The pointer given by mapDeviceShapeF()
+*/
+void unmapDeviceShapeF(DeviceShapeF *s, float *mapped);
+/*!
+    @brief Frees the GPU memory of a device shape
+
+    @param s The device shape to free, this can be NULL
+*/
+void freeDeviceShapeF(DeviceShapeF *s);
+/*!
+    @brief Adds two device shapes
+
+    @param s1 The first shape to be summed
+    @param s2 The second shape to be summed, it must have the same size as s1
+
+    @returns A new device shape with the sum of the two shapes
+
+    @see addShapesF()
+*/
+DeviceShapeF *addDeviceShapesF(const DeviceShapeF *s1, const DeviceShapeF *s2);
+/*!
+    @brief Subtracts two device shapes
+
+    @param s1 The shape which will be subtracted from by the second shape
+    @param s2 The shape which will subtract from the first shape, it must have the same size as s1
+
+    @returns A new device shape with the difference of the two shapes
+
+    @see subtractShapesF()
+*/
+DeviceShapeF *subtractDeviceShapesF(const DeviceShapeF *s1, const DeviceShapeF *s2);
+/*!
+    @brief Crosses two device matrices or multiplies two device vectors
+
+    @param s1 The first shape to be crossed or multiplied
+    @param s2 The second shape to be crossed or multiplied, it must have the same size as s1
+
+    @returns A new device shape with the cross or regular product of the two shapes
+
+    @see crossShapesF()
+*/
+DeviceShapeF *crossDeviceShapesF(const DeviceShapeF *s1, const DeviceShapeF *s2);
+/*!
+    @brief Divides two device shapes
+
+    @param s1 The shape which will be the dividend
+    @param s2 The shape which will be the divisor, it must have the same size as s1
+
+    @returns A new device shape with the quotient of the two shapes
+
+    @see divideShapesF()
+*/
+DeviceShapeF *divideDeviceShapesF(const DeviceShapeF *s1, const DeviceShapeF *s2);
+/*!
+    @brief Calculates the dot product of 2 device matrices
+
+    @param s1 The first matrix, it has r rows and c columns
+    @param s2 The second matrix, it has c rows and c2 columns
+
+    @returns A new device matrix with r rows and c2 columns
+
+    @see dotMatricesF()
+*/
+DeviceShapeF *dotDeviceMatricesF(const DeviceShapeF *s1, const DeviceShapeF *s2);
+/*!
+    @brief Multiplies a device vector by a device matrix
+
+    @param m The matrix which will multiply the vector
+    @param v The vector which will be multiplied by the matrix, it must have one element for every column in the matrix
+
+    @returns A new device vector with one element for every row in the matrix
+
+    @see matVecF()
+*/
+DeviceShapeF *matVecDeviceF(const DeviceShapeF *m, const DeviceShapeF *v);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup BroadcastFOps Scalar and Broadcast Operations
+    @brief This topic includes the elementwise operations where one side is a scalar or a vector which is repeated over the rows or columns of a shape
+
+    @details
+    Scaling a matrix or adding a bias with the other elementwise functions needs a whole shape full of copies of the scalar or the vector, which has to be made, copied to the GPU and read by the kernel.
+    These functions pass the scalar as a kernel argument and copy only the vector, so they read half as much memory and copy half as much to the GPU.
+    The shape is always on the left of the operation, so SHAPE_SUBTRACT gives s - k and SHAPE_DIVIDE gives s / k.
+    @{
+*/
+
+/*!
+    @brief Applies an elementwise operation to every element of a host shape and a scalar
+
+    @param op The operation to apply
+    @param s The shape, it has r rows and c columns
+    @param k The scalar
+    @param out The shape which will store the result, it has the same size as s and it can be s
+    @param r Number of rows in the shape
+    @param c Number of columns in the shape
+*/
+void scalarShapesF(const ShapeOp op, const float *s, const float k, float *out, const unsigned int r, const unsigned int c);
+/*!
+    @brief Applies an elementwise operation to every element of a host shape and a scalar without waiting for it to finish
+
+    @param op The operation to apply
+    @param s The shape, it has r rows and c columns
+    @param k The scalar
+    @param out The shape which will store the result, it has the same size as s and it can be s
+    @param r Number of rows in the shape
+    @param c Number of columns in the shape
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host shapes must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see scalarShapesF()
+*/
+void scalarShapesFAsync(const ShapeOp op, const float *s, const float k, float *out, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Applies an elementwise operation to every element of a host shape and the element of a host vector in its column or row
+
+    @param op The operation to apply
+    @param s The shape, it has r rows and c columns
+    @param v The vector, it has c elements for BROADCAST_ROWS and r elements for BROADCAST_COLUMNS
+    @param out The shape which will store the result, it has the same size as s and it can be s
+    @param r Number of rows in the shape
+    @param c Number of columns in the shape
+    @param axis How the vector lines up with the shape
+*/
+void broadcastShapesF(const ShapeOp op, const float *s, const float *v, float *out, const unsigned int r, const unsigned int c, const BroadcastAxis axis);
+/*!
+    @brief Applies an elementwise operation to every element of a host shape and the element of a host vector in its column or row without waiting for it to finish
+
+    @param op The operation to apply
+    @param s The shape, it has r rows and c columns
+    @param v The vector, it has c elements for BROADCAST_ROWS and r elements for BROADCAST_COLUMNS
+    @param out The shape which will store the result, it has the same size as s and it can be s
+    @param r Number of rows in the shape
+    @param c Number of columns in the shape
+    @param axis How the vector lines up with the shape
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host shapes must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see broadcastShapesF()
+*/
+void broadcastShapesFAsync(const ShapeOp op, const float *s, const float *v, float *out, const unsigned int r, const unsigned int c, const BroadcastAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Applies an elementwise operation to every element of a device shape and a scalar
+
+    @param op The operation to apply
+    @param s The shape
+    @param k The scalar
+
+    @returns A new device shape with the result
+
+    @see scalarShapesF()
+*/
+DeviceShapeF *scalarDeviceShapesF(const ShapeOp op, const DeviceShapeF *s, const float k);
+/*!
+    @brief Applies an elementwise operation to every element of a device shape and a scalar and gives back the event of the operation
+
+    @param op The operation to apply
+    @param s The shape
+    @param k The scalar
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns A new device shape with the result, it can be used by other operations before event completes
+
+    @see scalarDeviceShapesF()
+*/
+DeviceShapeF *scalarDeviceShapesFAsync(const ShapeOp op, const DeviceShapeF *s, const float k, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Applies an elementwise operation to every element of a device shape and the element of a device vector in its column or row
+
+    @param op The operation to apply
+    @param s The shape
+    @param v The vector, it has one element per column of s for BROADCAST_ROWS and one per row for BROADCAST_COLUMNS
+    @param axis How the vector lines up with the shape
+
+    @returns A new device shape with the result
+
+    @see broadcastShapesF()
+*/
+DeviceShapeF *broadcastDeviceShapesF(const ShapeOp op, const DeviceShapeF *s, const DeviceShapeF *v, const BroadcastAxis axis);
+/*!
+    @brief Applies an elementwise operation to every element of a device shape and the element of a device vector in its column or row and gives back the event of the operation
+
+    @param op The operation to apply
+    @param s The shape
+    @param v The vector, it has one element per column of s for BROADCAST_ROWS and one per row for BROADCAST_COLUMNS
+    @param axis How the vector lines up with the shape
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns A new device shape with the result, it can be used by other operations before event completes
+
+    @see broadcastDeviceShapesF()
+*/
+DeviceShapeF *broadcastDeviceShapesFAsync(const ShapeOp op, const DeviceShapeF *s, const DeviceShapeF *v, const BroadcastAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup GemmFOps Fused Matrix Products
+    @brief This topic includes the dot product which scales, adds a bias and applies an activation before storing its result
+
+    @details
+    A dense layer made of dotMatricesF(), addShapesF() and an activation writes its whole result to memory three times and copies it between the host and GPU each time.
+    These functions calculate activation(alpha * s1 . s2 + beta * s3 + bias) and apply everything after the dot product to the sums while they are still in registers, so the result is stored once.
+    When beta is 0, s3 is not read so it can be uninitialized, and the bias is one element per column of the result like the vector of BROADCAST_ROWS.
+    @{
+*/
+
+/*!
+    @brief Calculates activation(alpha * s1 . s2 + beta * s3 + bias) into s3
+
+    @param s1 The first matrix, it has r rows and c columns
+    @param s2 The second matrix, it has c rows and c2 columns
+    @param s3 The matrix which will contain the result, it has r rows and c2 columns and it is only read when beta is not 0
+    @param r Number of rows in s1 and s3
+    @param c Number of columns in s1 and rows in s2
+    @param c2 Number of columns in s2 and s3
+    @param alpha What the dot product is multiplied by
+    @param beta What the elements s3 had before are multiplied by
+    @param bias A vector with c2 elements which is added to every row, this can be NULL for no bias
+    @param activation The function applied to every element last
+
+    @remarks
+    The matrices are multiplied in 64 by 64 blocks like dotMatricesF(), with alpha 1, beta 0, no bias and ACTIVATION_NONE it gives the same result.
+*/
+void gemmF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2, const float alpha, const float beta, const float *bias, const Activation activation);
+/*!
+    @brief Starts gemmF() without waiting for it to finish
+
+    @param s1 The first matrix, it has r rows and c columns
+    @param s2 The second matrix, it has c rows and c2 columns
+    @param s3 The matrix which will contain the result, it has r rows and c2 columns and it is only read when beta is not 0
+    @param r Number of rows in s1 and s3
+    @param c Number of columns in s1 and rows in s2
+    @param c2 Number of columns in s2 and s3
+    @param alpha What the dot product is multiplied by
+    @param beta What the elements s3 had before are multiplied by
+    @param bias A vector with c2 elements which is added to every row, this can be NULL for no bias
+    @param activation The function applied to every element last
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host shapes must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see gemmF()
+*/
+void gemmFAsync(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2, const float alpha, const float beta, const float *bias, const Activation activation, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Calculates activation(alpha * s1 . s2 + beta * s3 + bias) on device shapes
+
+    @param s1 The first matrix
+    @param s2 The second matrix, it has as many rows as s1 has columns
+    @param s3 A matrix with the rows of s1 and the columns of s2, it is only read when beta is not 0 and can be NULL otherwise
+    @param alpha What the dot product is multiplied by
+    @param beta What the elements of s3 are multiplied by
+    @param bias A vector with one element per column of s2 which is added to every row, this can be NULL for no bias
+    @param activation The function applied to every element last
+
+    @returns A new device shape with the result
+
+    @see gemmF()
+*/
+DeviceShapeF *gemmDeviceF(const DeviceShapeF *s1, const DeviceShapeF *s2, const DeviceShapeF *s3, const float alpha, const float beta, const DeviceShapeF *bias, const Activation activation);
+/*!
+    @brief Calculates activation(alpha * s1 . s2 + beta * s3 + bias) on device shapes and gives back the event of the operation
+
+    @param s1 The first matrix
+    @param s2 The second matrix, it has as many rows as s1 has columns
+    @param s3 A matrix with the rows of s1 and the columns of s2, it is only read when beta is not 0 and can be NULL otherwise
+    @param alpha What the dot product is multiplied by
+    @param beta What the elements of s3 are multiplied by
+    @param bias A vector with one element per column of s2 which is added to every row, this can be NULL for no bias
+    @param activation The function applied to every element last
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns A new device shape with the result, it can be used by other operations before event completes
+
+    @see gemmDeviceF()
+*/
+DeviceShapeF *gemmDeviceFAsync(const DeviceShapeF *s1, const DeviceShapeF *s2, const DeviceShapeF *s3, const float alpha, const float beta, const DeviceShapeF *bias, const Activation activation, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup StridedFOps Transposed and Strided Products
+    @brief This topic includes the dot products and matrix vector products of transposed matrices and of blocks of bigger matrices
+
+    @details
+    The other products need dense matrices that are not transposed, so using a transpose or a block of a matrix means copying it into a new array first.
+    These functions take the matrices as they are stored, like BLAS does, with a flag for whether each one is transposed and the elements between the starts of two rows of each one as it is stored.
+    A matrix which is transposed as it is used is stored with its rows and columns swapped, so ld1 of a transposed s1 is at least r and ld1 of s1 that is not transposed is at least c.
+    The kernels read transposed matrices in place in the order they are stored, and only the elements inside a block are copied to the GPU, so neither a transpose nor a block is ever copied on the host.
+    @{
+*/
+
+/*!
+    @brief Calculates the dot product of two matrices which can be transposed and blocks of bigger matrices
+
+    @param trans1 Whether s1 is used as it is stored or transposed
+    @param trans2 Whether s2 is used as it is stored or transposed
+    @param s1 The first matrix, it has r rows and c columns once trans1 is applied
+    @param ld1 Elements between the starts of two rows of s1 as it is stored
+    @param s2 The second matrix, it has c rows and c2 columns once trans2 is applied
+    @param ld2 Elements between the starts of two rows of s2 as it is stored
+    @param s3 The matrix which will contain the result, it has r rows and c2 columns
+    @param ld3 Elements between the starts of two rows of s3
+    @param r Number of rows in the result
+    @param c Number of elements each sum of the dot product goes over
+    @param c2 Number of columns in the result
+
+    @see dotMatricesF()
+*/
+void dotMatricesStridedF(const Transpose trans1, const Transpose trans2, const float *s1, const unsigned int ld1, const float *s2, const unsigned int ld2, float *s3, const unsigned int ld3, const unsigned int r, const unsigned int c, const unsigned int c2);
+/*!
+    @brief Starts dotMatricesStridedF() without waiting for it to finish
+
+    @param trans1 Whether s1 is used as it is stored or transposed
+    @param trans2 Whether s2 is used as it is stored or transposed
+    @param s1 The first matrix, it has r rows and c columns once trans1 is applied
+    @param ld1 Elements between the starts of two rows of s1 as it is stored
+    @param s2 The second matrix, it has c rows and c2 columns once trans2 is applied
+    @param ld2 Elements between the starts of two rows of s2 as it is stored
+    @param s3 The matrix which will contain the result, it has r rows and c2 columns
+    @param ld3 Elements between the starts of two rows of s3
+    @param r Number of rows in the result
+    @param c Number of elements each sum of the dot product goes over
+    @param c2 Number of columns in the result
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host shapes must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see dotMatricesStridedF()
+*/
+void dotMatricesStridedFAsync(const Transpose trans1, const Transpose trans2, const float *s1, const unsigned int ld1, const float *s2, const unsigned int ld2, float *s3, const unsigned int ld3, const unsigned int r, const unsigned int c, const unsigned int c2, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Calculates activation(alpha * s1 . s2 + beta * s3 + bias) into s3 with matrices which can be transposed and blocks of bigger matrices
+
+    @param trans1 Whether s1 is used as it is stored or transposed
+    @param trans2 Whether s2 is used as it is stored or transposed
+    @param s1 The first matrix, it has r rows and c columns once trans1 is applied
+    @param ld1 Elements between the starts of two rows of s1 as it is stored
+    @param s2 The second matrix, it has c rows and c2 columns once trans2 is applied
+    @param ld2 Elements between the starts of two rows of s2 as it is stored
+    @param s3 The matrix which will contain the result, it has r rows and c2 columns
+    @param ld3 Elements between the starts of two rows of s3
+    @param r Number of rows in the result
+    @param c Number of elements each sum of the dot product goes over
+    @param c2 Number of columns in the result
+    @param alpha What the dot product is multiplied by
+    @param beta What the elements s3 had before are multiplied by, s3 is only read when this is not 0
+    @param bias A vector with c2 elements which is added to every row, this can be NULL for no bias
+    @param activation The function applied to every element last
+
+    @see gemmF()
+*/
+void gemmStridedF(const Transpose trans1, const Transpose trans2, const float *s1, const unsigned int ld1, const float *s2, const unsigned int ld2, float *s3, const unsigned int ld3, const unsigned int r, const unsigned int c, const unsigned int c2, const float alpha, const float beta, const float *bias, const Activation activation);
+/*!
+    @brief Starts gemmStridedF() without waiting for it to finish
+
+    @param trans1 Whether s1 is used as it is stored or transposed
+    @param trans2 Whether s2 is used as it is stored or transposed
+    @param s1 The first matrix, it has r rows and c columns once trans1 is applied
+    @param ld1 Elements between the starts of two rows of s1 as it is stored
+    @param s2 The second matrix, it has c rows and c2 columns once trans2 is applied
+    @param ld2 Elements between the starts of two rows of s2 as it is stored
+    @param s3 The matrix which will contain the result, it has r rows and c2 columns
+    @param ld3 Elements between the starts of two rows of s3
+    @param r Number of rows in the result
+    @param c Number of elements each sum of the dot product goes over
+    @param c2 Number of columns in the result
+    @param alpha What the dot product is multiplied by
+    @param beta What the elements s3 had before are multiplied by, s3 is only read when this is not 0
+    @param bias A vector with c2 elements which is added to every row, this can be NULL for no bias
+    @param activation The function applied to every element last
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host shapes must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see gemmStridedF()
+*/
+void gemmStridedFAsync(const Transpose trans1, const Transpose trans2, const float *s1, const unsigned int ld1, const float *s2, const unsigned int ld2, float *s3, const unsigned int ld3, const unsigned int r, const unsigned int c, const unsigned int c2, const float alpha, const float beta, const float *bias, const Activation activation, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Multiplies a vector by a matrix which can be transposed and a block of a bigger matrix
+
+    @param trans Whether m is used as it is stored or transposed
+    @param m The matrix, it has r rows and c columns once trans is applied
+    @param ld Elements between the starts of two rows of m as it is stored
+    @param v The vector which will be multiplied by the matrix, it has c elements
+    @param out The vector which will store the result, it has r elements
+    @param r Number of rows in the matrix once trans is applied and the number of elements in the result
+    @param c Number of columns in the matrix once trans is applied and the number of elements in the vector
+
+    @remarks
+    A transposed matrix is summed down its stored columns with every work item doing one element of the result, so it is read in the order it is stored.
+
+    @see matVecF()
+*/
+void matVecStridedF(const Transpose trans, const float *m, const unsigned int ld, const float *v, float *out, const unsigned int r, const unsigned int c);
+/*!
+    @brief Starts matVecStridedF() without waiting for it to finish
+
+    @param trans Whether m is used as it is stored or transposed
+    @param m The matrix, it has r rows and c columns once trans is applied
+    @param ld Elements between the starts of two rows of m as it is stored
+    @param v The vector which will be multiplied by the matrix, it has c elements
+    @param out The vector which will store the result, it has r elements
+    @param r Number of rows in the matrix once trans is applied and the number of elements in the result
+    @param c Number of columns in the matrix once trans is applied and the number of elements in the vector
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host shapes must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see matVecStridedF()
+*/
+void matVecStridedFAsync(const Transpose trans, const float *m, const unsigned int ld, const float *v, float *out, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup SparseFOps Sparse Matrices
+    @brief This topic includes the matrix vector products and dot products of sparse matrices stored in compressed sparse row form
+
+    @details
+    A matrix in compressed sparse row (CSR) form keeps only its nonzeros, so a matrix that is mostly zeros takes a small part of the memory and bandwidth of the dense form.
+    The nonzeros are stored row after row in values with their columns in cols, and row_ptr has the offset of the first nonzero of every row followed by the number of nonzeros.
+    The matrix vector product splits every row over a few work items picked from the average number of nonzeros in a row, and the dot product with a dense matrix gives every element of the result its own work item so the rows of the dense matrix are read in order.
+    Like the dense operations, the host functions run small products on the CPU backend, and a DeviceCsrF keeps a sparse matrix on the GPU so it is only copied once.
+    @{
+*/
+
+/*!
+    @brief Multiplies a vector by a sparse matrix
+
+    @param row_ptr r + 1 offsets into cols and values, the nonzeros of row i are at row_ptr[i] up to row_ptr[i + 1] and row_ptr[0] is 0
+    @param cols The column of every nonzero
+    @param values The value of every nonzero
+    @param v The vector which will be multiplied by the matrix, it has c elements
+    @param out The vector which will store the result, it has r elements
+    @param r Number of rows in the matrix
+    @param c Number of columns in the matrix
+
+    @see matVecF()
+*/
+void csrMatVecF(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const float *v, float *out, const unsigned int r, const unsigned int c);
+/*!
+    @brief Starts csrMatVecF() without waiting for it to finish
+
+    @param row_ptr r + 1 offsets into cols and values, the nonzeros of row i are at row_ptr[i] up to row_ptr[i + 1] and row_ptr[0] is 0
+    @param cols The column of every nonzero
+    @param values The value of every nonzero
+    @param v The vector which will be multiplied by the matrix, it has c elements
+    @param out The vector which will store the result, it has r elements
+    @param r Number of rows in the matrix
+    @param c Number of columns in the matrix
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host arrays must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see csrMatVecF()
+*/
+void csrMatVecFAsync(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const float *v, float *out, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Calculates the dot product of a sparse matrix and a dense matrix
+
+    @param row_ptr r + 1 offsets into cols and values, the nonzeros of row i are at row_ptr[i] up to row_ptr[i + 1] and row_ptr[0] is 0
+    @param cols The column of every nonzero
+    @param values The value of every nonzero
+    @param s2 The dense matrix, it has c rows and c2 columns
+    @param s3 The dense matrix which will contain the result, it has r rows and c2 columns
+    @param r Number of rows in the sparse matrix
+    @param c Number of columns in the sparse matrix and rows in s2
+    @param c2 Number of columns in s2
+
+    @see dotMatricesF()
+*/
+void csrDotMatricesF(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2);
+/*!
+    @brief Starts csrDotMatricesF() without waiting for it to finish
+
+    @param row_ptr r + 1 offsets into cols and values, the nonzeros of row i are at row_ptr[i] up to row_ptr[i + 1] and row_ptr[0] is 0
+    @param cols The column of every nonzero
+    @param values The value of every nonzero
+    @param s2 The dense matrix, it has c rows and c2 columns
+    @param s3 The dense matrix which will contain the result, it has r rows and c2 columns
+    @param r Number of rows in the sparse matrix
+    @param c Number of columns in the sparse matrix and rows in s2
+    @param c2 Number of columns in s2
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host arrays must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see csrDotMatricesF()
+*/
+void csrDotMatricesFAsync(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Copies a sparse matrix to GPU memory
+
+    @param row_ptr r + 1 offsets into cols and values, the nonzeros of row i are at row_ptr[i] up to row_ptr[i + 1] and row_ptr[0] is 0
+    @param cols The column of every nonzero
+    @param values The value of every nonzero
+    @param r Number of rows in the matrix
+    @param c Number of columns in the matrix
+
+    @returns The new device sparse matrix
+*/
+DeviceCsrF *createDeviceCsrF(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const unsigned int r, const unsigned int c);
+/*!
+    @brief Copies a sparse matrix to GPU memory without waiting for the copy to finish
+
+    @param row_ptr r + 1 offsets into cols and values, the nonzeros of row i are at row_ptr[i] up to row_ptr[i + 1] and row_ptr[0] is 0
+    @param cols The column of every nonzero
+    @param values The value of every nonzero
+    @param r Number of rows in the matrix
+    @param c Number of columns in the matrix
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns The new device sparse matrix, it can be used by other operations before event completes
+
+    @remarks
+    The host arrays must not be freed or changed until event completes.
+
+    @see createDeviceCsrF()
+*/
+DeviceCsrF *createDeviceCsrFAsync(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Copies a device sparse matrix back to the host
+
+    @param s The device sparse matrix to copy
+    @param row_ptr This will contain the r + 1 row offsets, it can be NULL if they are not needed
+    @param cols This will contain the column of every nonzero, it can be NULL if they are not needed
+    @param values This will contain the value of every nonzero, it can be NULL if they are not needed
+
+    @remarks
+    This waits for every operation that was queued before it to finish.
+*/
+void downloadDeviceCsrF(const DeviceCsrF *s, unsigned int *row_ptr, unsigned int *cols, float *values);
+/*!
+    @brief Gives the amount of rows, columns and nonzeros in a device sparse matrix
+
+    @param s The device sparse matrix
+    @param r This will contain the amount of rows
+    @param c This will contain the amount of columns
+    @param nnz This will contain the amount of nonzeros
+*/
+void getDeviceCsrSizeF(const DeviceCsrF *s, unsigned int *r, unsigned int *c, unsigned int *nnz);
+/*!
+    @brief Frees the GPU memory of a device sparse matrix
+
+    @param s The device sparse matrix to free, this can be NULL
+*/
+void freeDeviceCsrF(DeviceCsrF *s);
+/*!
+    @brief Multiplies a device vector by a device sparse matrix
+
+    @param m The sparse matrix which will multiply the vector
+    @param v The vector which will be multiplied by the matrix, it must have one element for every column in the matrix
+
+    @returns A new device vector with one element for every row in the matrix
+
+    @see csrMatVecF()
+*/
+DeviceShapeF *csrMatVecDeviceF(const DeviceCsrF *m, const DeviceShapeF *v);
+/*!
+    @brief Multiplies a device vector by a device sparse matrix and gives back the event of the operation
+
+    @param m The sparse matrix which will multiply the vector
+    @param v The vector which will be multiplied by the matrix, it must have one element for every column in the matrix
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns A new device vector with the result, it can be used by other operations before event completes
+
+    @see csrMatVecDeviceF()
+*/
+DeviceShapeF *csrMatVecDeviceFAsync(const DeviceCsrF *m, const DeviceShapeF *v, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Calculates the dot product of a device sparse matrix and a dense device matrix
+
+    @param s1 The sparse matrix, it has r rows and c columns
+    @param s2 The dense matrix, it has c rows and c2 columns
+
+    @returns A new device matrix with r rows and c2 columns
+
+    @see csrDotMatricesF()
+*/
+DeviceShapeF *csrDotDeviceMatricesF(const DeviceCsrF *s1, const DeviceShapeF *s2);
+/*!
+    @brief Calculates the dot product of a device sparse matrix and a dense device matrix and gives back the event of the operation
+
+    @param s1 The sparse matrix, it has r rows and c columns
+    @param s2 The dense matrix, it has c rows and c2 columns
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns A new device matrix with the result, it can be used by other operations before event completes
+
+    @see csrDotDeviceMatricesF()
+*/
+DeviceShapeF *csrDotDeviceMatricesFAsync(const DeviceCsrF *s1, const DeviceShapeF *s2, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup ReduceFOps Reductions
+    @brief This topic includes the functions that combine the elements of a shape, or of every row or column of it, into sums, norms, maximums, argmaxes, log sum exps and dot products
+
+    @details
+    Every row or column, or the whole shape for REDUCE_ALL, is split over several work groups when there are too few of them to fill the GPU.
+    Each work group adds up its part in local memory as a tree and a second kernel combines the parts, so the work is spread over the whole GPU whatever the axis is.
+    The device versions take device shapes and give back a device vector, so the results of a training step can stay on the GPU without downloading the shapes that were reduced.
+    The host versions run on the CPU backend when that is faster, the same way the elementwise functions do, see @ref DispatchFuncs.
+    Sums are kept in floats on the GPU and in doubles on the CPU backend so the two may differ in the last bits.
+    Argmaxes are given as floats, which hold every index below 16777216 exactly.
+    @{
+*/
+
+/*!
+    @brief Reduces a host shape
+
+    @param s The shape to reduce, it has r rows and c columns
+    @param out The shape which will store the result, it has 1 element for REDUCE_ALL, r for REDUCE_ROWS and c for REDUCE_COLUMNS
+    @param r Number of rows in the shape
+    @param c Number of columns in the shape
+    @param op What the elements are combined into
+    @param axis Which elements are combined
+*/
+void reduceShapeF(const float *s, float *out, const unsigned int r, const unsigned int c, const ReduceOp op, const ReduceAxis axis);
+/*!
+    @brief Reduces a host shape without waiting for it to finish
+
+    @param s The shape to reduce, it has r rows and c columns
+    @param out The shape which will store the result, it has 1 element for REDUCE_ALL, r for REDUCE_ROWS and c for REDUCE_COLUMNS
+    @param r Number of rows in the shape
+    @param c Number of columns in the shape
+    @param op What the elements are combined into
+    @param axis Which elements are combined
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host shapes must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see reduceShapeF()
+*/
+void reduceShapeFAsync(const float *s, float *out, const unsigned int r, const unsigned int c, const ReduceOp op, const ReduceAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Calculates the dot products of two host shapes, of the whole shapes or of every pair of rows or columns
+
+    @param s1 The first shape, it has r rows and c columns
+    @param s2 The second shape, it has the same size as s1
+    @param out The shape which will store the result, it has 1 element for REDUCE_ALL, r for REDUCE_ROWS and c for REDUCE_COLUMNS
+    @param r Number of rows in the shapes
+    @param c Number of columns in the shapes
+    @param axis Which products are added up
+*/
+void dotVectorsF(const float *s1, const float *s2, float *out, const unsigned int r, const unsigned int c, const ReduceAxis axis);
+/*!
+    @brief Calculates the dot products of two host shapes without waiting for it to finish
+
+    @param s1 The first shape, it has r rows and c columns
+    @param s2 The second shape, it has the same size as s1
+    @param out The shape which will store the result, it has 1 element for REDUCE_ALL, r for REDUCE_ROWS and c for REDUCE_COLUMNS
+    @param r Number of rows in the shapes
+    @param c Number of columns in the shapes
+    @param axis Which products are added up
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host shapes must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see dotVectorsF()
+*/
+void dotVectorsFAsync(const float *s1, const float *s2, float *out, const unsigned int r, const unsigned int c, const ReduceAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Reduces a device shape
+
+    @param s The shape to reduce
+    @param op What the elements are combined into
+    @param axis Which elements are combined
+
+    @returns A new device vector with 1 element for REDUCE_ALL, one per row for REDUCE_ROWS and one per column for REDUCE_COLUMNS
+
+    @see reduceShapeF()
+*/
+DeviceShapeF *reduceDeviceShapeF(const DeviceShapeF *s, const ReduceOp op, const ReduceAxis axis);
+/*!
+    @brief Reduces a device shape and gives back the event of the operation
+
+    @param s The shape to reduce
+    @param op What the elements are combined into
+    @param axis Which elements are combined
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns A new device vector with the result, it can be used by other operations before event completes
+
+    @see reduceDeviceShapeF()
+*/
+DeviceShapeF *reduceDeviceShapeFAsync(const DeviceShapeF *s, const ReduceOp op, const ReduceAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Calculates the dot products of two device shapes, of the whole shapes or of every pair of rows or columns
+
+    @param s1 The first shape
+    @param s2 The second shape, it must have the same size as s1
+    @param axis Which products are added up
+
+    @returns A new device vector with 1 element for REDUCE_ALL, one per row for REDUCE_ROWS and one per column for REDUCE_COLUMNS
+
+    @see dotVectorsF()
+*/
+DeviceShapeF *dotDeviceVectorsF(const DeviceShapeF *s1, const DeviceShapeF *s2, const ReduceAxis axis);
+/*!
+    @brief Calculates the dot products of two device shapes and gives back the event of the operation
+
+    @param s1 The first shape
+    @param s2 The second shape, it must have the same size as s1
+    @param axis Which products are added up
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns A new device vector with the result, it can be used by other operations before event completes
+
+    @see dotDeviceVectorsF()
+*/
+DeviceShapeF *dotDeviceVectorsFAsync(const DeviceShapeF *s1, const DeviceShapeF *s2, const ReduceAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup AsyncFOps Asynchronous Operations
+    @brief This topic includes versions of the operations that return as soon as their work is queued on the GPU
+
+    @details
+    Every function here takes a list of events to wait for before it starts and can give back an event which completes when it is done, the same way the OpenCL enqueue functions do.
+    This lets the host prepare the next operation while the GPU is still copying or computing the last one.
+    The other functions are the same as calling these and then waiting for the event.
+    @{
+*/
+
+/*!
+    @brief Adds two shapes without waiting for it to finish
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This is the third shape which will contain the result, it must have sizeof(float) * r * c allocated
+    @param r This is the amount of rows in shapes 1 and 2
+    @param c This is the amount of columns in shapes 1 and 2
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host shapes must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see addShapesF()
+*/
+void addShapesFAsync(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Subtracts two shapes without waiting for it to finish
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This is the third shape which will contain the result, it must have sizeof(float) * r * c allocated
+    @param r This is the amount of rows in shapes 1 and 2
+    @param c This is the amount of columns in shapes 1 and 2
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host shapes must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see subtractShapesF()
+*/
+void subtractShapesFAsync(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Crosses two matrices or multiplies two vectors without waiting for it to finish
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This is the third shape which will contain the result, it must have sizeof(float) * r * c allocated
+    @param r This is the amount of rows in shapes 1 and 2
+    @param c This is the amount of columns in shapes 1 and 2
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host shapes must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see crossShapesF()
+*/
+void crossShapesFAsync(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Divides two shapes without waiting for it to finish
+
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This is the third shape which will contain the result, it must have sizeof(float) * r * c allocated
+    @param r This is the amount of rows in shapes 1 and 2
+    @param c This is the amount of columns in shapes 1 and 2
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host shapes must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see divideShapesF()
+*/
+void divideShapesFAsync(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Calculates the dot product of 2 matrices without waiting for it to finish
+
+    @param s1 This is the first matrix to be used in the dot product
+    @param s2 This is the second matrix to be used in the dot product
+    @param s3 This is the third matrix which will contain the dot product, it must have sizeof(float) * r * c2 allocated
+    @param r This is the number of rows in the first and third matrices
+    @param c This is the number of columns in the first matrix and the number of rows in the second matrix
+    @param c2 This is the number of columns in the second and third matrix
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host shapes must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see dotMatricesF()
+*/
+void dotMatricesFAsync(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Multiplies a vector by a matrix without waiting for it to finish
+
+    @param m The matrix which will multiply the vector
+    @param v The vector which will be multiplied by the matrix, it has c elements
+    @param out The vector which will store the result, it has r elements
+    @param r Number of rows in the matrix and the number of elements in the result
+    @param c Number of columns in the matrix and the number of elements in the vector
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host shapes must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see matVecF()
+*/
+void matVecFAsync(const float *m, const float *v, float *out, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Creates a shape in GPU memory without waiting for the copy to finish
+
+    @param s The elements of the shape to copy to the GPU, this can be NULL to leave the elements uninitialized
+    @param r This is the amount of rows in the shape
+    @param c This is the amount of columns in the shape
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns The new device shape
+
+    @remarks
+    The host shape must not be freed or changed until event completes.
+
+    @see createDeviceShapeF()
+*/
+DeviceShapeF *createDeviceShapeFAsync(const float *s, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Copies a device shape back to the host without waiting for the copy to finish
+
+    @param s The device shape to copy
+    @param out The host shape which will contain the elements, it must have sizeof(float) * r * c allocated
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The elements at out are only ready once event completes.
+
+    @see downloadDeviceShapeF()
+*/
+void downloadDeviceShapeFAsync(const DeviceShapeF *s, float *out, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Adds two device shapes and gives back the event of the operation
+
+    @param s1 The first device shape
+    @param s2 The second device shape, it must have the same size as s1
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns A new device shape with the result, it can be used by other operations before event completes
+
+    @see addDeviceShapesF()
+*/
+DeviceShapeF *addDeviceShapesFAsync(const DeviceShapeF *s1, const DeviceShapeF *s2, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Subtracts two device shapes and gives back the event of the operation
+
+    @param s1 The first device shape
+    @param s2 The second device shape, it must have the same size as s1
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns A new device shape with the result, it can be used by other operations before event completes
+
+    @see subtractDeviceShapesF()
+*/
+DeviceShapeF *subtractDeviceShapesFAsync(const DeviceShapeF *s1, const DeviceShapeF *s2, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Crosses two device matrices or multiplies two device vectors and gives back the event of the operation
+
+    @param s1 The first device shape
+    @param s2 The second device shape, it must have the same size as s1
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns A new device shape with the result, it can be used by other operations before event completes
+
+    @see crossDeviceShapesF()
+*/
+DeviceShapeF *crossDeviceShapesFAsync(const DeviceShapeF *s1, const DeviceShapeF *s2, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Divides two device shapes and gives back the event of the operation
+
+    @param s1 The first device shape
+    @param s2 The second device shape, it must have the same size as s1
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns A new device shape with the result, it can be used by other operations before event completes
+
+    @see divideDeviceShapesF()
+*/
+DeviceShapeF *divideDeviceShapesFAsync(const DeviceShapeF *s1, const DeviceShapeF *s2, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Calculates the dot product of 2 device matrices and gives back the event of the operation
+
+    @param s1 The first matrix, it has r rows and c columns
+    @param s2 The second matrix, it has c rows and c2 columns
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns A new device shape with the result, it can be used by other operations before event completes
+
+    @see dotDeviceMatricesF()
+*/
+DeviceShapeF *dotDeviceMatricesFAsync(const DeviceShapeF *s1, const DeviceShapeF *s2, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Multiplies a device vector by a device matrix and gives back the event of the operation
+
+    @param m The matrix which will multiply the vector
+    @param v The vector which will be multiplied by the matrix, it must have one element for every column in the matrix
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @returns A new device shape with the result, it can be used by other operations before event completes
+
+    @see matVecDeviceF()
+*/
+DeviceShapeF *matVecDeviceFAsync(const DeviceShapeF *m, const DeviceShapeF *v, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup StreamFOps Streaming Operations
+    @brief This topic includes versions of the operations that split large shapes into chunks of rows so copying and computing overlap
+
+    @details
+    Uploads, kernels and downloads each run on their own queue, so while one chunk is computing the next chunk is uploading and the last chunk is downloading.
+    Three chunks are kept on the GPU at a time so the GPU memory used only depends on chunk_rows and not on the size of the shapes.
+    @{
+*/
+
+/*!
+    @brief Runs an elementwise operation on two large shapes one chunk of rows at a time
+
+    @param op The elementwise operation to run
+    @param s1 This is the first shape
+    @param s2 This is the second shape
+    @param s3 This is the third shape which will contain the result, it must have sizeof(float) * r * c allocated
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+    @param chunk_rows The amount of rows in every chunk, 0 or anything above r uses a single chunk
+
+    @see addShapesF()
+    @see subtractShapesF()
+    @see crossShapesF()
+    @see divideShapesF()
+*/
+void streamShapesF(const ShapeOp op, const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, unsigned int chunk_rows);
+/*!
+    @brief Multiplies a vector by a large matrix one chunk of rows at a time
+
+    @param m The matrix which will multiply the vector
+    @param v The vector which will be multiplied by the matrix, it has c elements and is only copied to the GPU once
+    @param out The vector which will store the result, it has r elements
+    @param r Number of rows in the matrix and the number of elements in the result
+    @param c Number of columns in the matrix and the number of elements in the vector
+    @param chunk_rows The amount of rows in every chunk, 0 or anything above r uses a single chunk
+
+    @see matVecF()
+*/
+void streamMatVecF(const float *m, const float *v, float *out, const unsigned int r, const unsigned int c, unsigned int chunk_rows);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup ExprFOps Fused Expressions
+    @brief This topic includes the functions that run a chain of elementwise operations as a single kernel
+
+    @details
+    Calling addShapesF(), crossShapesF() and divideShapesF() one after another reads and writes every element once per call.
+    An expression like (a + b) * d / 2 can instead be built with these functions and run with evalExprF() or evalDeviceExprF(), which generate one kernel for the whole expression so every element is only read and written once.
+    The kernel of an expression is built the first time it is run and reused after that, even if its scalars change.
+
+    @code
+    ShapeExprF *e = exprOpF(SHAPE_DIVIDE, exprOpF(SHAPE_CROSS, exprOpF(SHAPE_ADD, exprInputF(0), exprInputF(1)), exprInputF(2)), exprScalarF(2.0f));
+    const float *inputs[3] = {a, b, d};
+    evalExprF(e, inputs, 3, out, rows, cols);
+    freeExprF(e);
+    @endcode
+    @{
+*/
+
+/*!
+    @brief Makes an expression that reads one of the input shapes
+
+    @param index The index of the input in the inputs given to evalExprF() or evalDeviceExprF()
+
+    @returns The new expression
+*/
+ShapeExprF *exprInputF(const unsigned int index);
+/*!
+    @brief Makes an expression that is the same scalar for every element
+
+    @param value The scalar
+
+    @returns The new expression
+*/
+ShapeExprF *exprScalarF(const float value);
+/*!
+    @brief Makes an expression that runs an elementwise operation on two other expressions
+
+    @param op The elementwise operation
+    @param a The expression on the left side of the operation
+    @param b The expression on the right side of the operation
+
+    @returns The new expression, it owns a and b so they are freed with it
+
+    @remarks
+    An expression can only be given to exprOpF() once because it is freed with the expression that owns it.
+*/
+ShapeExprF *exprOpF(const ShapeOp op, ShapeExprF *a, ShapeExprF *b);
+/*!
+    @brief Frees an expression and every expression it owns
+
+    @param e The expression to free, this can be NULL
+*/
+void freeExprF(ShapeExprF *e);
+/*!
+    @brief Runs an expression on host shapes with a single fused kernel
+
+    @param e The expression to run
+    @param inputs The input shapes, exprInputF(i) reads inputs[i]
+    @param num_inputs The amount of input shapes, it must be more than the largest index used by the expression
+    @param out The shape which will contain the result, it must have sizeof(float) * r * c allocated
+    @param r This is the amount of rows in the shapes
+    @param c This is the amount of columns in the shapes
+*/
+void evalExprF(const ShapeExprF *e, const float **inputs, const unsigned int num_inputs, float *out, const unsigned int r, const unsigned int c);
+/*!
+    @brief Runs an expression on device shapes with a single fused kernel
+
+    @param e The expression to run
+    @param inputs The input shapes, they must all be the same size
+    @param num_inputs The amount of input shapes, it must be more than the largest index used by the expression
+
+    @returns A new device shape with the result, it has the same size as the inputs, or NULL and CL_INVALID_VALUE if there are no inputs or they are not all the same size
+*/
+DeviceShapeF *evalDeviceExprF(const ShapeExprF *e, const DeviceShapeF **inputs, const unsigned int num_inputs);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup GraphFuncs Command Graphs
+    @brief This topic includes the functions that record a fixed sequence of device operations once and replay it with one call
+
+    @details
+    Every device operation sets the arguments of its kernels and works out its work sizes on the host each time it is called, which adds up for a pipeline that runs the same operations every frame.
+    Between beginCommandGraph() and endCommandGraph() the device operations of the current GPU are recorded instead of run: every kernel is kept with its arguments bound and its work sizes worked out, and the copies of createDeviceShapeFAsync() and downloadDeviceShapeFAsync() are kept with their host pointers.
+    Replaying the graph enqueues the recorded commands in order on the queue they were recorded for, so every command waits for the ones before it like it would have when it was recorded.
+    On GPUs with cl_khr_command_buffer a graph of kernels only is baked into a command buffer so the whole replay is a single enqueue, otherwise the prepared commands are enqueued one after another without setting any arguments.
+    @{
+*/
+
+/*!
+    @brief Starts recording the device operations of the current GPU into a new command graph
+
+    @details
+    While recording, the device operations return their device shapes as usual but nothing runs until the graph is replayed, and their events are already complete.
+    Only device shape operations can be recorded, operations on host shapes, calibrateDispatch() and tuneKernels() called before endCommandGraph() do nothing and fail with CL_INVALID_OPERATION, see getError().
+    Device shapes freed while recording are kept by the graph, every other device shape it uses must not be freed until the graph is released.
+*/
+void beginCommandGraph();
+/*!
+    @brief Stops recording and gives back the command graph
+
+    @returns The command graph, or NULL if a command could not be recorded or nothing was being recorded
+*/
+CommandGraph *endCommandGraph();
+/*!
+    @brief Runs every command of a graph and waits for them to finish
+
+    @param graph The command graph to replay, it must have been recorded on the current GPU
+*/
+void replayCommandGraph(const CommandGraph *graph);
+/*!
+    @brief Starts every command of a graph without waiting for them to finish
+
+    @param graph The command graph to replay, it must have been recorded on the current GPU
+    @param num_events The number of events in wait_list
+    @param wait_list Events which must complete before this operation starts, this can be NULL if num_events is 0
+    @param event This will contain an event which completes when the operation is done, this can be NULL if the event is not needed
+
+    @remarks
+    The host memory of the recorded copies must not be freed or changed until event completes.
+    The event must be released with clReleaseEvent() once it is not needed anymore.
+
+    @see replayCommandGraph()
+*/
+void replayCommandGraphAsync(const CommandGraph *graph, cl_uint num_events, const cl_event *wait_list, cl_event *event);
+/*!
+    @brief Gives the number of commands in a graph and whether it is replayed as a command buffer
+
+    @param graph The command graph
+    @param commands This will contain the number of recorded kernels and copies
+    @param command_buffer This will contain 1 if the graph was baked into a cl_khr_command_buffer, otherwise 0
+*/
+void getCommandGraphInfo(const CommandGraph *graph, unsigned int *commands, int *command_buffer);
+/*!
+    @brief Frees a command graph and the device shapes that were freed while it was recorded
+
+    @param graph The command graph to free, this can be NULL
+*/
+void releaseCommandGraph(CommandGraph *graph);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup FileFuncs Matrix Files
+    @brief This topic includes the functions that save matrices to files and map them back into memory without copying them
+
+    @details
+    A matrix file is a 64 byte header followed by the elements of the matrix row after row.
+    The header holds the magic "LAMATRIX", the version of the format, a marker for the byte order of the machine that wrote it, the type of the elements, the rows and columns, the offset of the elements and the alignment of that offset.
+    The elements start at a multiple of 4096 bytes and are padded with zeros to a multiple of 4096 bytes, so the mapped elements are page aligned like a shape made by createAlignedShapeF().
+    This means the pointer given by getMatrixFileData() can be passed to any of the operations as a host shape: the elements are copied straight from the mapped pages to the GPU, and on GPUs that share memory with the host they are used in place.
+    The pages are mapped copy on write, so shapes made from them can be changed without changing the file, and only the pages that are used are ever read from disk.
+    @{
+*/
+
+/*!
+    @brief Saves a matrix to a matrix file
+
+    @param path The path of the file, it is replaced if it exists
+    @param s The elements of the matrix
+    @param type The type of the elements
+    @param r The amount of rows in the matrix
+    @param c The amount of columns in the matrix
+
+    @returns 1 if the file was written, otherwise 0
+*/
+int saveMatrixFile(const char *path, const void *s, const MatrixType type, const unsigned int r, const unsigned int c);
+/*!
+    @brief Maps a matrix file into memory
+
+    @param path The path of the file
+
+    @returns The mapped file, or NULL if it could not be opened or is not a matrix file of this version and byte order
+*/
+MatrixFile *mapMatrixFile(const char *path);
+/*!
+    @brief Gives the elements of a mapped matrix file
+
+    @param file The mapped file
+
+    @returns A page aligned pointer to the elements, it can be used until unmapMatrixFile() is called
+*/
+void *getMatrixFileData(const MatrixFile *file);
+/*!
+    @brief Gives the type, rows and columns of a mapped matrix file
+
+    @param file The mapped file
+    @param type This will contain the type of the elements
+    @param r This will contain the amount of rows
+    @param c This will contain the amount of columns
+*/
+void getMatrixFileInfo(const MatrixFile *file, MatrixType *type, unsigned int *r, unsigned int *c);
+/*!
+    @brief Creates a device shape with the elements of a mapped float matrix file
+
+    @details
+    The elements are copied to the GPU straight from the mapped pages.
+    On GPUs that share memory with the host the device shape uses the mapped pages themselves, so the file must stay mapped until the device shape is freed.
+
+    @param file The mapped file, its type must be MATRIX_FLOAT
+
+    @returns The new device shape, or NULL if the file does not hold floats
+*/
+DeviceShapeF *createDeviceShapeFromFileF(const MatrixFile *file);
+/*!
+    @brief Unmaps a matrix file
+
+    @param file The mapped file, this can be NULL
+*/
+void unmapMatrixFile(MatrixFile *file);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup PoolFuncs Buffer Pool
+    @brief This topic includes the functions that control the pool of GPU buffers that operations reuse
+
+    @details
+    Every operation takes its GPU buffers from a pool and gives them back when it is done instead of creating and releasing them every call.
+    Buffers are grouped by size into power of two buckets, so a buffer can be reused by any operation that needs the same or a slightly smaller size.
+    The pool holds at most a quarter of the GPU memory by default, buffers given back after that are released.
+    @{
+*/
+
+/*!
+    @brief Sets the most bytes of GPU memory that the buffer pool will hold on to
+
+    @param bytes The new limit, the pool is trimmed if it already holds more than this
+*/
+void setBufferPoolLimit(const size_t bytes);
+/*!
+    @brief Releases every unused buffer in the buffer pool
+*/
+void trimBufferPool();
+/*!
+    @brief Gives the counters of the buffer pool
+
+    @param stats This will contain the counters
+*/
+void getBufferPoolStats(BufferPoolStats *stats);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup ProfilerFuncs Profiler
+    @brief This topic includes the functions that time the copies and kernels the other functions run
+
+    @details
+    While the profiler is running every copy to or from the GPU and every kernel is recorded with the function that ran it and the shape it ran on.
+    Recording only keeps the OpenCL event of the command, the times are read from the events when getProfileStats() or writeProfileTrace() need them.
+    Once thousands of events are held the times of the oldest commands are read as new ones are recorded, waiting for them if the GPU has fallen that far behind, so a profiler left running holds a bounded number of events.
+    Comparing the upload and download stats of a function to its kernel stats shows whether it is limited by copies or by computing.
+    @{
+*/
+
+/*!
+    @brief Starts recording commands
+*/
+void startProfiler();
+/*!
+    @brief Stops recording commands, the commands that were already recorded are kept
+*/
+void stopProfiler();
+/*!
+    @brief Forgets every recorded command
+*/
+void clearProfiler();
+/*!
+    @brief Gives the timings of the recorded commands grouped by function, kernel, kind and shape
+
+    @details
+    This waits for every recorded command to finish.
+    The op and name strings point into the profiler and are only valid until clearProfiler() is called.
+
+    @param stats This will contain the groups in the order they were first recorded
+    @param max_stats Most groups that fit in stats
+
+    @returns The number of groups, which can be more than max_stats
+*/
+unsigned int getProfileStats(ProfileStats *stats, const unsigned int max_stats);
+/*!
+    @brief Writes the recorded commands to a file in the Chrome trace format
+
+    @details
+    The file can be opened in chrome://tracing or Perfetto, uploads, kernels and downloads are shown on separate rows.
+    This waits for every recorded command to finish.
+
+    @param path The file to write
+
+    @returns 1 if the file was written, otherwise 0
+*/
+int writeProfileTrace(const char *path);
+/*!
+    @brief Gives the events and buffers the current device is holding
+
+    @details
+    The counts are kept whether or not the profiler is running and reading them does not wait for the GPU.
+    Events given to the caller of an asynchronous function belong to the caller and are not counted.
+    A buffer is counted by the device or context that made or released it, so device shapes freed by a different context than the one that made them move the counts apart.
+
+    @param stats This will contain the counts
+*/
+void getResourceStats(ResourceStats *stats);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup DispatchFuncs CPU and GPU Dispatch
+    @brief This topic includes the functions that control whether float operations on host shapes run on the GPU or the CPU backend
+
+    @details
+    Every float elementwise, dot product and matrix vector function on host shapes estimates how long it would take on both and runs where it is faster.
+    The GPU estimate is the kernel launch latency, the copies to and from the GPU and the work, and shapes the GPU can use without a copy, like ones from createAlignedShapeF() on GPUs with unified memory, add no copy time.
+    The speeds come from a short calibration the first time a decision is needed, which is saved next to the kernel cache and loaded again on later runs with the same device, driver and number of CPU threads.
+    Device shapes are already on the GPU so the device operations always run there.
+    @{
+*/
+
+/*!
+    @brief Picks where float operations on host shapes run
+
+    @param mode DISPATCH_AUTO uses the cost model, DISPATCH_GPU and DISPATCH_CPU always use the GPU or always use the CPU backend
+*/
+void setDispatchMode(const DispatchMode mode);
+/*!
+    @brief Measures the GPU and the CPU backend again and saves the new cost model
+
+    @details
+    This takes a fraction of a second and is only needed when the saved model is out of date, for example when other programs were loading the GPU while it was measured.
+*/
+void calibrateDispatch();
+/*!
+    @brief Gives the cost model, loading or calibrating it if it has not been yet
+
+    @param model This will contain the cost model
+*/
+void getCostModel(CostModel *model);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup TuneFuncs Auto-Tuning
+    @brief This topic includes the functions that pick the work group sizes, tile sizes and vector width of the float kernels for the GPU they run on
+
+    @details
+    The best sizes depend on the GPU, so tuneKernels() times the kernels with every candidate on the current device and keeps the fastest.
+    The vector width of the elementwise kernels and the tiles of the dot product are tuned first with operations on the largest size class since they are compiled into the kernels, then the work group sizes of the elementwise and matrix vector kernels are tuned for each size class.
+    The result is saved next to the kernel cache and loaded by gpuInit() on later runs with the same device and driver, so tuning only has to be done once.
+    If LINEARALGEBRA_TUNE is set gpuInit() tunes every device that has nothing saved, otherwise untuned devices use the defaults.
+    @{
+*/
+
+/*!
+    @brief Tunes the float kernels of the current device, saves the result and rebuilds the kernels with it
+
+    @details
+    This builds the kernels once for every candidate vector width and tile size, so it takes a few seconds the first time and less once the builds are in the kernel cache.
+    The cost model is measured again the next time it is needed because the tuned kernels are faster.
+*/
+void tuneKernels();
+/*!
+    @brief Gives the tuned settings of the current device, or the defaults if it has not been tuned
+
+    @param config This will contain the settings
+*/
+void getTuneConfig(TuneConfig *config);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup DeviceFuncs Multiple Devices
+    @brief This topic includes the functions that pick which GPU the other functions run on and split work across every GPU
+
+    @details
+    gpuInit() sets up every GPU on every OpenCL platform, each with its own context, queues, kernels, buffer pool, profiler and cost model, and starts with the first one as the current device.
+    All other functions run on the current device and the buffer pool, profiler and dispatch settings they use are the ones of the current device.
+    Every thread has its own current device, which starts as the first GPU, see @ref ThreadFuncs.
+    Device shapes and events belong to the device that was current when they were created and must only be used while it is current.
+    With multi device mode on, the synchronous float elementwise functions and dotMatricesF() split large operations across every GPU, each one getting a share of the rows or elements as big as its share of the compute units.
+    The asynchronous, batched and device shape functions always run on the current device only.
+    @{
+*/
+
+/*!
+    @brief Gives the number of GPUs gpuInit() found
+*/
+unsigned int gpuDeviceCount();
+/*!
+    @brief Gives one of the GPUs gpuInit() found
+
+    @param index The GPU to give, from 0 to gpuDeviceCount() - 1
+
+    @return The GPU or NULL if index is out of range
+*/
+GPU *gpuDevice(const unsigned int index);
+/*!
+    @brief Makes a GPU the one the other functions run on
+
+    @param device A GPU from gpuDevice() or a context from gpuCreateContext(), NULL is ignored
+
+    @details
+    This only changes the current device of the calling thread.
+*/
+void gpuUseDevice(GPU *device);
+/*!
+    @brief Gives the GPU or context the other functions run on in the calling thread
+*/
+GPU *gpuCurrentDevice();
+/*!
+    @brief Turns splitting large synchronous float elementwise operations and dot products across every GPU on or off, it is off by default
+
+    @param enabled 1 to split them and 0 to run everything on the current device
+*/
+void setMultiDevice(const int enabled);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup ThreadFuncs Threads
+    @brief This topic includes the functions that let several threads use a GPU at the same time
+
+    @details
+    A GPU from gpuDevice() holds kernels, queues, a buffer pool and a profiler which are changed by every call, so only one thread at a time may use it.
+    For threads to run operations at the same time each one makes its own context of a GPU with gpuCreateContext() and makes it current with gpuUseDevice().
+    A context shares the OpenCL context and the compiled programs of its GPU and has its own kernels, queues, buffer pool, profiler and error code, so contexts never wait on each other and throughput grows with the number of threads until the GPU is full.
+    Device shapes and events can be used by every context of the GPU they were created on, as long as the threads order the uses with events or by finishing them.
+    gpuInit(), gpuClean(), setMultiDevice() and multi device mode use the GPUs themselves and must not run while other threads are running operations.
+    The CPU backend runs one operation on all of its threads at a time and operations from other threads that start during it run on their own thread.
+    @{
+*/
+
+/*!
+    @brief Makes a context of a GPU for one thread to use
+
+    @details
+    The cost model of the GPU is loaded or calibrated first if it has not been yet, so this is best called before the threads start.
+
+    @param device A GPU from gpuDevice()
+
+    @return The context, which must be released with gpuReleaseContext() before gpuClean(), or NULL if device is NULL or not a GPU
+*/
+GPU *gpuCreateContext(GPU *device);
+/*!
+    @brief Releases a context made by gpuCreateContext()
+
+    @details
+    If the context is current in the calling thread the first GPU becomes current instead.
+
+    @param context The context to release
+*/
+void gpuReleaseContext(GPU *context);
+
+/*!
+    @}
+*/
+
+/*!
+    @defgroup ErrorFuncs Errors
+    @brief This topic includes the functions that report OpenCL errors of the other functions without stopping the program
+
+    @details
+    The other functions never stop the program, an operation that fails gives an event that has failed so the commands waiting on it fail too instead of reading missing results.
+    The current device keeps the first error since the last getError(), so a sequence of operations can be run and checked once at the end.
+    Errors of commands that fail while running on the GPU are only known once they finish, the synchronous functions see them when they wait but the asynchronous ones do not.
+    With deferred error checking on, every command gets an event callback that keeps the first command that failed, so getError() also reports those without having to wait after every enqueue.
+    Every context has its own errors, see @ref ThreadFuncs.
+    @{
+*/
+
+/*!
+    @brief Gives the first error of the current device since the last call and clears it
+
+    @details
+    Errors from deferred error checking come after the errors found while enqueueing and only show up once the failed command has finished, so call this after waiting on an event or on clFinish() to see every error of the operations before it.
+
+    @returns CL_SUCCESS if there was no error, otherwise an OpenCL error code, see errorName()
+*/
+cl_int getError();
+/*!
+    @brief Gives the name of an OpenCL error code
+
+    @param err The error code
+
+    @returns The name, such as "CL_INVALID_VALUE", or "unknown error"
+*/
+const char *errorName(const cl_int err);
+/*!
+    @brief Gives the compiler output of the last program that failed to build on the current device
+
+    @details
+    This includes the double and half kernels that gpuInit() builds on GPUs that turn out not to support them and the kernels of fused expressions.
+
+    @returns The build log, which is valid until the next program fails to build or gpuClean(), or NULL if no program has failed
+*/
+const char *getBuildLog();
+/*!
+    @brief Turns deferred error checking on or off for the current device, it is off by default
+
+    @details
+    While it is on every command costs an event and a callback but nothing waits for the GPU.
+
+    @param enabled 1 to check commands as they finish and 0 to only check them while they are enqueued
+*/
+void setDeferredErrorChecking(const int enabled);
+
+/*!
+    @}
+*/
+
+/*!
+    @brief Checks if gpuInit() found a GPU
+
+    @details
+    Without a GPU the float functions on host shapes, including the streaming ones, run on the CPU backend, which uses every processor, AVX2 and FMA when the processor has them and NEON on 64 bit ARM.
+    The asynchronous versions finish before they return and set their event to NULL.
+    Device shapes, evalDeviceExprF() and the double and half functions need a GPU.
+
+    @returns 1 if there is a GPU, otherwise 0
+*/
+int gpuFound();
+
+/*!
+    @brief Initializes the GPU struct. Must be called before any of the other functions
+
+    @details
+    When there is no GPU only the CPU backend is started, see gpuFound().
+    Float operations on host shapes that are too small to be worth copying to the GPU run on the CPU backend even when there is a GPU, see @ref DispatchFuncs.
+    The kernels are built for floats, and also for doubles and halfs if the GPU supports the cl_khr_fp64 and cl_khr_fp16 extensions.
+    The kernels are compiled the first time this is called on a device and the compiled binary is saved so later calls can skip compiling.
+    Binaries are saved in the directory in the LINEARALGEBRA_CACHE_DIR environment variable, or in the temporary directory of the system if it is not set.
+    A binary is only used if it was built for the same device, driver version and kernel source, otherwise the kernels are compiled again.
 */
 void gpuInit();
 
@@ -2,718 +2,5443 @@
     @file main.c
 */
 
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
 #include <CL/cl.h>
 #include <linearalgebra.h>
+#include <CL/cl_ext.h>
+#include <cpu.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*!
+    @brief Default tile sizes of the dot product kernel, these must match the defaults of TSM, TSN, TSK, WPTM and WPTN in kernel_code, see tuneKernels()
+*/
+#define DOT_TILE_M 64
+#define DOT_TILE_N 64
+#define DOT_TILE_K 16
+#define DOT_WORK_M 4
+#define DOT_WORK_N 4
+/*!
+    @brief Number of tile sizes of the dot product kernel in dotTiles
+*/
+#define DOT_TILE_CONFIGS 7
+
+/*!
+    @brief Elements where the second and third size classes of the tuned work group sizes start, see TuneConfig
+*/
+#define TUNE_MEDIUM_ELEMENTS (1 << 16)
+#define TUNE_LARGE_ELEMENTS (1 << 20)
+
+/*!
+    @brief Number of chunks the streaming functions keep in flight, one uploading, one computing and one downloading
+*/
+#define STREAM_SLOTS 3
+
+/*!
+    @brief Alignment and size multiple that host memory needs for the GPU to use it without a copy
+*/
+#define ZERO_COPY_ALIGNMENT 4096
+#define ZERO_COPY_SIZE_MULTIPLE 64
+
+/*!
+    @brief Magic, version and byte order marker at the start of every matrix file, and the alignment of its elements which is also the zero copy alignment
+*/
+#define MATRIX_FILE_MAGIC "LAMATRIX"
+#define MATRIX_FILE_VERSION 1
+#define MATRIX_FILE_BYTE_ORDER 0x01020304u
+#define MATRIX_FILE_ALIGNMENT ZERO_COPY_ALIGNMENT
+
+/*!
+    @brief Most events the profiler holds, past this it reads the times of the oldest commands as it records new ones and waits for them if they have not finished
+*/
+#define PROFILE_HELD_EVENTS 4096
+
+/*!
+    @brief Most GPUs gpuInit() will use
+*/
+#define MAX_DEVICES 16
+
+/*!
+    @brief Marks a variable as having its own copy in every thread
+*/
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+/*!
+    @brief Atomic operations on a volatile cl_int, used by event callbacks which OpenCL may run on any thread
+*/
+#ifdef _MSC_VER
+#define ATOMIC_SET_IF_ZERO(p, value) InterlockedCompareExchange((volatile LONG *)(p), (value), 0)
+#define ATOMIC_EXCHANGE(p, value) InterlockedExchange((volatile LONG *)(p), (value))
+#define ATOMIC_ADD(p, value) InterlockedExchangeAdd((volatile LONG *)(p), (value))
+#else
+#define ATOMIC_SET_IF_ZERO(p, value) __sync_val_compare_and_swap((p), 0, (value))
+#define ATOMIC_EXCHANGE(p, value) __sync_lock_test_and_set((p), (value))
+#define ATOMIC_ADD(p, value) __sync_fetch_and_add((p), (value))
+#endif
+
+/*!
+    @brief Sleeps the calling thread for a number of milliseconds
+*/
+#ifdef _WIN32
+#define sleepMilliseconds(ms) Sleep(ms)
+#else
+#define sleepMilliseconds(ms) nanosleep(&(struct timespec){0, (ms) * 1000000L}, NULL)
+#endif
+
+/*!
+    @brief Most milliseconds cleaning a device waits for the callbacks of deferred error checking after its queues have finished
+*/
+#define DEFERRED_CHECK_TIMEOUT 1000
+
+/*!
+    @brief Entry of the error name table errorName() uses, OpenCL error codes are negative so the table is indexed by minus the code
+*/
+#define ERROR_NAME(code) [-(code)] = #code
+
+/*!
+    @brief Fewest rows of a dot product or elements of an elementwise operation that multi device mode gives each GPU, smaller operations stay on the current GPU
+*/
+#define SHARD_MIN_ROWS 256
+#define SHARD_MIN_ELEMENTS (1 << 20)
+
+/*!
+    @brief Sizes of the operations the cost model is calibrated with and the number of times each one is timed
+*/
+#define CALIBRATION_ELEMENTS (1 << 21)
+#define CALIBRATION_DOT_SIZE 512
+#define CALIBRATION_MATVEC_COLUMNS 2048
+#define CALIBRATION_RUNS 5
+
+/*!
+    @brief Number of fields in a CostModel which are saved between runs
+*/
+#define COST_MODEL_FIELDS 11
+
+/*!
+    @brief Number of fields in a TuneConfig which are saved between runs
+*/
+#define TUNE_CONFIG_FIELDS 10
+
+/*!
+    @brief Work group sizes the elementwise and matrix vector kernels use until the device is tuned
+*/
+#define DEFAULT_ELEMENTWISE_GROUP 64
+#define DEFAULT_MATVEC_GROUP 256
+
+/*!
+    @brief Most work items one row of a sparse matrix vector product is split over
+*/
+#define CSR_MAX_LANES 32
+
+/*!
+    @brief Most bytes of a kernel argument a command graph keeps, every argument of the kernels is a buffer or a scalar
+*/
+#define GRAPH_ARG_BYTES 16
+
+/*!
+    @brief Most work groups for every compute unit the elementwise kernels are started with, the grid stride loop covers the rest of the elements
+*/
+#define ELEMENTWISE_GROUPS_PER_UNIT 8
 
+/*!
+    @brief Work groups for every compute unit a reduction of rows or of every element aims for, and work items for every compute unit a reduction of columns aims for
+*/
+#define REDUCE_GROUPS_PER_UNIT 4
+#define REDUCE_COLUMN_ITEMS_PER_UNIT 256
+/*!
+    @brief Fewest rows one work item of a reduction of columns goes over
+*/
+#define REDUCE_COLUMN_MIN_ROWS 16
+
+/*!
+    @brief Source of every kernel, written once in terms of REAL for the element type and ACC for the type sums are kept in
+
+    @details
+    gpuInit() builds it once for floats, once with PRECISION_DOUBLE for doubles and once with PRECISION_HALF for halfs, which are stored as 16 bits but added up as floats.
+*/
 const char *kernel_code =
-    "__kernel void addShapesF(__global const float *s1, __global const float *s2,\n"
-    "                         __global float *s3, const unsigned int n)\n"
+    "#ifndef VECTOR_WIDTH\n"
+    "#define VECTOR_WIDTH 4\n"
+    "#endif\n"
+    "#define CONCAT_(a, b) a##b\n"
+    "#define CONCAT(a, b) CONCAT_(a, b)\n"
+    "\n"
+    "#if defined(PRECISION_DOUBLE)\n"
+    "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
+    "#define REAL double\n"
+    "#define ACC double\n"
+    "#define ACC4 double4\n"
+    "#define LOAD(i, p) ((p)[i])\n"
+    "#define STORE(x, i, p) ((p)[i] = (x))\n"
+    "#define LOAD4(i, p) vload4(i, p)\n"
+    "#define STORE4(x, i, p) vstore4(x, i, p)\n"
+    "#define LOADV(i, p) CONCAT(vload, VECTOR_WIDTH)(i, p)\n"
+    "#define STOREV(x, i, p) CONCAT(vstore, VECTOR_WIDTH)(x, i, p)\n"
+    "#elif defined(PRECISION_HALF)\n"
+    "#pragma OPENCL EXTENSION cl_khr_fp16 : enable\n"
+    "#define REAL half\n"
+    "#define ACC float\n"
+    "#define ACC4 float4\n"
+    "#define LOAD(i, p) vload_half(i, p)\n"
+    "#define STORE(x, i, p) vstore_half(x, i, p)\n"
+    "#define LOAD4(i, p) vload_half4(i, p)\n"
+    "#define STORE4(x, i, p) vstore_half4(x, i, p)\n"
+    "#define LOADV(i, p) CONCAT(vload_half, VECTOR_WIDTH)(i, p)\n"
+    "#define STOREV(x, i, p) CONCAT(vstore_half, VECTOR_WIDTH)(x, i, p)\n"
+    "#else\n"
+    "#define REAL float\n"
+    "#define ACC float\n"
+    "#define ACC4 float4\n"
+    "#define LOAD(i, p) ((p)[i])\n"
+    "#define STORE(x, i, p) ((p)[i] = (x))\n"
+    "#define LOAD4(i, p) vload4(i, p)\n"
+    "#define STORE4(x, i, p) vstore4(x, i, p)\n"
+    "#define LOADV(i, p) CONCAT(vload, VECTOR_WIDTH)(i, p)\n"
+    "#define STOREV(x, i, p) CONCAT(vstore, VECTOR_WIDTH)(x, i, p)\n"
+    "#endif\n"
+    "\n"
+    "__kernel void addShapesF(__global const REAL *s1, __global const REAL *s2,\n"
+    "                         __global REAL *s3, const unsigned int n)\n"
+    "{\n"
+    "    __private const unsigned int vectors = n / VECTOR_WIDTH;\n"
+    "    for (unsigned int i = get_global_id(0); i < vectors; i += get_global_size(0))\n"
+    "    {\n"
+    "        STOREV(LOADV(i, s1) + LOADV(i, s2), i, s3);\n"
+    "    }\n"
+    "    for (unsigned int i = vectors * VECTOR_WIDTH + get_global_id(0); i < n; i += get_global_size(0))\n"
+    "    {\n"
+    "        STORE(LOAD(i, s1) + LOAD(i, s2), i, s3);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "__kernel void subtractShapesF(__global const REAL *s1, __global const REAL *s2,\n"
+    "                              __global REAL *s3, const unsigned int n)\n"
+    "{\n"
+    "    __private const unsigned int vectors = n / VECTOR_WIDTH;\n"
+    "    for (unsigned int i = get_global_id(0); i < vectors; i += get_global_size(0))\n"
+    "    {\n"
+    "        STOREV(LOADV(i, s1) - LOADV(i, s2), i, s3);\n"
+    "    }\n"
+    "    for (unsigned int i = vectors * VECTOR_WIDTH + get_global_id(0); i < n; i += get_global_size(0))\n"
+    "    {\n"
+    "        STORE(LOAD(i, s1) - LOAD(i, s2), i, s3);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "__kernel void crossShapesF(__global const REAL *s1, __global const REAL *s2,\n"
+    "                           __global REAL *s3, const unsigned int n)\n"
+    "{\n"
+    "    __private const unsigned int vectors = n / VECTOR_WIDTH;\n"
+    "    for (unsigned int i = get_global_id(0); i < vectors; i += get_global_size(0))\n"
+    "    {\n"
+    "        STOREV(LOADV(i, s1) * LOADV(i, s2), i, s3);\n"
+    "    }\n"
+    "    for (unsigned int i = vectors * VECTOR_WIDTH + get_global_id(0); i < n; i += get_global_size(0))\n"
+    "    {\n"
+    "        STORE(LOAD(i, s1) * LOAD(i, s2), i, s3);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "__kernel void divideShapesF(__global const REAL *s1, __global const REAL *s2,\n"
+    "                            __global REAL *s3, const unsigned int n)\n"
+    "{\n"
+    "    __private const unsigned int vectors = n / VECTOR_WIDTH;\n"
+    "    for (unsigned int i = get_global_id(0); i < vectors; i += get_global_size(0))\n"
+    "    {\n"
+    "        STOREV(LOADV(i, s1) / LOADV(i, s2), i, s3);\n"
+    "    }\n"
+    "    for (unsigned int i = vectors * VECTOR_WIDTH + get_global_id(0); i < n; i += get_global_size(0))\n"
+    "    {\n"
+    "        STORE(LOAD(i, s1) / LOAD(i, s2), i, s3);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "#define SHAPE_ADD 0\n"
+    "#define SHAPE_SUBTRACT 1\n"
+    "#define SHAPE_CROSS 2\n"
+    "#define SHAPE_DIVIDE 3\n"
+    "#define APPLY_SHAPE_OP(a, b, op) ((op) == SHAPE_SUBTRACT ? (a) - (b) : (op) == SHAPE_CROSS ? (a) * (b) : (op) == SHAPE_DIVIDE ? (a) / (b) : (a) + (b))\n"
+    "#define BROADCAST_ROWS 0\n"
+    "\n"
+    "__kernel void scalarShapesF(__global const REAL *s, const ACC k,\n"
+    "                            __global REAL *out, const unsigned int n,\n"
+    "                            const unsigned int op)\n"
+    "{\n"
+    "    __private const unsigned int vectors = n / VECTOR_WIDTH;\n"
+    "    for (unsigned int i = get_global_id(0); i < vectors; i += get_global_size(0))\n"
+    "    {\n"
+    "        STOREV(APPLY_SHAPE_OP(LOADV(i, s), k, op), i, out);\n"
+    "    }\n"
+    "    for (unsigned int i = vectors * VECTOR_WIDTH + get_global_id(0); i < n; i += get_global_size(0))\n"
+    "    {\n"
+    "        STORE(APPLY_SHAPE_OP(LOAD(i, s), k, op), i, out);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "__kernel void broadcastShapesF(__global const REAL *s, __global const REAL *v,\n"
+    "                               __global REAL *out, const unsigned int c,\n"
+    "                               const unsigned int axis, const unsigned int op)\n"
+    "{\n"
+    "    __private const unsigned int col = get_global_id(0);\n"
+    "    __private const unsigned int row = get_global_id(1);\n"
+    "    if (col < c)\n"
+    "    {\n"
+    "        __private const size_t i = (size_t)row * c + col;\n"
+    "        __private const ACC x = LOAD(i, s);\n"
+    "        __private const ACC y = LOAD(axis == BROADCAST_ROWS ? col : row, v);\n"
+    "        STORE(APPLY_SHAPE_OP(x, y, op), i, out);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "#define ACTIVATION_NONE 0\n"
+    "#define ACTIVATION_RELU 1\n"
+    "#define ACTIVATION_GELU 2\n"
+    "#define ACTIVATION_SIGMOID 3\n"
+    "\n"
+    "ACC activate(const ACC x, const unsigned int activation)\n"
+    "{\n"
+    "    switch (activation)\n"
+    "    {\n"
+    "    case ACTIVATION_RELU:\n"
+    "        return fmax(x, (ACC)0);\n"
+    "    case ACTIVATION_GELU:\n"
+    "        return (ACC)0.5 * x * ((ACC)1 + tanh((ACC)0.7978845608028654 * (x + (ACC)0.044715 * x * x * x)));\n"
+    "    case ACTIVATION_SIGMOID:\n"
+    "        return (ACC)1 / ((ACC)1 + exp(-x));\n"
+    "    default:\n"
+    "        return x;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "#ifndef TSM\n"
+    "#define TSM 64\n"
+    "#endif\n"
+    "#ifndef TSN\n"
+    "#define TSN 64\n"
+    "#endif\n"
+    "#ifndef TSK\n"
+    "#define TSK 16\n"
+    "#endif\n"
+    "#ifndef WPTM\n"
+    "#define WPTM 4\n"
+    "#endif\n"
+    "#ifndef WPTN\n"
+    "#define WPTN 4\n"
+    "#endif\n"
+    "#define RTSM (TSM / WPTM)\n"
+    "#define RTSN (TSN / WPTN)\n"
+    "#define LPTA ((TSK * TSM) / (RTSM * RTSN))\n"
+    "#define LPTB ((TSK * TSN) / (RTSM * RTSN))\n"
+    "\n"
+    "__kernel __attribute__((reqd_work_group_size(RTSN, RTSM, 1)))\n"
+    "void dotMatricesF(__global const REAL *s1, __global const REAL *s2,\n"
+    "                  __global REAL *s3, const unsigned int r,\n"
+    "                  const unsigned int c, const unsigned int c2,\n"
+    "                  const unsigned int stride1, const unsigned int stride2,\n"
+    "                  const unsigned int stride3, __global const REAL *s3in,\n"
+    "                  const float alpha, const float beta,\n"
+    "                  __global const REAL *bias, const unsigned int activation,\n"
+    "                  const unsigned int ld1, const unsigned int ld2,\n"
+    "                  const unsigned int ld3, const unsigned int trans1,\n"
+    "                  const unsigned int trans2)\n"
+    "{\n"
+    "    __private const size_t offset3 = (size_t)get_global_id(2) * stride3;\n"
+    "    s1 += get_global_id(2) * stride1;\n"
+    "    s2 += get_global_id(2) * stride2;\n"
+    "    s3 += get_global_id(2) * stride3;\n"
+    "    __private const int tidn = get_local_id(0);\n"
+    "    __private const int tidm = get_local_id(1);\n"
+    "    __private const int tid = tidm * RTSN + tidn;\n"
+    "    __private const int offsetN = get_group_id(0) * TSN;\n"
+    "    __private const int offsetM = get_group_id(1) * TSM;\n"
+    "    __local ACC s1Tile[TSK][TSM + 2];\n"
+    "    __local ACC s2Tile[TSK][TSN];\n"
+    "    __private ACC acc[WPTM][WPTN];\n"
+    "    for (int wm = 0; wm < WPTM; wm++)\n"
+    "    {\n"
+    "        for (int wn = 0; wn < WPTN; wn++)\n"
+    "        {\n"
+    "            acc[wm][wn] = 0.0f;\n"
+    "        }\n"
+    "    }\n"
+    "    __private const int tiles = (c + TSK - 1) / TSK;\n"
+    "    for (int t = 0; t < tiles; t++)\n"
+    "    {\n"
+    "        /* Neighbouring work items load neighbouring elements of the way s1 and s2 are stored, so transposed tiles are read coalesced too */\n"
+    "        for (int l = 0; l < LPTA; l++)\n"
+    "        {\n"
+    "            __private const int id = l * RTSM * RTSN + tid;\n"
+    "            __private const int tm = trans1 ? id % TSM : id / TSK;\n"
+    "            __private const int tk = trans1 ? id / TSM : id % TSK;\n"
+    "            __private const int row = offsetM + tm;\n"
+    "            __private const int k = t * TSK + tk;\n"
+    "            s1Tile[tk][tm] = (row < r && k < c) ? LOAD(trans1 ? (size_t)k * ld1 + row : (size_t)row * ld1 + k, s1) : 0.0f;\n"
+    "        }\n"
+    "        for (int l = 0; l < LPTB; l++)\n"
+    "        {\n"
+    "            __private const int id = l * RTSM * RTSN + tid;\n"
+    "            __private const int tn = trans2 ? id / TSK : id % TSN;\n"
+    "            __private const int tk = trans2 ? id % TSK : id / TSN;\n"
+    "            __private const int k = t * TSK + tk;\n"
+    "            __private const int col = offsetN + tn;\n"
+    "            s2Tile[tk][tn] = (k < c && col < c2) ? LOAD(trans2 ? (size_t)col * ld2 + k : (size_t)k * ld2 + col, s2) : 0.0f;\n"
+    "        }\n"
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "        #pragma unroll\n"
+    "        for (int k = 0; k < TSK; k++)\n"
+    "        {\n"
+    "            __private ACC s2Reg[WPTN];\n"
+    "            for (int wn = 0; wn < WPTN; wn++)\n"
+    "            {\n"
+    "                s2Reg[wn] = s2Tile[k][tidn + wn * RTSN];\n"
+    "            }\n"
+    "            for (int wm = 0; wm < WPTM; wm++)\n"
+    "            {\n"
+    "                __private const ACC s1Reg = s1Tile[k][tidm + wm * RTSM];\n"
+    "                for (int wn = 0; wn < WPTN; wn++)\n"
+    "                {\n"
+    "                    acc[wm][wn] += s1Reg * s2Reg[wn];\n"
+    "                }\n"
+    "            }\n"
+    "        }\n"
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "    }\n"
+    "    for (int wm = 0; wm < WPTM; wm++)\n"
+    "    {\n"
+    "        __private const int row = offsetM + tidm + wm * RTSM;\n"
+    "        for (int wn = 0; wn < WPTN; wn++)\n"
+    "        {\n"
+    "            __private const int col = offsetN + tidn + wn * RTSN;\n"
+    "            if (row < r && col < c2)\n"
+    "            {\n"
+    "                __private ACC x = alpha * acc[wm][wn];\n"
+    "                if (beta != 0.0f)\n"
+    "                {\n"
+    "                    x += beta * LOAD(offset3 + (size_t)row * ld3 + col, s3in);\n"
+    "                }\n"
+    "                if (bias != 0)\n"
+    "                {\n"
+    "                    x += LOAD(col, bias);\n"
+    "                }\n"
+    "                STORE(activate(x, activation), (size_t)row * ld3 + col, s3);\n"
+    "            }\n"
+    "        }\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "__kernel void dotMatrices4x4F(__global const REAL *s1, __global const REAL *s2,\n"
+    "                              __global REAL *s3, const unsigned int batch,\n"
+    "                              const unsigned int stride1, const unsigned int stride2,\n"
+    "                              const unsigned int stride3)\n"
+    "{\n"
+    "    __private const unsigned int i = get_global_id(0);\n"
+    "    if (i < batch)\n"
+    "    {\n"
+    "        s1 += i * stride1;\n"
+    "        s2 += i * stride2;\n"
+    "        s3 += i * stride3;\n"
+    "        __private const ACC4 b0 = LOAD4(0, s2);\n"
+    "        __private const ACC4 b1 = LOAD4(1, s2);\n"
+    "        __private const ACC4 b2 = LOAD4(2, s2);\n"
+    "        __private const ACC4 b3 = LOAD4(3, s2);\n"
+    "        for (int row = 0; row < 4; row++)\n"
+    "        {\n"
+    "            __private const ACC4 a = LOAD4(row, s1);\n"
+    "            STORE4(a.x * b0 + a.y * b1 + a.z * b2 + a.w * b3, row, s3);\n"
+    "        }\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "__kernel __attribute__((reqd_work_group_size(16, 16, 1)))\n"
+    "void dotMatrices16x16F(__global const REAL *s1, __global const REAL *s2,\n"
+    "                       __global REAL *s3, const unsigned int stride1,\n"
+    "                       const unsigned int stride2, const unsigned int stride3)\n"
+    "{\n"
+    "    __private const int col = get_local_id(0);\n"
+    "    __private const int row = get_local_id(1);\n"
+    "    __private const unsigned int i = get_global_id(2);\n"
+    "    __local ACC s1Tile[16][16];\n"
+    "    __local ACC s2Tile[16][16];\n"
+    "    s1Tile[row][col] = LOAD(i * stride1 + row * 16 + col, s1);\n"
+    "    s2Tile[row][col] = LOAD(i * stride2 + row * 16 + col, s2);\n"
+    "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "    __private ACC sum = 0.0f;\n"
+    "    #pragma unroll\n"
+    "    for (int k = 0; k < 16; k++)\n"
+    "    {\n"
+    "        sum += s1Tile[row][k] * s2Tile[k][col];\n"
+    "    }\n"
+    "    STORE(sum, i * stride3 + row * 16 + col, s3);\n"
+    "}\n"
+    "\n"
+    "__kernel void MatrixFMulVecF(__global const REAL *m, __global const REAL *v,\n"
+    "                             __global REAL *out, __local ACC *partial_sums,\n"
+    "                             const unsigned int r, const unsigned int c,\n"
+    "                             const unsigned int chunk, const unsigned int stride_m,\n"
+    "                             const unsigned int stride_v, const unsigned int stride_out,\n"
+    "                             const unsigned int ld)\n"
+    "{\n"
+    "    m += get_global_id(2) * stride_m;\n"
+    "    v += get_global_id(2) * stride_v;\n"
+    "    out += get_global_id(2) * stride_out;\n"
+    "    __private const unsigned int lid = get_local_id(0);\n"
+    "    __private const unsigned int size = get_local_size(0);\n"
+    "    __private const unsigned int split = get_group_id(0);\n"
+    "    __private const unsigned int row = get_global_id(1);\n"
+    "    __private const unsigned int end = min((split + 1) * chunk, c);\n"
+    "    __global const REAL *m_row = m + (size_t)row * ld;\n"
+    "    __private ACC sum = 0.0f;\n"
+    "    for (unsigned int col = split * chunk + lid; col < end; col += size)\n"
+    "    {\n"
+    "        sum += LOAD(col, m_row) * LOAD(col, v);\n"
+    "    }\n"
+    "    partial_sums[lid] = sum;\n"
+    "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "    for (unsigned int stride = size / 2; stride > 0; stride /= 2)\n"
+    "    {\n"
+    "        if (lid < stride)\n"
+    "        {\n"
+    "            partial_sums[lid] += partial_sums[lid + stride];\n"
+    "        }\n"
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "    }\n"
+    "    if (lid == 0)\n"
+    "    {\n"
+    "        STORE(partial_sums[0], row * get_num_groups(0) + split, out);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "__kernel void MatrixFMulVecTransposedF(__global const REAL *m, __global const REAL *v,\n"
+    "                                      __global REAL *out, const unsigned int r,\n"
+    "                                      const unsigned int c, const unsigned int chunk,\n"
+    "                                      const unsigned int stride_m, const unsigned int stride_v,\n"
+    "                                      const unsigned int stride_out, const unsigned int ld)\n"
+    "{\n"
+    "    m += get_global_id(2) * stride_m;\n"
+    "    v += get_global_id(2) * stride_v;\n"
+    "    out += get_global_id(2) * stride_out;\n"
+    "    __private const unsigned int row = get_global_id(0);\n"
+    "    __private const unsigned int split = get_global_id(1);\n"
+    "    if (row < r)\n"
+    "    {\n"
+    "        __private const unsigned int end = min((split + 1) * chunk, c);\n"
+    "        __private ACC sum = 0.0f;\n"
+    "        for (unsigned int k = split * chunk; k < end; k++)\n"
+    "        {\n"
+    "            sum += LOAD((size_t)k * ld + row, m) * LOAD(k, v);\n"
+    "        }\n"
+    "        STORE(sum, row * get_global_size(1) + split, out);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "__kernel void MatrixFMulVecSumF(__global const REAL *partials,\n"
+    "                                __global REAL *out, const unsigned int r,\n"
+    "                                const unsigned int splits,\n"
+    "                                const unsigned int stride_partials,\n"
+    "                                const unsigned int stride_out)\n"
+    "{\n"
+    "    __private const unsigned int row = get_global_id(0);\n"
+    "    partials += get_global_id(1) * stride_partials;\n"
+    "    out += get_global_id(1) * stride_out;\n"
+    "    if (row < r)\n"
+    "    {\n"
+    "        __private ACC sum = 0.0f;\n"
+    "        for (unsigned int i = 0; i < splits; i++)\n"
+    "        {\n"
+    "            sum += LOAD(row * splits + i, partials);\n"
+    "        }\n"
+    "        STORE(sum, row, out);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "__kernel void MatrixFMulVec4x4F(__global const REAL *m, __global const REAL *v,\n"
+    "                                __global REAL *out, const unsigned int batch,\n"
+    "                                const unsigned int stride_m, const unsigned int stride_v,\n"
+    "                                const unsigned int stride_out)\n"
     "{\n"
-    "    __private int index = get_global_id(0);\n"
-    "    if (index < n)\n"
+    "    __private const unsigned int i = get_global_id(0);\n"
+    "    if (i < batch)\n"
     "    {\n"
-    "        s3[index] = s1[index] + s2[index];\n"
+    "        m += i * stride_m;\n"
+    "        out += i * stride_out;\n"
+    "        __private const ACC4 x = LOAD4(0, v + i * stride_v);\n"
+    "        STORE4((ACC4)(dot(LOAD4(0, m), x), dot(LOAD4(1, m), x),\n"
+    "                         dot(LOAD4(2, m), x), dot(LOAD4(3, m), x)),\n"
+    "                0, out);\n"
     "    }\n"
     "}\n"
     "\n"
-    "__kernel void subtractShapesF(__global const float *s1,\n"
-    "                              __global const float *s2, __global float *s3,\n"
-    "                              const unsigned int n)\n"
+    "#define REDUCE_SUM 0\n"
+    "#define REDUCE_MAX 1\n"
+    "#define REDUCE_MIN 2\n"
+    "#define REDUCE_ARGMAX 3\n"
+    "#define REDUCE_NORM 4\n"
+    "#define REDUCE_LOG_SUM_EXP 5\n"
+    "#define REDUCE_DOT 6\n"
+    "\n"
+    "ACC reduceIdentity(const unsigned int op)\n"
+    "{\n"
+    "    if (op == REDUCE_MAX || op == REDUCE_ARGMAX)\n"
+    "    {\n"
+    "        return -INFINITY;\n"
+    "    }\n"
+    "    return op == REDUCE_MIN ? INFINITY : 0.0f;\n"
+    "}\n"
+    "\n"
+    "ACC reduceMap(const ACC x, const ACC y, const ACC shift, const unsigned int op)\n"
     "{\n"
-    "    __private int index = get_global_id(0);\n"
-    "    if (index < n)\n"
+    "    switch (op)\n"
     "    {\n"
-    "        s3[index] = s1[index] - s2[index];\n"
+    "    case REDUCE_NORM:\n"
+    "        return x * x;\n"
+    "    case REDUCE_LOG_SUM_EXP:\n"
+    "        return exp(x - shift);\n"
+    "    case REDUCE_DOT:\n"
+    "        return x * y;\n"
+    "    default:\n"
+    "        return x;\n"
     "    }\n"
     "}\n"
     "\n"
-    "__kernel void crossShapesF(__global const float *s1, __global const float *s2,\n"
-    "                           __global float *s3, const unsigned int n)\n"
+    "void reduceCombine(ACC *value, unsigned int *index, const ACC x,\n"
+    "                   const unsigned int i, const unsigned int op)\n"
     "{\n"
-    "    __private int index = get_global_id(0);\n"
-    "    if (index < n)\n"
+    "    if (op == REDUCE_MAX)\n"
+    "    {\n"
+    "        *value = fmax(*value, x);\n"
+    "    }\n"
+    "    else if (op == REDUCE_MIN)\n"
     "    {\n"
-    "        s3[index] = s1[index] * s2[index];\n"
+    "        *value = fmin(*value, x);\n"
+    "    }\n"
+    "    else if (op == REDUCE_ARGMAX)\n"
+    "    {\n"
+    "        if (x > *value || (x == *value && i < *index))\n"
+    "        {\n"
+    "            *value = x;\n"
+    "            *index = i;\n"
+    "        }\n"
+    "    }\n"
+    "    else\n"
+    "    {\n"
+    "        *value += x;\n"
     "    }\n"
     "}\n"
     "\n"
-    "__kernel void divideShapesF(__global const float *s1, __global const float *s2,\n"
-    "                            __global float *s3, const unsigned int n)\n"
+    "__kernel void reduceF(__global const REAL *s, __global const REAL *s2,\n"
+    "                      __global const REAL *shift, __global ACC *partials,\n"
+    "                      __global unsigned int *indices, __local ACC *values,\n"
+    "                      __local unsigned int *positions, const unsigned int length,\n"
+    "                      const unsigned int chunk, const unsigned int op)\n"
     "{\n"
-    "    __private int index = get_global_id(0);\n"
-    "    if (index < n)\n"
+    "    __private const unsigned int lid = get_local_id(0);\n"
+    "    __private const unsigned int size = get_local_size(0);\n"
+    "    __private const unsigned int split = get_group_id(0);\n"
+    "    __private const unsigned int line = get_global_id(1);\n"
+    "    __private const unsigned int end = min((split + 1) * chunk, length);\n"
+    "    __private const size_t offset = (size_t)line * length;\n"
+    "    __private const ACC line_shift = op == REDUCE_LOG_SUM_EXP ? LOAD(line, shift) : 0.0f;\n"
+    "    __private ACC value = reduceIdentity(op);\n"
+    "    __private unsigned int index = UINT_MAX;\n"
+    "    for (unsigned int i = split * chunk + lid; i < end; i += size)\n"
+    "    {\n"
+    "        __private const ACC y = op == REDUCE_DOT ? LOAD(offset + i, s2) : 0.0f;\n"
+    "        reduceCombine(&value, &index, reduceMap(LOAD(offset + i, s), y, line_shift, op), i, op);\n"
+    "    }\n"
+    "    values[lid] = value;\n"
+    "    positions[lid] = index;\n"
+    "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "    for (unsigned int stride = size / 2; stride > 0; stride /= 2)\n"
+    "    {\n"
+    "        if (lid < stride)\n"
+    "        {\n"
+    "            reduceCombine(&value, &index, values[lid + stride], positions[lid + stride], op);\n"
+    "            values[lid] = value;\n"
+    "            positions[lid] = index;\n"
+    "        }\n"
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "    }\n"
+    "    if (lid == 0)\n"
     "    {\n"
-    "        s3[index] = s1[index] / s2[index];\n"
+    "        partials[line * get_num_groups(0) + split] = value;\n"
+    "        indices[line * get_num_groups(0) + split] = index;\n"
     "    }\n"
     "}\n"
     "\n"
-    "__kernel void dotMatricesF(__global const float *s1, __global const float *s2,\n\
-                          __global float *s3, __local float *partial_sums,\n\
-                          const unsigned int r, const unsigned int c, unsigned const int c2) {\n\
-        __private const int row = get_global_id(0);\n\
-        __private const int col2 = get_global_id(1);\n\
-        __private const int col = get_local_id(0);\n\
-        if (row < r && col < c && col2 < c2) {\n\
-            partial_sums[col] = s1[row * c + col] * s2[col * c2 + col2];\n\
-            barrier(CLK_LOCAL_MEM_FENCE);\n\
-            if (col == 0) {\n\
-                s3[row * c2 + col2] = 0;\n\
-                for (int i = 0; i < c; i++) {\n\
-                    s3[row * c2 + col2] += partial_sums[i];\n\
-                }\n\
-            }\n\
-        }\n\
-    }\n"
+    "__kernel void reduceColumnsF(__global const REAL *s, __global const REAL *s2,\n"
+    "                             __global const REAL *shift, __global ACC *partials,\n"
+    "                             __global unsigned int *indices, const unsigned int r,\n"
+    "                             const unsigned int c, const unsigned int chunk,\n"
+    "                             const unsigned int op)\n"
+    "{\n"
+    "    __private const unsigned int col = get_global_id(0);\n"
+    "    __private const unsigned int split = get_global_id(1);\n"
+    "    if (col < c)\n"
+    "    {\n"
+    "        __private const unsigned int end = min((split + 1) * chunk, r);\n"
+    "        __private const ACC line_shift = op == REDUCE_LOG_SUM_EXP ? LOAD(col, shift) : 0.0f;\n"
+    "        __private ACC value = reduceIdentity(op);\n"
+    "        __private unsigned int index = UINT_MAX;\n"
+    "        for (unsigned int row = split * chunk; row < end; row++)\n"
+    "        {\n"
+    "            __private const size_t i = (size_t)row * c + col;\n"
+    "            __private const ACC y = op == REDUCE_DOT ? LOAD(i, s2) : 0.0f;\n"
+    "            reduceCombine(&value, &index, reduceMap(LOAD(i, s), y, line_shift, op), row, op);\n"
+    "        }\n"
+    "        partials[col * get_global_size(1) + split] = value;\n"
+    "        indices[col * get_global_size(1) + split] = index;\n"
+    "    }\n"
+    "}\n"
     "\n"
-    "__kernel void MatrixFMulVecF(__global const float *m, __global const float *v,\n\
-                           __global float *out, __local float *partial_sums,\n\
-                           const unsigned int r, const unsigned int c)\n\
-{\n\
-    __private const unsigned int row = get_global_id(0);\n\
-    __private const unsigned int col = get_global_id(1);\n\
-    if (row < r && col < c)\n\
-    {\n\
-        partial_sums[col] = m[row * c + col] * v[row];\n\
-        barrier(CLK_LOCAL_MEM_FENCE);\n\
-        if (col == 0)\n\
-        {\n\
-            out[row] = 0;\n\
-            for (int i = 0; i < c; i++)\n\
-            {\n\
-                out[row] += partial_sums[i];\n\
-            }\n\
-        }\n\
-    }\n\
-}\n\
-";
-
-GPU gpu;
-
-/*!
-    @brief Function to check for any OpenCL error and output the code
-*/
-void checkError()
+    "__kernel void reduceFinalF(__global const ACC *partials,\n"
+    "                           __global const unsigned int *indices,\n"
+    "                           __global const REAL *shift, __global REAL *out,\n"
+    "                           const unsigned int lines, const unsigned int splits,\n"
+    "                           const unsigned int op)\n"
+    "{\n"
+    "    __private const unsigned int line = get_global_id(0);\n"
+    "    if (line < lines)\n"
+    "    {\n"
+    "        __private ACC value = partials[line * splits];\n"
+    "        __private unsigned int index = indices[line * splits];\n"
+    "        for (unsigned int i = 1; i < splits; i++)\n"
+    "        {\n"
+    "            reduceCombine(&value, &index, partials[line * splits + i], indices[line * splits + i], op);\n"
+    "        }\n"
+    "        if (op == REDUCE_NORM)\n"
+    "        {\n"
+    "            value = sqrt(value);\n"
+    "        }\n"
+    "        else if (op == REDUCE_LOG_SUM_EXP)\n"
+    "        {\n"
+    "            value = log(value) + LOAD(line, shift);\n"
+    "        }\n"
+    "        else if (op == REDUCE_ARGMAX)\n"
+    "        {\n"
+    "            value = (ACC)index;\n"
+    "        }\n"
+    "        STORE(value, line, out);\n"
+    "    }\n"
+    "}\n"
+    "__kernel void csrMatVecF(__global const unsigned int *row_ptr, __global const unsigned int *cols,\n"
+    "                         __global const REAL *values, __global const REAL *v,\n"
+    "                         __global REAL *out, __local ACC *partial_sums,\n"
+    "                         const unsigned int r, const unsigned int lanes)\n"
+    "{\n"
+    "    __private const unsigned int lid = get_local_id(0);\n"
+    "    __private const unsigned int lane = lid % lanes;\n"
+    "    __private const unsigned int row = get_global_id(0) / lanes;\n"
+    "    __private ACC sum = 0.0f;\n"
+    "    if (row < r)\n"
+    "    {\n"
+    "        __private const unsigned int end = row_ptr[row + 1];\n"
+    "        for (unsigned int k = row_ptr[row] + lane; k < end; k += lanes)\n"
+    "        {\n"
+    "            sum += LOAD(k, values) * LOAD(cols[k], v);\n"
+    "        }\n"
+    "    }\n"
+    "    partial_sums[lid] = sum;\n"
+    "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "    for (unsigned int stride = lanes / 2; stride > 0; stride /= 2)\n"
+    "    {\n"
+    "        if (lane < stride)\n"
+    "        {\n"
+    "            partial_sums[lid] += partial_sums[lid + stride];\n"
+    "        }\n"
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "    }\n"
+    "    if (lane == 0 && row < r)\n"
+    "    {\n"
+    "        STORE(partial_sums[lid], row, out);\n"
+    "    }\n"
+    "}\n"
+    "__kernel void csrDotMatricesF(__global const unsigned int *row_ptr, __global const unsigned int *cols,\n"
+    "                              __global const REAL *values, __global const REAL *s2,\n"
+    "                              __global REAL *s3, const unsigned int c2)\n"
+    "{\n"
+    "    __private const unsigned int col = get_global_id(0);\n"
+    "    __private const unsigned int row = get_global_id(1);\n"
+    "    if (col < c2)\n"
+    "    {\n"
+    "        __private const unsigned int end = row_ptr[row + 1];\n"
+    "        __private ACC sum = 0.0f;\n"
+    "        for (unsigned int k = row_ptr[row]; k < end; k++)\n"
+    "        {\n"
+    "            sum += LOAD(k, values) * LOAD((size_t)cols[k] * c2 + col, s2);\n"
+    "        }\n"
+    "        STORE(sum, (size_t)row * c2 + col, s3);\n"
+    "    }\n"
+    "}\n";
+
+/*!
+    @brief Every GPU found by gpuInit(), the functions run on the device or context current points to and gpu is a shorthand for it
+
+    @details
+    Every thread has its own current so threads that each use their own context from gpuCreateContext() share nothing but the device.
+*/
+static GPU devices[MAX_DEVICES];
+static unsigned int deviceCount = 0;
+static THREAD_LOCAL GPU *current = &devices[0];
+#define gpu (*current)
+/*!
+    @brief Whether the synchronous float dot product and elementwise functions split their work across every GPU, see setMultiDevice()
+*/
+static int multiDevice = 0;
+
+struct DeviceShapeF
+{
+    cl_mem buffer;
+    unsigned int r;
+    unsigned int c;
+};
+
+/*!
+    @brief The 64 byte header at the start of a matrix file, see @ref FileFuncs
+*/
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t type;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t alignment;
+    uint64_t dataOffset;
+    uint64_t dataBytes;
+    uint8_t reserved[16];
+} MatrixFileHeader;
+
+struct MatrixFile
+{
+    void *mapping;
+    size_t size;
+    MatrixFileHeader header;
+};
+
+struct DeviceCsrF
+{
+    cl_mem rowPtr;
+    cl_mem cols;
+    cl_mem values;
+    unsigned int r;
+    unsigned int c;
+    unsigned int nnz;
+};
+
+/*!
+    @brief What the dot product kernel does to every sum before storing it, see gemmF()
+*/
+typedef struct
+{
+    float alpha;
+    float beta;
+    cl_mem c;     /* Only read when beta is not 0 */
+    cl_mem bias;  /* NULL when there is no bias */
+    Activation activation;
+} Epilogue;
+static const Epilogue noEpilogue = {1.0f, 0.0f, NULL, NULL, ACTIVATION_NONE};
+/*!
+    @brief One recorded command of a command graph, see @ref GraphFuncs
+*/
+typedef struct
+{
+    enum
+    {
+        GRAPH_KERNEL,
+        GRAPH_WRITE,
+        GRAPH_READ
+    } kind;
+    cl_kernel kernel; /* A copy of the kernel that was recorded with its own arguments */
+    cl_uint dims;
+    size_t global[3];
+    size_t local[3];  /* All 0 when the driver picks the work group size */
+    cl_mem buffer;
+    size_t size;
+    void *host;
+} GraphCommand;
+/*!
+    @brief The last value a kernel argument was set to while recording
+*/
+typedef struct
+{
+    cl_kernel kernel;
+    cl_uint index;
+    size_t size;
+    int local;
+    unsigned char value[GRAPH_ARG_BYTES];
+} GraphArg;
+
+struct CommandGraph
+{
+    GPU *device;
+    GraphCommand *commands;
+    unsigned int count;
+    unsigned int capacity;
+    GraphArg *args;
+    unsigned int argCount;
+    unsigned int argCapacity;
+    cl_mem *buffers; /* Buffers that were released while recording */
+    unsigned int bufferCount;
+    unsigned int bufferCapacity;
+    int failed;
+#ifdef cl_khr_command_buffer
+    cl_command_buffer_khr commandBuffer;
+    clEnqueueCommandBufferKHR_fn enqueueCommandBuffer;
+    clReleaseCommandBufferKHR_fn releaseCommandBuffer;
+#endif
+};
+
+/*!
+    @brief Keeps the first error since the last getError() so it is not lost when gpu.err is overwritten by the next call
+*/
+static void recordError(const cl_int err)
+{
+    if (err != CL_SUCCESS && gpu.status == CL_SUCCESS)
+    {
+        gpu.status = err;
+    }
+}
+/*!
+    @brief Records an error for an operation that could not be enqueued and gives the caller an event that has failed with it
+
+    @details
+    Commands that wait on the event fail instead of running with missing inputs, and waiting on it gives an error instead of hanging.
+*/
+static void failCommand(const cl_int err, cl_event *event)
+{
+    gpu.err = err;
+    recordError(err);
+    if (event == NULL)
+    {
+        return;
+    }
+    cl_int user_err;
+    *event = clCreateUserEvent(gpu.context, &user_err);
+    if (user_err == CL_SUCCESS)
+    {
+        clSetUserEventStatus(*event, err);
+    }
+}
+/*!
+    @brief Event callback of deferred error checking, keeps the first failed execution status of a command in the DeferredChecks of its device
+*/
+static void CL_CALLBACK checkCommand(cl_event event, cl_int status, void *data)
+{
+    DeferredChecks *checks = data;
+    (void)event;
+    if (status < 0)
+    {
+        ATOMIC_SET_IF_ZERO(&checks->status, status);
+    }
+    ATOMIC_ADD(&checks->pending, -1);
+}
+/*!
+    @brief Has checkCommand() called when a command that was just enqueued completes, if deferred error checking is on
+*/
+static void watchCommand(cl_event event)
+{
+    if (!gpu.deferChecks || event == NULL)
+    {
+        return;
+    }
+    ATOMIC_ADD(&gpu.deferred->pending, 1);
+    if (clSetEventCallback(event, CL_COMPLETE, checkCommand, gpu.deferred) != CL_SUCCESS)
+    {
+        ATOMIC_ADD(&gpu.deferred->pending, -1);
+    }
+}
+cl_int getError()
+{
+    const cl_int err = gpu.status;
+    const cl_int deferred = gpu.deferred != NULL ? ATOMIC_EXCHANGE(&gpu.deferred->status, CL_SUCCESS) : CL_SUCCESS;
+    gpu.status = CL_SUCCESS;
+    return err != CL_SUCCESS ? err : deferred;
+}
+const char *errorName(const cl_int err)
+{
+    static const char *names[] = {
+        ERROR_NAME(CL_SUCCESS),
+        ERROR_NAME(CL_DEVICE_NOT_FOUND),
+        ERROR_NAME(CL_DEVICE_NOT_AVAILABLE),
+        ERROR_NAME(CL_COMPILER_NOT_AVAILABLE),
+        ERROR_NAME(CL_MEM_OBJECT_ALLOCATION_FAILURE),
+        ERROR_NAME(CL_OUT_OF_RESOURCES),
+        ERROR_NAME(CL_OUT_OF_HOST_MEMORY),
+        ERROR_NAME(CL_PROFILING_INFO_NOT_AVAILABLE),
+        ERROR_NAME(CL_MEM_COPY_OVERLAP),
+        ERROR_NAME(CL_IMAGE_FORMAT_MISMATCH),
+        ERROR_NAME(CL_IMAGE_FORMAT_NOT_SUPPORTED),
+        ERROR_NAME(CL_BUILD_PROGRAM_FAILURE),
+        ERROR_NAME(CL_MAP_FAILURE),
+        ERROR_NAME(CL_MISALIGNED_SUB_BUFFER_OFFSET),
+        ERROR_NAME(CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST),
+        ERROR_NAME(CL_COMPILE_PROGRAM_FAILURE),
+        ERROR_NAME(CL_LINKER_NOT_AVAILABLE),
+        ERROR_NAME(CL_LINK_PROGRAM_FAILURE),
+        ERROR_NAME(CL_DEVICE_PARTITION_FAILED),
+        ERROR_NAME(CL_KERNEL_ARG_INFO_NOT_AVAILABLE),
+        ERROR_NAME(CL_INVALID_VALUE),
+        ERROR_NAME(CL_INVALID_DEVICE_TYPE),
+        ERROR_NAME(CL_INVALID_PLATFORM),
+        ERROR_NAME(CL_INVALID_DEVICE),
+        ERROR_NAME(CL_INVALID_CONTEXT),
+        ERROR_NAME(CL_INVALID_QUEUE_PROPERTIES),
+        ERROR_NAME(CL_INVALID_COMMAND_QUEUE),
+        ERROR_NAME(CL_INVALID_HOST_PTR),
+        ERROR_NAME(CL_INVALID_MEM_OBJECT),
+        ERROR_NAME(CL_INVALID_IMAGE_FORMAT_DESCRIPTOR),
+        ERROR_NAME(CL_INVALID_IMAGE_SIZE),
+        ERROR_NAME(CL_INVALID_SAMPLER),
+        ERROR_NAME(CL_INVALID_BINARY),
+        ERROR_NAME(CL_INVALID_BUILD_OPTIONS),
+        ERROR_NAME(CL_INVALID_PROGRAM),
+        ERROR_NAME(CL_INVALID_PROGRAM_EXECUTABLE),
+        ERROR_NAME(CL_INVALID_KERNEL_NAME),
+        ERROR_NAME(CL_INVALID_KERNEL_DEFINITION),
+        ERROR_NAME(CL_INVALID_KERNEL),
+        ERROR_NAME(CL_INVALID_ARG_INDEX),
+        ERROR_NAME(CL_INVALID_ARG_VALUE),
+        ERROR_NAME(CL_INVALID_ARG_SIZE),
+        ERROR_NAME(CL_INVALID_KERNEL_ARGS),
+        ERROR_NAME(CL_INVALID_WORK_DIMENSION),
+        ERROR_NAME(CL_INVALID_WORK_GROUP_SIZE),
+        ERROR_NAME(CL_INVALID_WORK_ITEM_SIZE),
+        ERROR_NAME(CL_INVALID_GLOBAL_OFFSET),
+        ERROR_NAME(CL_INVALID_EVENT_WAIT_LIST),
+        ERROR_NAME(CL_INVALID_EVENT),
+        ERROR_NAME(CL_INVALID_OPERATION),
+        ERROR_NAME(CL_INVALID_GL_OBJECT),
+        ERROR_NAME(CL_INVALID_BUFFER_SIZE),
+        ERROR_NAME(CL_INVALID_MIP_LEVEL),
+        ERROR_NAME(CL_INVALID_GLOBAL_WORK_SIZE),
+        ERROR_NAME(CL_INVALID_PROPERTY),
+        ERROR_NAME(CL_INVALID_IMAGE_DESCRIPTOR),
+        ERROR_NAME(CL_INVALID_COMPILER_OPTIONS),
+        ERROR_NAME(CL_INVALID_LINKER_OPTIONS),
+        ERROR_NAME(CL_INVALID_DEVICE_PARTITION_COUNT),
+    };
+    if (err > 0 || (size_t)-err >= sizeof(names) / sizeof(names[0]) || names[-err] == NULL)
+    {
+        return "unknown error";
+    }
+    return names[-err];
+}
+const char *getBuildLog()
+{
+    return gpu.buildLog;
+}
+void setDeferredErrorChecking(const int enabled)
+{
+    /* Callbacks of commands from before it was turned off may still come, so the checks are kept until the device is cleaned */
+    if (enabled && gpu.deferred == NULL)
+    {
+        gpu.deferred = calloc(1, sizeof(DeferredChecks));
+    }
+    gpu.deferChecks = enabled != 0 && gpu.deferred != NULL;
+}
+/*!
+    @brief Makes sure an array of a command graph has room for one more element
+
+    @returns 1 if there is room, otherwise 0 and the graph is marked as failed
+*/
+static int reserveGraph(CommandGraph *graph, void **array, unsigned int *capacity, const unsigned int count, const size_t element_size)
+{
+    if (count < *capacity)
+    {
+        return 1;
+    }
+    const unsigned int new_capacity = *capacity > 0 ? *capacity * 2 : 16;
+    void *grown = realloc(*array, element_size * new_capacity);
+    if (grown == NULL)
+    {
+        graph->failed = 1;
+        return 0;
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+/*!
+    @brief Sets a kernel argument and remembers it for the command graph being recorded so the recorded kernel gets the same arguments
+*/
+static cl_int setKernelArg(cl_kernel kernel, const cl_uint index, const size_t size, const void *value)
+{
+    CommandGraph *graph = gpu.graph;
+    if (graph != NULL && value != NULL && size > GRAPH_ARG_BYTES)
+    {
+        graph->failed = 1;
+    }
+    else if (graph != NULL)
+    {
+        unsigned int i = 0;
+        while (i < graph->argCount && (graph->args[i].kernel != kernel || graph->args[i].index != index))
+        {
+            i++;
+        }
+        if (i < graph->argCount || reserveGraph(graph, (void **)&graph->args, &graph->argCapacity, graph->argCount, sizeof(GraphArg)))
+        {
+            GraphArg *arg = &graph->args[i];
+            graph->argCount += i == graph->argCount;
+            arg->kernel = kernel;
+            arg->index = index;
+            arg->size = size;
+            arg->local = value == NULL;
+            if (value != NULL)
+            {
+                memcpy(arg->value, value, size);
+            }
+        }
+    }
+    const cl_int err = clSetKernelArg(kernel, index, size, value);
+    recordError(err);
+    return err;
+}
+/*!
+    @brief Adds a command to the graph being recorded
+
+    @details
+    Nothing runs while recording, so the event the operation gives back is one that is already complete.
+*/
+static void recordCommand(const GraphCommand *command, cl_event *event)
+{
+    CommandGraph *graph = gpu.graph;
+    if (reserveGraph(graph, (void **)&graph->commands, &graph->capacity, graph->count, sizeof(GraphCommand)))
+    {
+        graph->commands[graph->count++] = *command;
+    }
+    if (event != NULL)
+    {
+        *event = clCreateUserEvent(gpu.context, &gpu.err);
+        gpu.err = clSetUserEventStatus(*event, CL_COMPLETE);
+    }
+}
+/*!
+    @brief Records a kernel launch by making a new kernel from the same program and giving it every argument that was set on the kernel while recording
+*/
+static void recordKernel(cl_kernel kernel, const cl_uint dims, const size_t *global_work_size, const size_t *local_work_size, cl_event *event)
+{
+    CommandGraph *graph = gpu.graph;
+    char name[128];
+    cl_program program = NULL;
+    gpu.err = clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof(name), name, NULL);
+    gpu.err = clGetKernelInfo(kernel, CL_KERNEL_PROGRAM, sizeof(cl_program), &program, NULL);
+    GraphCommand command;
+    memset(&command, 0, sizeof(command));
+    command.kind = GRAPH_KERNEL;
+    command.kernel = clCreateKernel(program, name, &gpu.err);
+    if (gpu.err != CL_SUCCESS)
+    {
+        graph->failed = 1;
+        failCommand(gpu.err, event);
+        return;
+    }
+    for (unsigned int i = 0; i < graph->argCount; i++)
+    {
+        const GraphArg *arg = &graph->args[i];
+        if (arg->kernel == kernel)
+        {
+            gpu.err = clSetKernelArg(command.kernel, arg->index, arg->size, arg->local ? NULL : arg->value);
+            graph->failed |= gpu.err != CL_SUCCESS;
+        }
+    }
+    command.dims = dims;
+    for (cl_uint i = 0; i < dims; i++)
+    {
+        command.global[i] = global_work_size[i];
+        command.local[i] = local_work_size != NULL ? local_work_size[i] : 0;
+    }
+    recordCommand(&command, event);
+}
+/*!
+    @brief Fails an operation on host shapes, or one that times the GPU, called while a command graph is being recorded
+
+    @details
+    Recording would keep some of its commands and skip or run the others, so the graph and anything measured from it would be wrong, see beginCommandGraph().
+
+    @returns 1 if the operation must not run, then it has failed with CL_INVALID_OPERATION
+*/
+static int recordingHostOp(cl_event *event)
+{
+    if (gpu.graph == NULL)
+    {
+        return 0;
+    }
+    failCommand(CL_INVALID_OPERATION, event);
+    return 1;
+}
+/*!
+    @brief Checks if a host shape can be used by the GPU directly instead of being copied
+
+    @details
+    This is only possible on GPUs that share memory with the host, and only for memory that is page aligned and a whole number of cache lines long, like the memory from createAlignedShapeF().
+*/
+static int canWrapHostPtr(const void *s, const size_t size)
+{
+    return gpu.unifiedMemory && size > 0 && (uintptr_t)s % ZERO_COPY_ALIGNMENT == 0 && size % ZERO_COPY_SIZE_MULTIPLE == 0;
+}
+/*!
+    @brief Checks if a buffer wraps host memory, these are never given to the buffer pool
+*/
+static int isWrappedBuffer(cl_mem buffer)
+{
+    cl_mem_flags flags = 0;
+    clGetMemObjectInfo(buffer, CL_MEM_FLAGS, sizeof(cl_mem_flags), &flags, NULL);
+    return (flags & CL_MEM_USE_HOST_PTR) != 0;
+}
+/*!
+    @brief Creates a buffer and counts it for getResourceStats()
+*/
+static cl_mem createBuffer(const cl_mem_flags flags, const size_t size, void *host)
+{
+    cl_mem buffer = clCreateBuffer(gpu.context, flags, size, host, &gpu.err);
+    if (gpu.err == CL_SUCCESS)
+    {
+        gpu.pool.created++;
+        gpu.pool.allocated += size;
+    }
+    return buffer;
+}
+/*!
+    @brief Releases a buffer of size bytes and counts it for getResourceStats()
+*/
+static void destroyBuffer(cl_mem buffer, const size_t size)
+{
+    clReleaseMemObject(buffer);
+    gpu.pool.released++;
+    gpu.pool.allocated -= size < gpu.pool.allocated ? size : gpu.pool.allocated;
+}
+/*!
+    @brief Gives the bucket of the buffer pool that holds buffers big enough for size bytes
+*/
+static unsigned int poolBucket(const size_t size)
+{
+    unsigned int bucket = 0;
+    while (bucket < BUFFER_POOL_BUCKETS - 1 && ((size_t)BUFFER_POOL_MIN_SIZE << bucket) < size)
+    {
+        bucket++;
+    }
+    return bucket;
+}
+/*!
+    @brief Takes a buffer of at least size bytes from the buffer pool, creating one if the pool has none
+
+    @details
+    Buffers are created with the size of their bucket, which is a power of two, so any buffer in a bucket fits every size that maps to it.
+    If the GPU is out of memory the pool is trimmed and the buffer is created again.
+*/
+static cl_mem acquireBuffer(const size_t size)
+{
+    const unsigned int bucket = poolBucket(size);
+    const size_t bucket_size = (size_t)BUFFER_POOL_MIN_SIZE << bucket;
+    if (gpu.pool.counts[bucket] > 0)
+    {
+        gpu.pool.hits++;
+        gpu.pool.held -= bucket_size;
+        return gpu.pool.buffers[bucket][--gpu.pool.counts[bucket]];
+    }
+    gpu.pool.misses++;
+    cl_mem buffer = createBuffer(CL_MEM_READ_WRITE, bucket_size, NULL);
+    if (gpu.err == CL_MEM_OBJECT_ALLOCATION_FAILURE || gpu.err == CL_OUT_OF_RESOURCES)
+    {
+        trimBufferPool();
+        buffer = createBuffer(CL_MEM_READ_WRITE, bucket_size, NULL);
+    }
+    recordError(gpu.err);
+    return buffer;
+}
+/*!
+    @brief Gives a buffer from acquireBuffer() back to the buffer pool, or releases it if that would put the pool over its limit
+
+    @details
+    Commands that are still queued on gpu.queue can keep using the buffer because every command that takes it from the pool later on is queued after them.
+*/
+static void releaseBuffer(cl_mem buffer)
+{
+    if (buffer == NULL)
+    {
+        return;
+    }
+    CommandGraph *graph = gpu.graph;
+    if (graph != NULL)
+    {
+        /* Commands of the graph being recorded still use the buffer, so it is kept until the graph is released */
+        if (reserveGraph(graph, (void **)&graph->buffers, &graph->bufferCapacity, graph->bufferCount, sizeof(cl_mem)))
+        {
+            graph->buffers[graph->bufferCount++] = buffer;
+        }
+        return;
+    }
+    size_t size = 0;
+    clGetMemObjectInfo(buffer, CL_MEM_SIZE, sizeof(size_t), &size, NULL);
+    const unsigned int bucket = poolBucket(size);
+    if (((size_t)BUFFER_POOL_MIN_SIZE << bucket) != size || gpu.pool.held + size > gpu.pool.limit || isWrappedBuffer(buffer))
+    {
+        destroyBuffer(buffer, size);
+        return;
+    }
+    if (gpu.pool.counts[bucket] == gpu.pool.capacities[bucket])
+    {
+        const unsigned int capacity = gpu.pool.capacities[bucket] == 0 ? 4 : gpu.pool.capacities[bucket] * 2;
+        cl_mem *buffers = realloc(gpu.pool.buffers[bucket], sizeof(cl_mem) * capacity);
+        if (buffers == NULL)
+        {
+            destroyBuffer(buffer, size);
+            return;
+        }
+        gpu.pool.buffers[bucket] = buffers;
+        gpu.pool.capacities[bucket] = capacity;
+    }
+    gpu.pool.buffers[bucket][gpu.pool.counts[bucket]++] = buffer;
+    gpu.pool.held += size;
+}
+void trimBufferPool()
+{
+    for (unsigned int i = 0; i < BUFFER_POOL_BUCKETS; i++)
+    {
+        for (unsigned int j = 0; j < gpu.pool.counts[i]; j++)
+        {
+            destroyBuffer(gpu.pool.buffers[i][j], (size_t)BUFFER_POOL_MIN_SIZE << i);
+        }
+        gpu.pool.counts[i] = 0;
+    }
+    gpu.pool.held = 0;
+}
+void setBufferPoolLimit(const size_t bytes)
+{
+    gpu.pool.limit = bytes;
+    if (gpu.pool.held > bytes)
+    {
+        trimBufferPool();
+    }
+}
+void getBufferPoolStats(BufferPoolStats *stats)
+{
+    stats->hits = gpu.pool.hits;
+    stats->misses = gpu.pool.misses;
+    stats->held = gpu.pool.held;
+    stats->limit = gpu.pool.limit;
+}
+/*!
+    @brief Waits for an event to complete and then releases it
+*/
+static void finishEvent(cl_event event)
+{
+    if (event == NULL)
+    {
+        return;
+    }
+    gpu.err = clWaitForEvents(1, &event);
+    recordError(gpu.err);
+    clReleaseEvent(event);
+}
+/*!
+    @brief Gives the event pointer an enqueue should use so the profiler and deferred error checking get an event even when the caller did not ask for one
+*/
+static cl_event *profileEvent(cl_event *event)
+{
+    return event == NULL && (gpu.profiler.enabled || gpu.deferChecks) ? &gpu.profiler.scratch : event;
+}
+/*!
+    @brief Sets the operation and shape that the next profiled commands belong to
+*/
+static void profileOp(const char *op, const unsigned int r, const unsigned int c)
+{
+    if (!gpu.profiler.enabled)
+    {
+        return;
+    }
+    snprintf(gpu.profiler.op, sizeof(gpu.profiler.op), "%s", op);
+    gpu.profiler.r = r;
+    gpu.profiler.c = c;
+}
+/*!
+    @brief Reads the timestamps of a recorded command that has finished and releases its event
+*/
+static void resolveRecord(ProfileRecord *record)
+{
+    /* Commands that failed have no times, which leaves them at 0 and must not change gpu.err of the command being recorded */
+    cl_int err = clGetEventProfilingInfo(record->event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &record->queued, NULL);
+    err |= clGetEventProfilingInfo(record->event, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &record->submitted, NULL);
+    err |= clGetEventProfilingInfo(record->event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &record->started, NULL);
+    err |= clGetEventProfilingInfo(record->event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &record->ended, NULL);
+    if (err != CL_SUCCESS)
+    {
+        record->queued = record->submitted = record->started = record->ended = 0;
+    }
+    clReleaseEvent(record->event);
+    record->event = NULL;
+}
+/*!
+    @brief Reads the timestamps of the oldest recorded commands so the profiler holds fewer than PROFILE_HELD_EVENTS events
+
+    @details
+    Commands that have already finished are read without waiting, then if the GPU is so far behind that the profiler would still hold too many the oldest commands are waited for.
+*/
+static void resolveHeld()
+{
+    while (gpu.profiler.resolved < gpu.profiler.count)
+    {
+        ProfileRecord *record = &gpu.profiler.records[gpu.profiler.resolved];
+        cl_int status = CL_QUEUED;
+        clGetEventInfo(record->event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), &status, NULL);
+        if (status > CL_COMPLETE && gpu.profiler.count - gpu.profiler.resolved < PROFILE_HELD_EVENTS)
+        {
+            return;
+        }
+        if (status > CL_COMPLETE)
+        {
+            clWaitForEvents(1, &record->event);
+        }
+        resolveRecord(record);
+        gpu.profiler.resolved++;
+    }
+}
+/*!
+    @brief Releases the event profileEvent() made for a command that the profiler is not keeping
+*/
+static void releaseScratchEvent()
+{
+    if (gpu.profiler.scratch != NULL)
+    {
+        clReleaseEvent(gpu.profiler.scratch);
+        gpu.profiler.scratch = NULL;
+    }
+}
+/*!
+    @brief Records a command that was just enqueued with profileEvent(event) in the profiler and checks it for errors
+
+    @details
+    The timestamps are only read when they are needed by getProfileStats() or writeProfileTrace(), so recording never waits for the GPU.
+    The profiler keeps its own reference to the event so the caller can still release theirs right away.
+*/
+static void profileCommand(const ProfileKind kind, cl_kernel kernel, const size_t bytes, cl_event *event)
+{
+    if (gpu.err != CL_SUCCESS)
+    {
+        failCommand(gpu.err, event);
+    }
+    else
+    {
+        watchCommand(event != NULL ? *event : gpu.profiler.scratch);
+    }
+    if (!gpu.profiler.enabled || gpu.err != CL_SUCCESS)
+    {
+        releaseScratchEvent();
+        return;
+    }
+    if (gpu.profiler.count == gpu.profiler.capacity)
+    {
+        const unsigned int capacity = gpu.profiler.capacity > 0 ? gpu.profiler.capacity * 2 : 256;
+        ProfileRecord *records = realloc(gpu.profiler.records, sizeof(ProfileRecord) * capacity);
+        if (records == NULL)
+        {
+            releaseScratchEvent();
+            return;
+        }
+        gpu.profiler.records = records;
+        gpu.profiler.capacity = capacity;
+    }
+    ProfileRecord *record = &gpu.profiler.records[gpu.profiler.count++];
+    memset(record, 0, sizeof(ProfileRecord));
+    record->kind = kind;
+    record->r = gpu.profiler.r;
+    record->c = gpu.profiler.c;
+    record->bytes = bytes;
+    if (kernel != NULL)
+    {
+        gpu.err = clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof(record->name), record->name, NULL);
+    }
+    else
+    {
+        snprintf(record->name, sizeof(record->name), "%s", kind == PROFILE_UPLOAD ? "upload" : "download");
+    }
+    snprintf(record->op, sizeof(record->op), "%s", gpu.profiler.op[0] != '\0' ? gpu.profiler.op : record->name);
+    if (event == NULL)
+    {
+        record->event = gpu.profiler.scratch;
+        gpu.profiler.scratch = NULL;
+    }
+    else
+    {
+        record->event = *event;
+        clRetainEvent(record->event);
+    }
+    if (gpu.profiler.count - gpu.profiler.resolved >= PROFILE_HELD_EVENTS)
+    {
+        resolveHeld();
+    }
+}
+/*!
+    @brief Waits for every recorded command and reads its timestamps
+*/
+static void resolveProfile()
+{
+    if (gpu.profiler.resolved == gpu.profiler.count)
+    {
+        return;
+    }
+    clFinish(gpu.queue);
+    clFinish(gpu.uploadQueue);
+    clFinish(gpu.downloadQueue);
+    for (unsigned int i = gpu.profiler.resolved; i < gpu.profiler.count; i++)
+    {
+        resolveRecord(&gpu.profiler.records[i]);
+    }
+    gpu.profiler.resolved = gpu.profiler.count;
+}
+void getResourceStats(ResourceStats *stats)
+{
+    stats->events = gpu.profiler.count - gpu.profiler.resolved;
+    stats->pendingChecks = gpu.deferred != NULL && gpu.deferred->pending > 0 ? (unsigned int)gpu.deferred->pending : 0;
+    stats->buffersCreated = gpu.pool.created;
+    stats->buffersReleased = gpu.pool.released;
+    stats->bufferBytes = gpu.pool.allocated;
+}
+void startProfiler()
+{
+    gpu.profiler.enabled = 1;
+}
+void stopProfiler()
+{
+    gpu.profiler.enabled = 0;
+}
+void clearProfiler()
+{
+    resolveProfile();
+    free(gpu.profiler.records);
+    gpu.profiler.records = NULL;
+    gpu.profiler.count = 0;
+    gpu.profiler.capacity = 0;
+    gpu.profiler.resolved = 0;
+}
+static int compareDoubles(const void *a, const void *b)
+{
+    const double x = *(const double *)a;
+    const double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+/*!
+    @brief Gives the value below which a fraction of the sorted values fall
+*/
+static double percentile(const double *sorted, const unsigned int n, const double fraction)
+{
+    const unsigned int i = (unsigned int)(fraction * (n - 1) + 0.5);
+    return sorted[i];
+}
+static int sameProfileGroup(const ProfileRecord *a, const ProfileRecord *b)
+{
+    return a->kind == b->kind && a->r == b->r && a->c == b->c && strcmp(a->op, b->op) == 0 && strcmp(a->name, b->name) == 0;
+}
+unsigned int getProfileStats(ProfileStats *stats, const unsigned int max_stats)
+{
+    resolveProfile();
+    const unsigned int count = gpu.profiler.count;
+    unsigned int groups = 0;
+    double *times = malloc(sizeof(double) * (count + 1));
+    unsigned char *done = calloc(count + 1, 1);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (done[i])
+        {
+            continue;
+        }
+        const ProfileRecord *first = &gpu.profiler.records[i];
+        ProfileStats group = {first->op, first->name, first->kind, first->r, first->c, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        double delay = 0;
+        for (unsigned int j = i; j < count; j++)
+        {
+            const ProfileRecord *record = &gpu.profiler.records[j];
+            if (done[j] || !sameProfileGroup(first, record))
+            {
+                continue;
+            }
+            done[j] = 1;
+            times[group.count++] = (record->ended - record->started) * 1e-6;
+            group.bytes += record->bytes;
+            delay += (record->started - record->queued) * 1e-6;
+        }
+        qsort(times, group.count, sizeof(double), compareDoubles);
+        for (unsigned int j = 0; j < group.count; j++)
+        {
+            group.total += times[j];
+        }
+        group.mean = group.total / group.count;
+        group.queueDelay = delay / group.count;
+        group.p50 = percentile(times, group.count, 0.5);
+        group.p90 = percentile(times, group.count, 0.9);
+        group.p99 = percentile(times, group.count, 0.99);
+        group.max = times[group.count - 1];
+        if (groups < max_stats)
+        {
+            stats[groups] = group;
+        }
+        groups++;
+    }
+    free(times);
+    free(done);
+    return groups;
+}
+int writeProfileTrace(const char *path)
+{
+    resolveProfile();
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        return 0;
+    }
+    static const char *lanes[] = {"Uploads", "Kernels", "Downloads"};
+    cl_ulong origin = 0;
+    for (unsigned int i = 0; i < gpu.profiler.count; i++)
+    {
+        if (i == 0 || gpu.profiler.records[i].queued < origin)
+        {
+            origin = gpu.profiler.records[i].queued;
+        }
+    }
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n", i, lanes[i]);
+    }
+    for (unsigned int i = 0; i < gpu.profiler.count; i++)
+    {
+        const ProfileRecord *record = &gpu.profiler.records[i];
+        fprintf(file, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+                      "\"args\":{\"op\":\"%s\",\"r\":%u,\"c\":%u,\"bytes\":%llu,\"queued_us\":%.3f,\"submitted_us\":%.3f}}%s\n",
+                record->name, lanes[record->kind], (unsigned int)record->kind, (record->started - origin) * 1e-3, (record->ended - record->started) * 1e-3,
+                record->op, record->r, record->c, (unsigned long long)record->bytes, (record->queued - origin) * 1e-3, (record->submitted - origin) * 1e-3,
+                i + 1 < gpu.profiler.count ? "," : "");
+    }
+    fprintf(file, "]}\n");
+    return fclose(file) == 0;
+}
+/*!
+    @brief Enqueues a kernel on gpu.queue and records it in the profiler
+*/
+static void enqueueKernel(cl_kernel kernel, const cl_uint dims, const size_t *global_work_size, const size_t *local_work_size, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (gpu.graph != NULL)
+    {
+        recordKernel(kernel, dims, global_work_size, local_work_size, event);
+        return;
+    }
+    gpu.err = clEnqueueNDRangeKernel(gpu.queue, kernel, dims, NULL, global_work_size, local_work_size, num_events, wait_list, profileEvent(event));
+    profileCommand(PROFILE_KERNEL, kernel, 0, event);
+}
+/*!
+    @brief Enqueues a copy from host memory to a buffer and records it in the profiler
+*/
+static void enqueueWrite(cl_command_queue queue, cl_mem buffer, const size_t size, const void *s, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (gpu.graph != NULL)
+    {
+        const GraphCommand command = {GRAPH_WRITE, NULL, 0, {0}, {0}, buffer, size, (void *)s};
+        recordCommand(&command, event);
+        return;
+    }
+    gpu.err = clEnqueueWriteBuffer(queue, buffer, CL_FALSE, 0, size, s, num_events, wait_list, profileEvent(event));
+    profileCommand(PROFILE_UPLOAD, NULL, size, event);
+}
+/*!
+    @brief Enqueues a copy from a buffer to host memory and records it in the profiler
+*/
+static void enqueueRead(cl_command_queue queue, cl_mem buffer, const cl_bool blocking, const size_t size, void *s, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (gpu.graph != NULL)
+    {
+        const GraphCommand command = {GRAPH_READ, NULL, 0, {0}, {0}, buffer, size, s};
+        recordCommand(&command, event);
+        return;
+    }
+    gpu.err = clEnqueueReadBuffer(queue, buffer, blocking, 0, size, s, num_events, wait_list, profileEvent(event));
+    profileCommand(PROFILE_DOWNLOAD, NULL, size, event);
+}
+/*!
+    @brief Enqueues a copy of a rows by cols block of floats in host memory, whose rows start ld elements apart, into a dense buffer and records it in the profiler
+*/
+static void enqueueWriteRect(cl_command_queue queue, cl_mem buffer, const unsigned int rows, const unsigned int cols, const unsigned int ld, const float *s, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    const size_t origin[3] = {0, 0, 0};
+    const size_t region[3] = {sizeof(float) * cols, rows, 1};
+    gpu.err = clEnqueueWriteBufferRect(queue, buffer, CL_FALSE, origin, origin, region, sizeof(float) * cols, 0, sizeof(float) * ld, 0, s, num_events, wait_list, profileEvent(event));
+    profileCommand(PROFILE_UPLOAD, NULL, sizeof(float) * rows * cols, event);
+}
+/*!
+    @brief Enqueues a copy of a dense buffer into a rows by cols block of floats in host memory whose rows start ld elements apart and records it in the profiler
+*/
+static void enqueueReadRect(cl_command_queue queue, cl_mem buffer, const unsigned int rows, const unsigned int cols, const unsigned int ld, float *s, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    const size_t origin[3] = {0, 0, 0};
+    const size_t region[3] = {sizeof(float) * cols, rows, 1};
+    gpu.err = clEnqueueReadBufferRect(queue, buffer, CL_FALSE, origin, origin, region, sizeof(float) * cols, 0, sizeof(float) * ld, 0, s, num_events, wait_list, profileEvent(event));
+    profileCommand(PROFILE_DOWNLOAD, NULL, sizeof(float) * rows * cols, event);
+}
+/*!
+    @brief Gives the size class of an operation on an amount of elements, see TuneConfig
+*/
+static unsigned int sizeClass(const double elements)
+{
+    return elements < TUNE_MEDIUM_ELEMENTS ? 0 : elements < TUNE_LARGE_ELEMENTS ? 1 : 2;
+}
+/*!
+    @brief Gives the tuned work group size of an operation on an amount of elements, never more than the GPU allows
+*/
+static size_t tunedGroup(const unsigned int *groups, const double elements)
+{
+    const size_t group = groups[sizeClass(elements)];
+    return group < gpu.maxWorkGroupSize ? group : gpu.maxWorkGroupSize;
+}
+/*!
+    @brief Gives the build options that compile a tuned config into kernel_code
+*/
+static void tuneOptions(const TuneConfig *config, char *options, const size_t size)
+{
+    snprintf(options, size, "-DVECTOR_WIDTH=%u -DTSM=%u -DTSN=%u -DTSK=%u -DWPTM=%u -DWPTN=%u", config->vectorWidth, config->dotTile, config->dotTile, config->dotTileK, config->dotWork, config->dotWork);
+}
+/*!
+    @brief Enqueues an elementwise kernel whose arguments are already set over n elements, see enqueueShapesF()
+*/
+static void enqueueElementwise(const Kernels *kernels, cl_kernel kernel, const unsigned int n, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    const size_t localSize[1] = {tunedGroup(gpu.tune.elementwiseGroup, n)};
+    const size_t vectors = n / kernels->vectorWidth + 1;
+    size_t groups = (vectors + localSize[0] - 1) / localSize[0];
+    if (groups > (size_t)gpu.computeUnits * ELEMENTWISE_GROUPS_PER_UNIT)
+    {
+        groups = (size_t)gpu.computeUnits * ELEMENTWISE_GROUPS_PER_UNIT;
+    }
+    const size_t globalSize[1] = {groups * localSize[0]};
+    enqueueKernel(kernel, 1, globalSize, localSize, num_events, wait_list, event);
+}
+/*!
+    @brief Enqueues one of the elementwise kernels on buffers that are already on the GPU
+
+    @details
+    Every work item handles vectors of kernels->vectorWidth elements in a grid stride loop and the elements after the last whole vector are handled one at a time, so n can be any length.
+    Only enough work groups to fill every compute unit a few times are started because each work item loops over as many vectors as it needs.
+*/
+static void enqueueShapesF(const Kernels *kernels, cl_kernel kernel, cl_mem s1, cl_mem s2, cl_mem s3, const unsigned int n, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    gpu.err = setKernelArg(kernel, 0, sizeof(cl_mem), &s1);
+    gpu.err = setKernelArg(kernel, 1, sizeof(cl_mem), &s2);
+    gpu.err = setKernelArg(kernel, 2, sizeof(cl_mem), &s3);
+    gpu.err = setKernelArg(kernel, 3, sizeof(const unsigned int), &n);
+    enqueueElementwise(kernels, kernel, n, num_events, wait_list, event);
+}
+/*!
+    @brief Enqueues the scalar kernel, which applies an elementwise operation to every element of s and k
+*/
+static void enqueueScalarShapesF(const Kernels *kernels, cl_mem s, const float k, cl_mem out, const unsigned int n, const ShapeOp op, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    const cl_uint kernel_op = op;
+    gpu.err = setKernelArg(kernels->scalarFKernel, 0, sizeof(cl_mem), &s);
+    gpu.err = setKernelArg(kernels->scalarFKernel, 1, sizeof(const float), &k);
+    gpu.err = setKernelArg(kernels->scalarFKernel, 2, sizeof(cl_mem), &out);
+    gpu.err = setKernelArg(kernels->scalarFKernel, 3, sizeof(const unsigned int), &n);
+    gpu.err = setKernelArg(kernels->scalarFKernel, 4, sizeof(const cl_uint), &kernel_op);
+    enqueueElementwise(kernels, kernels->scalarFKernel, n, num_events, wait_list, event);
+}
+/*!
+    @brief Enqueues the broadcast kernel, which applies an elementwise operation to every element of an r by c shape and the element of v in its column or row
+*/
+static void enqueueBroadcastShapesF(const Kernels *kernels, cl_mem s, cl_mem v, cl_mem out, const unsigned int r, const unsigned int c, const BroadcastAxis axis, const ShapeOp op, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    const cl_uint kernel_axis = axis;
+    const cl_uint kernel_op = op;
+    gpu.err = setKernelArg(kernels->broadcastFKernel, 0, sizeof(cl_mem), &s);
+    gpu.err = setKernelArg(kernels->broadcastFKernel, 1, sizeof(cl_mem), &v);
+    gpu.err = setKernelArg(kernels->broadcastFKernel, 2, sizeof(cl_mem), &out);
+    gpu.err = setKernelArg(kernels->broadcastFKernel, 3, sizeof(const unsigned int), &c);
+    gpu.err = setKernelArg(kernels->broadcastFKernel, 4, sizeof(const cl_uint), &kernel_axis);
+    gpu.err = setKernelArg(kernels->broadcastFKernel, 5, sizeof(const cl_uint), &kernel_op);
+    const size_t localSize[2] = {tunedGroup(gpu.tune.elementwiseGroup, (double)r * c), 1};
+    const size_t globalSize[2] = {(c + localSize[0] - 1) / localSize[0] * localSize[0], r};
+    enqueueKernel(kernels->broadcastFKernel, 2, globalSize, localSize, num_events, wait_list, event);
+}
+/*!
+    @brief Enqueues the dot product kernel on buffers that are already on the GPU
+
+    @details
+    Every work group computes a dotTile by dotTile block of s3 by staging narrow tiles of s1 and s2 in local memory, and every work item keeps a dotWork by dotWork block of sums in registers, the sizes are the ones the program of the kernels was built with.
+    The tiles are padded with zeros at the edges so r, c and c2 can be any size.
+    The third dimension of the NDRange runs over the batch, and the strides are the amount of elements between the matrices of the batch.
+    4 by 4 and 16 by 16 matrices have their own kernels which do a whole matrix per work item or per work group because most of a 64 by 64 tile would be wasted on them.
+    An epilogue is applied to the sums in registers right before they are stored, it can only be NULL when there is nothing to apply, and then the small matrix kernels can be used.
+    s1 and s2 are used as they are stored or transposed, r, c and c2 are the sizes after transposing and ld1, ld2 and ld3 are the elements between the starts of two rows as the matrices are stored.
+*/
+static void enqueueDotMatricesStrided(const Kernels *kernels, const Transpose trans1, const Transpose trans2, cl_mem s1, const unsigned int ld1, cl_mem s2, const unsigned int ld2, cl_mem s3, const unsigned int ld3, const unsigned int r, const unsigned int c, const unsigned int c2, const unsigned int batch, const unsigned int stride1, const unsigned int stride2, const unsigned int stride3, const Epilogue *epilogue, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    const int dense = trans1 == NO_TRANSPOSE && trans2 == NO_TRANSPOSE && ld1 == c && ld2 == c2 && ld3 == c2;
+    if (epilogue == NULL && dense && r == 4 && c == 4 && c2 == 4)
+    {
+        gpu.err = setKernelArg(kernels->dot4x4FKernel, 0, sizeof(cl_mem), &s1);
+        gpu.err = setKernelArg(kernels->dot4x4FKernel, 1, sizeof(cl_mem), &s2);
+        gpu.err = setKernelArg(kernels->dot4x4FKernel, 2, sizeof(cl_mem), &s3);
+        gpu.err = setKernelArg(kernels->dot4x4FKernel, 3, sizeof(const unsigned int), &batch);
+        gpu.err = setKernelArg(kernels->dot4x4FKernel, 4, sizeof(const unsigned int), &stride1);
+        gpu.err = setKernelArg(kernels->dot4x4FKernel, 5, sizeof(const unsigned int), &stride2);
+        gpu.err = setKernelArg(kernels->dot4x4FKernel, 6, sizeof(const unsigned int), &stride3);
+        const size_t local_work_size[1] = {64};
+        const size_t global_work_size[1] = {(batch + local_work_size[0] - 1) / local_work_size[0] * local_work_size[0]};
+        enqueueKernel(kernels->dot4x4FKernel, 1, global_work_size, local_work_size, num_events, wait_list, event);
+        return;
+    }
+    /* The 16x16 kernel needs a work group of 256, smaller GPUs use the tiled kernel */
+    if (epilogue == NULL && dense && r == 16 && c == 16 && c2 == 16 && gpu.maxWorkGroupSize >= 256)
+    {
+        gpu.err = setKernelArg(kernels->dot16x16FKernel, 0, sizeof(cl_mem), &s1);
+        gpu.err = setKernelArg(kernels->dot16x16FKernel, 1, sizeof(cl_mem), &s2);
+        gpu.err = setKernelArg(kernels->dot16x16FKernel, 2, sizeof(cl_mem), &s3);
+        gpu.err = setKernelArg(kernels->dot16x16FKernel, 3, sizeof(const unsigned int), &stride1);
+        gpu.err = setKernelArg(kernels->dot16x16FKernel, 4, sizeof(const unsigned int), &stride2);
+        gpu.err = setKernelArg(kernels->dot16x16FKernel, 5, sizeof(const unsigned int), &stride3);
+        const size_t global_work_size[3] = {16, 16, batch};
+        const size_t local_work_size[3] = {16, 16, 1};
+        enqueueKernel(kernels->dot16x16FKernel, 3, global_work_size, local_work_size, num_events, wait_list, event);
+        return;
+    }
+    gpu.err = setKernelArg(kernels->dotFKernel, 0, sizeof(cl_mem), &s1);
+    gpu.err = setKernelArg(kernels->dotFKernel, 1, sizeof(cl_mem), &s2);
+    gpu.err = setKernelArg(kernels->dotFKernel, 2, sizeof(cl_mem), &s3);
+    gpu.err = setKernelArg(kernels->dotFKernel, 3, sizeof(const unsigned int), &r);
+    gpu.err = setKernelArg(kernels->dotFKernel, 4, sizeof(const unsigned int), &c);
+    gpu.err = setKernelArg(kernels->dotFKernel, 5, sizeof(const unsigned int), &c2);
+    gpu.err = setKernelArg(kernels->dotFKernel, 6, sizeof(const unsigned int), &stride1);
+    gpu.err = setKernelArg(kernels->dotFKernel, 7, sizeof(const unsigned int), &stride2);
+    gpu.err = setKernelArg(kernels->dotFKernel, 8, sizeof(const unsigned int), &stride3);
+    epilogue = epilogue != NULL ? epilogue : &noEpilogue;
+    const cl_uint activation = epilogue->activation;
+    gpu.err = setKernelArg(kernels->dotFKernel, 9, sizeof(cl_mem), epilogue->beta != 0.0f ? &epilogue->c : NULL);
+    gpu.err = setKernelArg(kernels->dotFKernel, 10, sizeof(const float), &epilogue->alpha);
+    gpu.err = setKernelArg(kernels->dotFKernel, 11, sizeof(const float), &epilogue->beta);
+    gpu.err = setKernelArg(kernels->dotFKernel, 12, sizeof(cl_mem), epilogue->bias != NULL ? &epilogue->bias : NULL);
+    gpu.err = setKernelArg(kernels->dotFKernel, 13, sizeof(const cl_uint), &activation);
+    const cl_uint kernel_trans1 = trans1;
+    const cl_uint kernel_trans2 = trans2;
+    gpu.err = setKernelArg(kernels->dotFKernel, 14, sizeof(const unsigned int), &ld1);
+    gpu.err = setKernelArg(kernels->dotFKernel, 15, sizeof(const unsigned int), &ld2);
+    gpu.err = setKernelArg(kernels->dotFKernel, 16, sizeof(const unsigned int), &ld3);
+    gpu.err = setKernelArg(kernels->dotFKernel, 17, sizeof(const cl_uint), &kernel_trans1);
+    gpu.err = setKernelArg(kernels->dotFKernel, 18, sizeof(const cl_uint), &kernel_trans2);
+    const unsigned int tile = kernels->dotTile;
+    const unsigned int threads = kernels->dotTile / kernels->dotWork;
+    const size_t global_work_size[3] = {(c2 + tile - 1) / tile * threads, (r + tile - 1) / tile * threads, batch};
+    const size_t local_work_size[3] = {threads, threads, 1};
+    enqueueKernel(kernels->dotFKernel, 3, global_work_size, local_work_size, num_events, wait_list, event);
+}
+/*!
+    @brief Enqueues the dot product kernel on dense matrices that are not transposed, see enqueueDotMatricesStrided()
+*/
+static void enqueueDotMatrices(const Kernels *kernels, cl_mem s1, cl_mem s2, cl_mem s3, const unsigned int r, const unsigned int c, const unsigned int c2, const unsigned int batch, const unsigned int stride1, const unsigned int stride2, const unsigned int stride3, const Epilogue *epilogue, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    enqueueDotMatricesStrided(kernels, NO_TRANSPOSE, NO_TRANSPOSE, s1, c, s2, c2, s3, c2, r, c, c2, batch, stride1, stride2, stride3, epilogue, num_events, wait_list, event);
+}
+/*!
+    @brief Enqueues the kernels that multiply a vector by the transpose of a matrix stored with c rows, r columns and ld elements between the starts of its rows
+
+    @details
+    Every work item sums one element of out over a chunk of the rows of m, so neighbouring work items read neighbouring elements and a transposed matrix is never copied.
+    The chunks are picked the same way as for a reduction of columns, and when there is more than one the partial sums are added into out by the same kernel enqueueMatVecStrided() uses.
+*/
+static void enqueueMatVecTransposed(const Kernels *kernels, cl_mem m, const unsigned int ld, cl_mem v, cl_mem out, const unsigned int r, const unsigned int c, const unsigned int batch, const unsigned int stride_m, const unsigned int stride_v, const unsigned int stride_out, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    const unsigned int rows = r * batch;
+    unsigned int splits = (gpu.computeUnits * REDUCE_COLUMN_ITEMS_PER_UNIT + rows - 1) / rows;
+    const unsigned int max_splits = (c + REDUCE_COLUMN_MIN_ROWS - 1) / REDUCE_COLUMN_MIN_ROWS;
+    splits = splits > max_splits ? max_splits : splits;
+    splits = splits < 1 ? 1 : splits;
+    const unsigned int chunk = (c + splits - 1) / splits;
+    cl_mem partials = out;
+    unsigned int stride_partials = stride_out;
+    if (splits > 1)
+    {
+        partials = acquireBuffer(kernels->elementSize * rows * splits);
+        stride_partials = r * splits;
+    }
+    gpu.err = setKernelArg(kernels->matVecTransposedFKernel, 0, sizeof(cl_mem), &m);
+    gpu.err = setKernelArg(kernels->matVecTransposedFKernel, 1, sizeof(cl_mem), &v);
+    gpu.err = setKernelArg(kernels->matVecTransposedFKernel, 2, sizeof(cl_mem), &partials);
+    gpu.err = setKernelArg(kernels->matVecTransposedFKernel, 3, sizeof(const unsigned int), &r);
+    gpu.err = setKernelArg(kernels->matVecTransposedFKernel, 4, sizeof(const unsigned int), &c);
+    gpu.err = setKernelArg(kernels->matVecTransposedFKernel, 5, sizeof(const unsigned int), &chunk);
+    gpu.err = setKernelArg(kernels->matVecTransposedFKernel, 6, sizeof(const unsigned int), &stride_m);
+    gpu.err = setKernelArg(kernels->matVecTransposedFKernel, 7, sizeof(const unsigned int), &stride_v);
+    gpu.err = setKernelArg(kernels->matVecTransposedFKernel, 8, sizeof(const unsigned int), &stride_partials);
+    gpu.err = setKernelArg(kernels->matVecTransposedFKernel, 9, sizeof(const unsigned int), &ld);
+    const size_t local_work_size[3] = {gpu.maxWorkGroupSize < 64 ? gpu.maxWorkGroupSize : 64, 1, 1};
+    const size_t global_work_size[3] = {(r + local_work_size[0] - 1) / local_work_size[0] * local_work_size[0], splits, batch};
+    if (splits == 1)
+    {
+        enqueueKernel(kernels->matVecTransposedFKernel, 3, global_work_size, local_work_size, num_events, wait_list, event);
+        return;
+    }
+    enqueueKernel(kernels->matVecTransposedFKernel, 3, global_work_size, local_work_size, num_events, wait_list, NULL);
+    gpu.err = setKernelArg(kernels->matVecSumFKernel, 0, sizeof(cl_mem), &partials);
+    gpu.err = setKernelArg(kernels->matVecSumFKernel, 1, sizeof(cl_mem), &out);
+    gpu.err = setKernelArg(kernels->matVecSumFKernel, 2, sizeof(const unsigned int), &r);
+    gpu.err = setKernelArg(kernels->matVecSumFKernel, 3, sizeof(const unsigned int), &splits);
+    gpu.err = setKernelArg(kernels->matVecSumFKernel, 4, sizeof(const unsigned int), &stride_partials);
+    gpu.err = setKernelArg(kernels->matVecSumFKernel, 5, sizeof(const unsigned int), &stride_out);
+    const size_t sumLocalSize[2] = {32, 1};
+    const size_t sumGlobalSize[2] = {(r + sumLocalSize[0] - 1) / sumLocalSize[0] * sumLocalSize[0], batch};
+    enqueueKernel(kernels->matVecSumFKernel, 2, sumGlobalSize, sumLocalSize, 0, NULL, event);
+    releaseBuffer(partials);
+}
+/*!
+    @brief Enqueues the matrix vector kernels on buffers that are already on the GPU
+
+    @details
+    Every row is split into chunks and every chunk is summed by its own work group with a tree reduction in local memory, so c is not limited by the work group size.
+    When a row is split into more than one chunk the partial sums of the chunks go to a temporary buffer and a second kernel adds them into out.
+    The amount of chunks is picked so that there are at least 4 work groups for every compute unit without giving any work item less than 4 columns, and the work groups are at most the tuned size.
+    The third dimension of the NDRange runs over the batch, and 4 by 4 matrices have their own kernel which does a whole product per work item.
+    ld is the amount of elements between the starts of two rows of m as it is stored, and a transposed m goes to enqueueMatVecTransposed().
+*/
+static void enqueueMatVecStrided(const Kernels *kernels, const Transpose trans, cl_mem m, const unsigned int ld, cl_mem v, cl_mem out, const unsigned int r, const unsigned int c, const unsigned int batch, const unsigned int stride_m, const unsigned int stride_v, const unsigned int stride_out, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (trans == TRANSPOSE)
+    {
+        enqueueMatVecTransposed(kernels, m, ld, v, out, r, c, batch, stride_m, stride_v, stride_out, num_events, wait_list, event);
+        return;
+    }
+    if (r == 4 && c == 4 && ld == 4)
+    {
+        gpu.err = setKernelArg(kernels->matVec4x4FKernel, 0, sizeof(cl_mem), &m);
+        gpu.err = setKernelArg(kernels->matVec4x4FKernel, 1, sizeof(cl_mem), &v);
+        gpu.err = setKernelArg(kernels->matVec4x4FKernel, 2, sizeof(cl_mem), &out);
+        gpu.err = setKernelArg(kernels->matVec4x4FKernel, 3, sizeof(const unsigned int), &batch);
+        gpu.err = setKernelArg(kernels->matVec4x4FKernel, 4, sizeof(const unsigned int), &stride_m);
+        gpu.err = setKernelArg(kernels->matVec4x4FKernel, 5, sizeof(const unsigned int), &stride_v);
+        gpu.err = setKernelArg(kernels->matVec4x4FKernel, 6, sizeof(const unsigned int), &stride_out);
+        const size_t local_work_size[1] = {64};
+        const size_t global_work_size[1] = {(batch + local_work_size[0] - 1) / local_work_size[0] * local_work_size[0]};
+        enqueueKernel(kernels->matVec4x4FKernel, 1, global_work_size, local_work_size, num_events, wait_list, event);
+        return;
+    }
+    size_t localSize = 1;
+    while (localSize * 2 <= gpu.maxWorkGroupSize && localSize * 2 <= gpu.tune.matVecGroup[sizeClass((double)r * c * batch)] && localSize < c)
+    {
+        localSize *= 2;
+    }
+    const unsigned int max_splits = (c + localSize * 4 - 1) / (localSize * 4);
+    const unsigned int rows = r * batch;
+    unsigned int splits = (gpu.computeUnits * 4 + rows - 1) / rows;
+    if (splits > max_splits)
+    {
+        splits = max_splits;
+    }
+    if (splits < 1)
+    {
+        splits = 1;
+    }
+    const unsigned int chunk = (c + splits - 1) / splits;
+    cl_mem partials = out;
+    unsigned int stride_partials = stride_out;
+    if (splits > 1)
+    {
+        partials = acquireBuffer(kernels->elementSize * rows * splits);
+        stride_partials = r * splits;
+    }
+    gpu.err = setKernelArg(kernels->matVecFkernel, 0, sizeof(cl_mem), &m);
+    gpu.err = setKernelArg(kernels->matVecFkernel, 1, sizeof(cl_mem), &v);
+    gpu.err = setKernelArg(kernels->matVecFkernel, 2, sizeof(cl_mem), &partials);
+    gpu.err = setKernelArg(kernels->matVecFkernel, 3, kernels->accumulatorSize * localSize, NULL);
+    gpu.err = setKernelArg(kernels->matVecFkernel, 4, sizeof(const unsigned int), &r);
+    gpu.err = setKernelArg(kernels->matVecFkernel, 5, sizeof(const unsigned int), &c);
+    gpu.err = setKernelArg(kernels->matVecFkernel, 6, sizeof(const unsigned int), &chunk);
+    gpu.err = setKernelArg(kernels->matVecFkernel, 7, sizeof(const unsigned int), &stride_m);
+    gpu.err = setKernelArg(kernels->matVecFkernel, 8, sizeof(const unsigned int), &stride_v);
+    gpu.err = setKernelArg(kernels->matVecFkernel, 9, sizeof(const unsigned int), &stride_partials);
+    gpu.err = setKernelArg(kernels->matVecFkernel, 10, sizeof(const unsigned int), &ld);
+    const size_t global_work_size[3] = {localSize * splits, r, batch};
+    const size_t local_work_size[3] = {localSize, 1, 1};
+    if (splits == 1)
+    {
+        enqueueKernel(kernels->matVecFkernel, 3, global_work_size, local_work_size, num_events, wait_list, event);
+        return;
+    }
+    enqueueKernel(kernels->matVecFkernel, 3, global_work_size, local_work_size, num_events, wait_list, NULL);
+    gpu.err = setKernelArg(kernels->matVecSumFKernel, 0, sizeof(cl_mem), &partials);
+    gpu.err = setKernelArg(kernels->matVecSumFKernel, 1, sizeof(cl_mem), &out);
+    gpu.err = setKernelArg(kernels->matVecSumFKernel, 2, sizeof(const unsigned int), &r);
+    gpu.err = setKernelArg(kernels->matVecSumFKernel, 3, sizeof(const unsigned int), &splits);
+    gpu.err = setKernelArg(kernels->matVecSumFKernel, 4, sizeof(const unsigned int), &stride_partials);
+    gpu.err = setKernelArg(kernels->matVecSumFKernel, 5, sizeof(const unsigned int), &stride_out);
+    const size_t sumLocalSize[2] = {32, 1};
+    const size_t sumGlobalSize[2] = {(r + sumLocalSize[0] - 1) / sumLocalSize[0] * sumLocalSize[0], batch};
+    enqueueKernel(kernels->matVecSumFKernel, 2, sumGlobalSize, sumLocalSize, 0, NULL, event);
+    releaseBuffer(partials);
+}
+/*!
+    @brief Enqueues the matrix vector kernels on a dense matrix that is not transposed, see enqueueMatVecStrided()
+*/
+static void enqueueMatVec(const Kernels *kernels, cl_mem m, cl_mem v, cl_mem out, const unsigned int r, const unsigned int c, const unsigned int batch, const unsigned int stride_m, const unsigned int stride_v, const unsigned int stride_out, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    enqueueMatVecStrided(kernels, NO_TRANSPOSE, m, c, v, out, r, c, batch, stride_m, stride_v, stride_out, num_events, wait_list, event);
+}
+/*!
+    @brief Enqueues the product of an r row sparse matrix with nnz nonzeros and a vector
+
+    @details
+    Every row gets the smallest power of two work items that is at least its average number of nonzeros, up to CSR_MAX_LANES, so short rows do not leave most of a work group idle and long rows are still split.
+    The work items of a row add up their sums in local memory like the dense matrix vector product.
+*/
+static void enqueueCsrMatVec(const Kernels *kernels, cl_mem row_ptr, cl_mem cols, cl_mem values, cl_mem v, cl_mem out, const unsigned int r, const unsigned int nnz, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (r == 0)
+    {
+        gpu.err = clEnqueueMarkerWithWaitList(gpu.queue, num_events, wait_list, event);
+        return;
+    }
+    size_t localSize = tunedGroup(gpu.tune.elementwiseGroup, nnz);
+    cl_uint lanes = 1;
+    while (lanes < CSR_MAX_LANES && lanes * 2 <= localSize && lanes * (double)r < nnz)
+    {
+        lanes *= 2;
+    }
+    localSize = localSize / lanes * lanes;
+    const size_t globalSize = ((size_t)r * lanes + localSize - 1) / localSize * localSize;
+    gpu.err = setKernelArg(kernels->csrMatVecFKernel, 0, sizeof(cl_mem), &row_ptr);
+    gpu.err = setKernelArg(kernels->csrMatVecFKernel, 1, sizeof(cl_mem), &cols);
+    gpu.err = setKernelArg(kernels->csrMatVecFKernel, 2, sizeof(cl_mem), &values);
+    gpu.err = setKernelArg(kernels->csrMatVecFKernel, 3, sizeof(cl_mem), &v);
+    gpu.err = setKernelArg(kernels->csrMatVecFKernel, 4, sizeof(cl_mem), &out);
+    gpu.err = setKernelArg(kernels->csrMatVecFKernel, 5, kernels->accumulatorSize * localSize, NULL);
+    gpu.err = setKernelArg(kernels->csrMatVecFKernel, 6, sizeof(const unsigned int), &r);
+    gpu.err = setKernelArg(kernels->csrMatVecFKernel, 7, sizeof(cl_uint), &lanes);
+    enqueueKernel(kernels->csrMatVecFKernel, 1, &globalSize, &localSize, num_events, wait_list, event);
+}
+/*!
+    @brief Enqueues the dot product of an r row sparse matrix and a dense matrix with c2 columns, every work item calculates one element of the result
+*/
+static void enqueueCsrDotMatrices(const Kernels *kernels, cl_mem row_ptr, cl_mem cols, cl_mem values, cl_mem s2, cl_mem s3, const unsigned int r, const unsigned int c2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (r == 0 || c2 == 0)
+    {
+        gpu.err = clEnqueueMarkerWithWaitList(gpu.queue, num_events, wait_list, event);
+        return;
+    }
+    gpu.err = setKernelArg(kernels->csrDotFKernel, 0, sizeof(cl_mem), &row_ptr);
+    gpu.err = setKernelArg(kernels->csrDotFKernel, 1, sizeof(cl_mem), &cols);
+    gpu.err = setKernelArg(kernels->csrDotFKernel, 2, sizeof(cl_mem), &values);
+    gpu.err = setKernelArg(kernels->csrDotFKernel, 3, sizeof(cl_mem), &s2);
+    gpu.err = setKernelArg(kernels->csrDotFKernel, 4, sizeof(cl_mem), &s3);
+    gpu.err = setKernelArg(kernels->csrDotFKernel, 5, sizeof(const unsigned int), &c2);
+    const size_t localSize[2] = {tunedGroup(gpu.tune.elementwiseGroup, (double)r * c2), 1};
+    const size_t globalSize[2] = {(c2 + localSize[0] - 1) / localSize[0] * localSize[0], r};
+    enqueueKernel(kernels->csrDotFKernel, 2, globalSize, localSize, num_events, wait_list, event);
+}
+/*!
+    @brief Gives a buffer with the elements of a host shape, wrapping the host memory if possible and otherwise copying it into a buffer from the pool
+*/
+static cl_mem uploadBuffer(const void *s, const size_t size, cl_uint num_events, const cl_event *wait_list)
+{
+    if (canWrapHostPtr(s, size))
+    {
+        cl_mem buffer = createBuffer(CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, size, (void *)s);
+        if (gpu.err == CL_SUCCESS)
+        {
+            if (num_events > 0)
+            {
+                gpu.err = clEnqueueBarrierWithWaitList(gpu.queue, num_events, wait_list, NULL);
+            }
+            return buffer;
+        }
+    }
+    cl_mem buffer = acquireBuffer(size);
+    enqueueWrite(gpu.queue, buffer, size, s, num_events, wait_list, NULL);
+    return buffer;
+}
+/*!
+    @brief Checks if a buffer wraps host memory that overlaps size bytes at s
+*/
+static int wrapsHostRange(cl_mem buffer, const void *s, const size_t size)
+{
+    if (!isWrappedBuffer(buffer))
+    {
+        return 0;
+    }
+    void *host = NULL;
+    size_t host_size = 0;
+    clGetMemObjectInfo(buffer, CL_MEM_HOST_PTR, sizeof(void *), &host, NULL);
+    clGetMemObjectInfo(buffer, CL_MEM_SIZE, sizeof(size_t), &host_size, NULL);
+    return (const char *)host < (const char *)s + size && (const char *)s < (const char *)host + host_size;
+}
+/*!
+    @brief Gives a buffer for a kernel to write a result to, wrapping the host memory it will be downloaded to if possible
+
+    @details
+    The host memory is not wrapped when it overlaps memory one of the num_inputs buffers from uploadBuffer() wraps, because two buffers using the same host memory are undefined.
+    Calls writing their result over an input, like addShapesF(a, b, a), then get a buffer from the pool that downloadBuffer() copies back.
+*/
+static cl_mem outputBuffer(void *s, const size_t size, cl_uint num_inputs, const cl_mem *inputs)
+{
+    int overlaps = 0;
+    for (cl_uint i = 0; i < num_inputs && !overlaps; i++)
+    {
+        overlaps = wrapsHostRange(inputs[i], s, size);
+    }
+    if (!overlaps && canWrapHostPtr(s, size))
+    {
+        cl_mem buffer = createBuffer(CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR, size, s);
+        if (gpu.err == CL_SUCCESS)
+        {
+            return buffer;
+        }
+    }
+    return acquireBuffer(size);
+}
+/*!
+    @brief Makes the result in a buffer from outputBuffer() visible in the host shape
+
+    @details
+    Wrapped buffers only need to be mapped and unmapped for the host memory to be up to date, other buffers are copied.
+*/
+static void downloadBuffer(cl_mem buffer, void *s, const size_t size, cl_event *event)
+{
+    if (isWrappedBuffer(buffer))
+    {
+        void *mapped = clEnqueueMapBuffer(gpu.queue, buffer, CL_FALSE, CL_MAP_READ, 0, size, 0, NULL, NULL, &gpu.err);
+        gpu.err = clEnqueueUnmapMemObject(gpu.queue, buffer, mapped, 0, NULL, profileEvent(event));
+        profileCommand(PROFILE_DOWNLOAD, NULL, 0, event);
+        return;
+    }
+    enqueueRead(gpu.queue, buffer, CL_FALSE, size, s, 0, NULL, event);
+}
+/*!
+    @brief Checks that the GPU could build the kernels of a precision, see gpuSupportsDouble() and gpuSupportsHalf()
+
+    @returns 1 if it could, otherwise 0 and the operation fails with CL_INVALID_OPERATION
+*/
+static int checkPrecision(const Kernels *kernels, cl_event *event)
+{
+    if (kernels->dotFKernel == NULL)
+    {
+        failCommand(CL_INVALID_OPERATION, event);
+        return 0;
+    }
+    return 1;
+}
+/*!
+    @brief Gives the kernel of an elementwise operation
+*/
+static cl_kernel shapeKernel(const Kernels *kernels, const ShapeOp op)
+{
+    switch (op)
+    {
+    case SHAPE_SUBTRACT:
+        return kernels->subtractFKernel;
+    case SHAPE_CROSS:
+        return kernels->crossFKernel;
+    case SHAPE_DIVIDE:
+        return kernels->divideFKernel;
+    default:
+        return kernels->addFKernel;
+    }
+}
+/*!
+    @brief Gives the directory where built kernels are cached
+
+    @details
+    This is LINEARALGEBRA_CACHE_DIR if it is set, otherwise the temporary directory of the system, otherwise the working directory.
+*/
+static const char *cacheDirectory()
+{
+    const char *names[4] = {"LINEARALGEBRA_CACHE_DIR", "TMPDIR", "TEMP", "TMP"};
+    for (int i = 0; i < 4; i++)
+    {
+        const char *dir = getenv(names[i]);
+        if (dir != NULL && dir[0] != '\0')
+        {
+            return dir;
+        }
+    }
+    return ".";
+}
+/*!
+    @brief Adds a string to a 64 bit FNV-1a hash
+*/
+static uint64_t hashString(uint64_t hash, const char *s)
+{
+    for (; *s != '\0'; s++)
+    {
+        hash ^= (unsigned char)*s;
+        hash *= 1099511628211ULL;
+    }
+    /* Hash the terminator too so "ab" + "c" and "a" + "bc" are different keys */
+    hash ^= 0xff;
+    return hash * 1099511628211ULL;
+}
+/*!
+    @brief Makes the cache key of a program from the device, the driver version, the build options and the source
+*/
+static uint64_t programKey(const char *source, const char *options)
+{
+    char info[1024];
+    uint64_t hash = 14695981039346656037ULL;
+    const cl_device_info device_infos[3] = {CL_DEVICE_NAME, CL_DEVICE_VERSION, CL_DRIVER_VERSION};
+    for (int i = 0; i < 3; i++)
+    {
+        info[0] = '\0';
+        clGetDeviceInfo(gpu.device, device_infos[i], sizeof(info), info, NULL);
+        info[sizeof(info) - 1] = '\0';
+        hash = hashString(hash, info);
+    }
+    info[0] = '\0';
+    clGetPlatformInfo(gpu.platform, CL_PLATFORM_VERSION, sizeof(info), info, NULL);
+    info[sizeof(info) - 1] = '\0';
+    hash = hashString(hash, info);
+    hash = hashString(hash, options);
+    return hashString(hash, source);
+}
+/*!
+    @brief Gives a wall clock time in seconds for timing the calibration
+*/
+static double now()
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+/*!
+    @brief Gives the names and fields of the cost model in the order they are saved in
+*/
+static unsigned int costFields(CostModel *model, const char **names, double **fields)
+{
+    const char *field_names[COST_MODEL_FIELDS] = {"launchLatency", "uploadLatency", "uploadBandwidth", "downloadLatency", "downloadBandwidth", "gpuElementwiseRate", "gpuDotRate", "gpuMatVecRate", "cpuElementwiseRate", "cpuDotRate", "cpuMatVecRate"};
+    double *field_values[COST_MODEL_FIELDS] = {&model->launchLatency, &model->uploadLatency, &model->uploadBandwidth, &model->downloadLatency, &model->downloadBandwidth, &model->gpuElementwiseRate, &model->gpuDotRate, &model->gpuMatVecRate, &model->cpuElementwiseRate, &model->cpuDotRate, &model->cpuMatVecRate};
+    for (unsigned int i = 0; i < COST_MODEL_FIELDS; i++)
+    {
+        names[i] = field_names[i];
+        fields[i] = field_values[i];
+    }
+    return COST_MODEL_FIELDS;
+}
+/*!
+    @brief Gives the path of the saved cost model, which is keyed by the device, the driver, the tuned kernels and the number of CPU threads like the kernel cache
+*/
+static void costModelPath(char *path, const size_t size)
+{
+    char tuned[128];
+    char options[192];
+    tuneOptions(&gpu.tune, tuned, sizeof(tuned));
+    snprintf(options, sizeof(options), "cpu threads %u %s", cpuThreads(), tuned);
+    const uint64_t key = programKey("cost model", options);
+    snprintf(path, size, "%s/linearalgebra-%016llx.costs", cacheDirectory(), (unsigned long long)key);
+}
+/*!
+    @brief Tries to read a saved cost model
+
+    @returns 1 if every field was read and is positive, otherwise 0
+*/
+static int loadCostModel(CostModel *model)
+{
+    char path[1024];
+    costModelPath(path, sizeof(path));
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return 0;
+    }
+    const char *names[COST_MODEL_FIELDS];
+    double *fields[COST_MODEL_FIELDS];
+    const unsigned int count = costFields(model, names, fields);
+    unsigned int found = 0;
+    char name[64];
+    double value;
+    while (fscanf(file, "%63s %lf", name, &value) == 2)
+    {
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (strcmp(name, names[i]) == 0 && value > 0)
+            {
+                *fields[i] = value;
+                found |= 1u << i;
+            }
+        }
+    }
+    fclose(file);
+    return found == (1u << count) - 1;
+}
+static void saveCostModel(CostModel *model)
+{
+    char path[1024];
+    costModelPath(path, sizeof(path));
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        return;
+    }
+    const char *names[COST_MODEL_FIELDS];
+    double *fields[COST_MODEL_FIELDS];
+    const unsigned int count = costFields(model, names, fields);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        fprintf(file, "%s %.9g\n", names[i], *fields[i]);
+    }
+    fclose(file);
+}
+/*!
+    @brief Gives the shortest time out of a few runs of a blocking copy
+*/
+static double timeCopy(const int upload, cl_mem buffer, float *host, const size_t size)
+{
+    double best = 1e30;
+    for (int i = 0; i < CALIBRATION_RUNS; i++)
+    {
+        const double start = now();
+        if (upload)
+        {
+            gpu.err = clEnqueueWriteBuffer(gpu.queue, buffer, CL_TRUE, 0, size, host, 0, NULL, NULL);
+        }
+        else
+        {
+            gpu.err = clEnqueueReadBuffer(gpu.queue, buffer, CL_TRUE, 0, size, host, 0, NULL, NULL);
+        }
+        const double time = now() - start;
+        best = time < best ? time : best;
+    }
+    return best;
+}
+/*!
+    @brief Measures the speed of the GPU and the CPU backend for the cost model
+
+    @details
+    Copies are timed at two sizes so their fixed cost and their bandwidth can be told apart, and the kernels are timed on a single element to get the launch latency.
+    Every measurement is the fastest out of CALIBRATION_RUNS runs so a one off stall does not skew the model.
+*/
+static void calibrateCosts(CostModel *model)
+{
+    const int profiling = gpu.profiler.enabled;
+    gpu.profiler.enabled = 0;
+    const size_t n = CALIBRATION_ELEMENTS;
+    const size_t size = sizeof(float) * n;
+    float *host1 = malloc(size);
+    float *host2 = malloc(size);
+    float *host3 = malloc(size);
+    for (size_t i = 0; i < n; i++)
+    {
+        host1[i] = 1.0f;
+        host2[i] = 2.0f;
+    }
+    cl_mem buffer1 = acquireBuffer(size);
+    cl_mem buffer2 = acquireBuffer(size);
+    cl_mem buffer3 = acquireBuffer(size);
+    gpu.err = clFinish(gpu.queue);
+
+    const size_t small = 4096;
+    double small_time = timeCopy(1, buffer1, host1, small);
+    double large_time = timeCopy(1, buffer1, host1, size);
+    model->uploadLatency = small_time;
+    model->uploadBandwidth = (size - small) / (large_time > small_time ? large_time - small_time : 1e-9);
+    timeCopy(1, buffer2, host2, size);
+    small_time = timeCopy(0, buffer3, host3, small);
+    large_time = timeCopy(0, buffer3, host3, size);
+    model->downloadLatency = small_time;
+    model->downloadBandwidth = (size - small) / (large_time > small_time ? large_time - small_time : 1e-9);
+
+    /* Timing a kernel on one element leaves only the cost of launching it and waiting for it */
+    double times[4] = {1e30, 1e30, 1e30, 1e30};
+    const unsigned int dot_size = CALIBRATION_DOT_SIZE;
+    const unsigned int matvec_rows = (unsigned int)(n / CALIBRATION_MATVEC_COLUMNS);
+    for (int i = 0; i < CALIBRATION_RUNS; i++)
+    {
+        double start = now();
+        enqueueShapesF(&gpu.kernels, gpu.kernels.addFKernel, buffer1, buffer2, buffer3, 1, 0, NULL, NULL);
+        gpu.err = clFinish(gpu.queue);
+        double time = now() - start;
+        times[0] = time < times[0] ? time : times[0];
+        start = now();
+        enqueueShapesF(&gpu.kernels, gpu.kernels.addFKernel, buffer1, buffer2, buffer3, (unsigned int)n, 0, NULL, NULL);
+        gpu.err = clFinish(gpu.queue);
+        time = now() - start;
+        times[1] = time < times[1] ? time : times[1];
+        start = now();
+        enqueueDotMatrices(&gpu.kernels, buffer1, buffer2, buffer3, dot_size, dot_size, dot_size, 1, 0, 0, 0, NULL, 0, NULL, NULL);
+        gpu.err = clFinish(gpu.queue);
+        time = now() - start;
+        times[2] = time < times[2] ? time : times[2];
+        start = now();
+        enqueueMatVec(&gpu.kernels, buffer1, buffer2, buffer3, matvec_rows, CALIBRATION_MATVEC_COLUMNS, 1, 0, 0, 0, 0, NULL, NULL);
+        gpu.err = clFinish(gpu.queue);
+        time = now() - start;
+        times[3] = time < times[3] ? time : times[3];
+    }
+    model->launchLatency = times[0];
+    const double dot_work = (double)dot_size * dot_size * dot_size;
+    model->gpuElementwiseRate = n / (times[1] > times[0] ? times[1] - times[0] : 1e-9);
+    model->gpuDotRate = dot_work / (times[2] > times[0] ? times[2] - times[0] : 1e-9);
+    model->gpuMatVecRate = (double)matvec_rows * CALIBRATION_MATVEC_COLUMNS / (times[3] > times[0] ? times[3] - times[0] : 1e-9);
+
+    for (int i = 0; i < 3; i++)
+    {
+        times[i] = 1e30;
+    }
+    for (int i = 0; i < CALIBRATION_RUNS; i++)
+    {
+        double start = now();
+        cpuShapesF(SHAPE_ADD, host1, host2, host3, n);
+        double time = now() - start;
+        times[0] = time < times[0] ? time : times[0];
+        start = now();
+        cpuDotMatricesF(host1, host2, host3, dot_size, dot_size, dot_size);
+        time = now() - start;
+        times[1] = time < times[1] ? time : times[1];
+        start = now();
+        cpuMatVecF(host1, host2, host3, matvec_rows, CALIBRATION_MATVEC_COLUMNS);
+        time = now() - start;
+        times[2] = time < times[2] ? time : times[2];
+    }
+    model->cpuElementwiseRate = n / (times[0] > 0 ? times[0] : 1e-9);
+    model->cpuDotRate = dot_work / (times[1] > 0 ? times[1] : 1e-9);
+    model->cpuMatVecRate = (double)matvec_rows * CALIBRATION_MATVEC_COLUMNS / (times[2] > 0 ? times[2] : 1e-9);
+
+    releaseBuffer(buffer1);
+    releaseBuffer(buffer2);
+    releaseBuffer(buffer3);
+    free(host1);
+    free(host2);
+    free(host3);
+    gpu.profiler.enabled = profiling;
+}
+void calibrateDispatch()
+{
+    if (recordingHostOp(NULL))
+    {
+        return;
+    }
+    if (!gpu.hasDevice)
+    {
+        return;
+    }
+    calibrateCosts(&gpu.costs);
+    gpu.costs.calibrated = 1;
+    saveCostModel(&gpu.costs);
+}
+void getCostModel(CostModel *model)
+{
+    if (gpu.hasDevice && !gpu.costs.calibrated)
+    {
+        gpu.costs.calibrated = loadCostModel(&gpu.costs);
+        if (!gpu.costs.calibrated)
+        {
+            calibrateDispatch();
+        }
+    }
+    *model = gpu.costs;
+}
+void setDispatchMode(const DispatchMode mode)
+{
+    gpu.dispatchMode = mode;
+}
+/*!
+    @brief Gives the bytes that would have to be copied for a host shape to be used on the GPU, which is none if the GPU can use its memory directly
+*/
+static double copiedBytes(const void *s, const size_t size)
+{
+    return canWrapHostPtr(s, size) ? 0 : (double)size;
+}
+/*!
+    @brief Checks if a float operation should run on the CPU backend
+
+    @details
+    Without a GPU everything runs on the CPU.
+    Otherwise the cost model, which is loaded or calibrated the first time it is needed, estimates the time on the GPU as the launch latency, the copies and the work at the GPU's rate and compares that to the work at the CPU's rate.
+    Inputs the GPU can use without a copy add no transfer time, so operands on unified memory tip operations towards the GPU.
+
+    @param kernels Only floats have a CPU backend
+    @param gpu_rate Work the GPU does per second
+    @param cpu_rate Work the CPU does per second
+    @param work Amount of work in the same units as the rates
+    @param uploads Number of shapes copied to the GPU
+    @param upload_bytes Bytes copied to the GPU
+    @param download_bytes Bytes copied back
+*/
+static int useCpu(const Kernels *kernels, const double *gpu_rate, const double *cpu_rate, const double work, const unsigned int uploads, const double upload_bytes, const double download_bytes)
+{
+    if (kernels != &gpu.kernels)
+    {
+        return 0;
+    }
+    if (!gpu.hasDevice || gpu.dispatchMode == DISPATCH_CPU)
+    {
+        return 1;
+    }
+    if (gpu.dispatchMode == DISPATCH_GPU)
+    {
+        return 0;
+    }
+    if (!gpu.costs.calibrated)
+    {
+        CostModel model;
+        getCostModel(&model);
+    }
+    const CostModel *m = &gpu.costs;
+    const double gpu_time = m->launchLatency + uploads * m->uploadLatency + upload_bytes / m->uploadBandwidth +
+                            (download_bytes > 0 ? m->downloadLatency + download_bytes / m->downloadBandwidth : 0) + work / *gpu_rate;
+    return work / *cpu_rate < gpu_time;
+}
+/*!
+    @brief Waits for the events an operation running on the CPU depends on
+*/
+static void cpuWaitEvents(cl_uint num_events, const cl_event *wait_list)
+{
+    if (num_events > 0)
+    {
+        gpu.err = clWaitForEvents(num_events, wait_list);
+    }
+}
+/*!
+    @brief Gives the caller of an asynchronous operation that ran on the CPU an event that has already completed, or NULL if there is no GPU to make events with
+*/
+static void cpuCompleteEvent(cl_event *event)
+{
+    if (event == NULL)
+    {
+        return;
+    }
+    if (!gpu.hasDevice)
+    {
+        *event = NULL;
+        return;
+    }
+    *event = clCreateUserEvent(gpu.context, &gpu.err);
+    gpu.err = clSetUserEventStatus(*event, CL_COMPLETE);
+}
+/*!
+    @brief Gives the amount of elements from the first to the last element of a rows by cols block whose rows start ld elements apart
+*/
+static size_t viewSpan(const unsigned int rows, const unsigned int cols, const unsigned int ld)
+{
+    return rows > 0 ? (size_t)(rows - 1) * ld + cols : 0;
+}
+/*!
+    @brief Gives a buffer with a rows by cols block of host floats whose rows start ld elements apart, and sets buffer_ld to the elements between the rows in the buffer
+
+    @details
+    Blocks whose rows follow each other are used like any other host shape, and so are blocks with gaps that can be wrapped because the kernels skip the gaps.
+    Other blocks are copied into a dense buffer without their gaps, so a small view of a big matrix only copies the view.
+*/
+static cl_mem uploadView(const float *s, const unsigned int rows, const unsigned int cols, const unsigned int ld, unsigned int *buffer_ld, cl_uint num_events, const cl_event *wait_list)
+{
+    const size_t span = sizeof(float) * viewSpan(rows, cols, ld);
+    if (ld == cols || canWrapHostPtr(s, span))
+    {
+        *buffer_ld = ld;
+        return uploadBuffer(s, span, num_events, wait_list);
+    }
+    *buffer_ld = cols;
+    cl_mem buffer = acquireBuffer(sizeof(float) * rows * cols);
+    enqueueWriteRect(gpu.queue, buffer, rows, cols, ld, s, num_events, wait_list, NULL);
+    return buffer;
+}
+/*!
+    @brief Gives a buffer for a rows by cols block of host floats whose rows start ld elements apart that a kernel will write, and sets buffer_ld to the elements between the rows in the buffer
+
+    @details
+    The block is copied into the buffer first when read is not 0, and then the buffer is never a wrapped one because a kernel reading and writing host memory through two buffers is undefined.
+    Blocks with gaps always get a dense buffer so downloadView() never writes over the gaps.
+*/
+static cl_mem outputView(float *s, const unsigned int rows, const unsigned int cols, const unsigned int ld, const int read, unsigned int *buffer_ld)
+{
+    *buffer_ld = cols;
+    if (ld == cols && !read)
+    {
+        return outputBuffer(s, sizeof(float) * rows * cols, 0, NULL);
+    }
+    cl_mem buffer = acquireBuffer(sizeof(float) * rows * cols);
+    if (read)
+    {
+        enqueueWriteRect(gpu.queue, buffer, rows, cols, ld, s, 0, NULL, NULL);
+    }
+    return buffer;
+}
+/*!
+    @brief Copies a buffer from outputView() back into its block of host memory
+*/
+static void downloadView(cl_mem buffer, float *s, const unsigned int rows, const unsigned int cols, const unsigned int ld, cl_event *event)
+{
+    if (ld == cols)
+    {
+        downloadBuffer(buffer, s, sizeof(float) * rows * cols, event);
+        return;
+    }
+    enqueueReadRect(gpu.queue, buffer, rows, cols, ld, s, 0, NULL, event);
+}
+/*!
+    @brief Gives the bytes of a rows by cols block of host floats whose rows start ld elements apart that uploadView() copies
+*/
+static double copiedViewBytes(const float *s, const unsigned int rows, const unsigned int cols, const unsigned int ld)
+{
+    return canWrapHostPtr(s, sizeof(float) * viewSpan(rows, cols, ld)) ? 0 : sizeof(float) * (double)rows * cols;
+}
+/*!
+    @brief Copies two host shapes to the GPU, runs one of the elementwise kernels on them and copies the result back without waiting for any of it
+*/
+static void shapesAsync(const char *op, const Kernels *kernels, const ShapeOp shape_op, const void *s1, const void *s2, void *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (recordingHostOp(event))
+    {
+        return;
+    }
+    const size_t bytes = sizeof(float) * r * c;
+    if (useCpu(kernels, &gpu.costs.gpuElementwiseRate, &gpu.costs.cpuElementwiseRate, (double)r * c, 2, copiedBytes(s1, bytes) + copiedBytes(s2, bytes), copiedBytes(s3, bytes)))
+    {
+        cpuWaitEvents(num_events, wait_list);
+        cpuShapesF(shape_op, s1, s2, s3, (size_t)r * c);
+        cpuCompleteEvent(event);
+        return;
+    }
+    if (!checkPrecision(kernels, event))
+    {
+        return;
+    }
+    cl_kernel kernel = shapeKernel(kernels, shape_op);
+    profileOp(op, r, c);
+    const unsigned int vals = r * c;
+    const size_t size = kernels->elementSize * vals;
+    /* The queue is in order so only the first command needs to wait for the caller's events */
+    cl_mem buffer1 = uploadBuffer(s1, size, num_events, wait_list);
+    cl_mem buffer2 = uploadBuffer(s2, size, 0, NULL);
+    const cl_mem inputs[2] = {buffer1, buffer2};
+    cl_mem buffer3 = outputBuffer(s3, size, 2, inputs);
+    enqueueShapesF(kernels, kernel, buffer1, buffer2, buffer3, vals, 0, NULL, NULL);
+    downloadBuffer(buffer3, s3, size, event);
+
+    /* The buffers are only deleted once the commands using them have finished */
+    releaseBuffer(buffer1);
+    releaseBuffer(buffer2);
+    releaseBuffer(buffer3);
+}
+/*!
+    @brief Copies a batch of pairs of host matrices to the GPU, multiplies them and copies the results back without waiting for any of it
+*/
+static void dotMatricesAsync(const char *op, const Kernels *kernels, const void *s1, const void *s2, void *s3, const unsigned int r, const unsigned int c, const unsigned int c2, const unsigned int batch, const unsigned int stride1, const unsigned int stride2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (recordingHostOp(event))
+    {
+        return;
+    }
+    const size_t bytes1 = sizeof(float) * ((size_t)(batch > 0 ? batch - 1 : 0) * stride1 + r * c);
+    const size_t bytes2 = sizeof(float) * ((size_t)(batch > 0 ? batch - 1 : 0) * stride2 + c * c2);
+    const size_t bytes3 = sizeof(float) * batch * r * c2;
+    if (useCpu(kernels, &gpu.costs.gpuDotRate, &gpu.costs.cpuDotRate, (double)batch * r * c * c2, 2, copiedBytes(s1, bytes1) + copiedBytes(s2, bytes2), copiedBytes(s3, bytes3)))
+    {
+        cpuWaitEvents(num_events, wait_list);
+        for (unsigned int i = 0; i < batch; i++)
+        {
+            cpuDotMatricesF((const float *)s1 + (size_t)i * stride1, (const float *)s2 + (size_t)i * stride2, (float *)s3 + (size_t)i * r * c2, r, c, c2);
+        }
+        cpuCompleteEvent(event);
+        return;
+    }
+    if (!checkPrecision(kernels, event))
+    {
+        return;
+    }
+    if (batch == 0)
+    {
+        gpu.err = clEnqueueMarkerWithWaitList(gpu.queue, num_events, wait_list, event);
+        return;
+    }
+    profileOp(op, batch * r, c2);
+    const size_t size1 = kernels->elementSize * ((size_t)(batch - 1) * stride1 + r * c);
+    const size_t size2 = kernels->elementSize * ((size_t)(batch - 1) * stride2 + c * c2);
+    const size_t size3 = kernels->elementSize * batch * r * c2;
+    cl_mem buffer1 = uploadBuffer(s1, size1, num_events, wait_list);
+    cl_mem buffer2 = uploadBuffer(s2, size2, 0, NULL);
+    cl_mem buffer3 = outputBuffer(s3, size3, 0, NULL);
+    enqueueDotMatrices(kernels, buffer1, buffer2, buffer3, r, c, c2, batch, stride1, stride2, r * c2, NULL, 0, NULL, NULL);
+    downloadBuffer(buffer3, s3, size3, event);
+
+    releaseBuffer(buffer1);
+    releaseBuffer(buffer2);
+    releaseBuffer(buffer3);
+}
+/*!
+    @brief Copies two host matrices to the GPU, multiplies them with an epilogue and copies the result back without waiting for any of it
+
+    @details
+    s1 and s2 are used as they are stored or transposed and can be blocks of bigger matrices, see uploadView().
+    s3 is only copied to the GPU when beta is not 0, see outputView().
+*/
+static void gemmAsync(const char *op, const Transpose trans1, const Transpose trans2, const float *s1, const unsigned int ld1, const float *s2, const unsigned int ld2, float *s3, const unsigned int ld3, const unsigned int r, const unsigned int c, const unsigned int c2, const float alpha, const float beta, const float *bias, const Activation activation, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (recordingHostOp(event))
+    {
+        return;
+    }
+    const unsigned int rows1 = trans1 == TRANSPOSE ? c : r;
+    const unsigned int cols1 = trans1 == TRANSPOSE ? r : c;
+    const unsigned int rows2 = trans2 == TRANSPOSE ? c2 : c;
+    const unsigned int cols2 = trans2 == TRANSPOSE ? c : c2;
+    const double bytes3 = sizeof(float) * (double)r * c2;
+    const unsigned int uploads = 2 + (beta != 0.0f) + (bias != NULL);
+    const double upload_bytes = copiedViewBytes(s1, rows1, cols1, ld1) + copiedViewBytes(s2, rows2, cols2, ld2) + (beta != 0.0f ? bytes3 : 0) + (bias != NULL ? copiedBytes(bias, sizeof(float) * c2) : 0);
+    if (useCpu(&gpu.kernels, &gpu.costs.gpuDotRate, &gpu.costs.cpuDotRate, (double)r * c * c2, uploads, upload_bytes, beta != 0.0f || ld3 != c2 ? bytes3 : copiedBytes(s3, (size_t)bytes3)))
+    {
+        cpuWaitEvents(num_events, wait_list);
+        cpuGemmF(trans1, trans2, s1, ld1, s2, ld2, s3, ld3, r, c, c2, alpha, beta, bias, activation);
+        cpuCompleteEvent(event);
+        return;
+    }
+    profileOp(op, r, c2);
+    unsigned int buffer_ld1, buffer_ld2, buffer_ld3;
+    cl_mem buffer1 = uploadView(s1, rows1, cols1, ld1, &buffer_ld1, num_events, wait_list);
+    cl_mem buffer2 = uploadView(s2, rows2, cols2, ld2, &buffer_ld2, 0, NULL);
+    cl_mem buffer3 = outputView(s3, r, c2, ld3, beta != 0.0f, &buffer_ld3);
+    const Epilogue epilogue = {alpha, beta, buffer3, bias != NULL ? uploadBuffer(bias, sizeof(float) * c2, 0, NULL) : NULL, activation};
+    const int identity = alpha == 1.0f && beta == 0.0f && bias == NULL && activation == ACTIVATION_NONE;
+    enqueueDotMatricesStrided(&gpu.kernels, trans1, trans2, buffer1, buffer_ld1, buffer2, buffer_ld2, buffer3, buffer_ld3, r, c, c2, 1, 0, 0, 0, identity ? NULL : &epilogue, 0, NULL, NULL);
+    downloadView(buffer3, s3, r, c2, ld3, event);
+
+    releaseBuffer(buffer1);
+    releaseBuffer(buffer2);
+    releaseBuffer(buffer3);
+    releaseBuffer(epilogue.bias);
+}
+/*!
+    @brief Copies a host matrix, used as it is stored or transposed, and a vector to the GPU, multiplies them and copies the result back without waiting for any of it
+
+    @details
+    The matrix can be a block of a bigger matrix with ld elements between the starts of its rows, see uploadView().
+*/
+static void matVecStridedAsync(const char *op, const Transpose trans, const float *m, const unsigned int ld, const float *v, float *out, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (recordingHostOp(event))
+    {
+        return;
+    }
+    const unsigned int rows = trans == TRANSPOSE ? c : r;
+    const unsigned int cols = trans == TRANSPOSE ? r : c;
+    if (useCpu(&gpu.kernels, &gpu.costs.gpuMatVecRate, &gpu.costs.cpuMatVecRate, (double)r * c, 2, copiedViewBytes(m, rows, cols, ld) + copiedBytes(v, sizeof(float) * c), copiedBytes(out, sizeof(float) * r)))
+    {
+        cpuWaitEvents(num_events, wait_list);
+        cpuMatVecStridedF(trans, m, ld, v, out, r, c);
+        cpuCompleteEvent(event);
+        return;
+    }
+    profileOp(op, r, c);
+    unsigned int buffer_ld;
+    cl_mem matrix = uploadView(m, rows, cols, ld, &buffer_ld, num_events, wait_list);
+    cl_mem vector = uploadBuffer(v, sizeof(float) * c, 0, NULL);
+    cl_mem result = outputBuffer(out, sizeof(float) * r, 0, NULL);
+    enqueueMatVecStrided(&gpu.kernels, trans, matrix, buffer_ld, vector, result, r, c, 1, 0, 0, 0, 0, NULL, NULL);
+    downloadBuffer(result, out, sizeof(float) * r, event);
+
+    releaseBuffer(matrix);
+    releaseBuffer(vector);
+    releaseBuffer(result);
+}
+/*!
+    @brief Copies a batch of host matrices and vectors to the GPU, multiplies them and copies the results back without waiting for any of it
+*/
+static void matVecAsync(const char *op, const Kernels *kernels, const void *m, const void *v, void *out, const unsigned int r, const unsigned int c, const unsigned int batch, const unsigned int stride_m, const unsigned int stride_v, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (recordingHostOp(event))
+    {
+        return;
+    }
+    const size_t matrix_bytes = sizeof(float) * ((size_t)(batch > 0 ? batch - 1 : 0) * stride_m + r * c);
+    const size_t vector_bytes = sizeof(float) * ((size_t)(batch > 0 ? batch - 1 : 0) * stride_v + c);
+    if (useCpu(kernels, &gpu.costs.gpuMatVecRate, &gpu.costs.cpuMatVecRate, (double)batch * r * c, 2, copiedBytes(m, matrix_bytes) + copiedBytes(v, vector_bytes), copiedBytes(out, sizeof(float) * batch * r)))
+    {
+        cpuWaitEvents(num_events, wait_list);
+        for (unsigned int i = 0; i < batch; i++)
+        {
+            cpuMatVecF((const float *)m + (size_t)i * stride_m, (const float *)v + (size_t)i * stride_v, (float *)out + (size_t)i * r, r, c);
+        }
+        cpuCompleteEvent(event);
+        return;
+    }
+    if (!checkPrecision(kernels, event))
+    {
+        return;
+    }
+    if (batch == 0)
+    {
+        gpu.err = clEnqueueMarkerWithWaitList(gpu.queue, num_events, wait_list, event);
+        return;
+    }
+    profileOp(op, batch * r, c);
+    const size_t matrix_size = kernels->elementSize * ((size_t)(batch - 1) * stride_m + r * c);
+    const size_t vector_size = kernels->elementSize * ((size_t)(batch - 1) * stride_v + c);
+    const size_t out_size = kernels->elementSize * batch * r;
+    cl_mem buffer1 = uploadBuffer(m, matrix_size, num_events, wait_list);
+    cl_mem buffer2 = uploadBuffer(v, vector_size, 0, NULL);
+    cl_mem buffer3 = outputBuffer(out, out_size, 0, NULL);
+    enqueueMatVec(kernels, buffer1, buffer2, buffer3, r, c, batch, stride_m, stride_v, r, 0, NULL, NULL);
+    downloadBuffer(buffer3, out, out_size, event);
+
+    releaseBuffer(buffer1);
+    releaseBuffer(buffer2);
+    releaseBuffer(buffer3);
+}
+void addShapesFAsync(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    shapesAsync("addShapesF", &gpu.kernels, SHAPE_ADD, s1, s2, s3, r, c, num_events, wait_list, event);
+}
+void subtractShapesFAsync(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    shapesAsync("subtractShapesF", &gpu.kernels, SHAPE_SUBTRACT, s1, s2, s3, r, c, num_events, wait_list, event);
+}
+void crossShapesFAsync(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    shapesAsync("crossShapesF", &gpu.kernels, SHAPE_CROSS, s1, s2, s3, r, c, num_events, wait_list, event);
+}
+void divideShapesFAsync(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    shapesAsync("divideShapesF", &gpu.kernels, SHAPE_DIVIDE, s1, s2, s3, r, c, num_events, wait_list, event);
+}
+/*!
+    @brief Gives the number of GPUs an operation of a size is split over in multi device mode, which is 1 when it is not worth splitting
+*/
+static unsigned int shardCount(const double size, const double min_size)
+{
+    if (!multiDevice || deviceCount < 2 || size < min_size * deviceCount)
+    {
+        return 1;
+    }
+    return deviceCount;
+}
+/*!
+    @brief Gives where the part of a split operation for a GPU starts, every GPU gets a share of the n items as big as its share of the compute units
+*/
+static size_t shardStart(const unsigned int device, const size_t n)
+{
+    unsigned long long before = 0;
+    unsigned long long total = 0;
+    for (unsigned int i = 0; i < deviceCount; i++)
+    {
+        before += i < device ? devices[i].computeUnits : 0;
+        total += devices[i].computeUnits;
+    }
+    return total > 0 ? (size_t)(n * before / total) : n * device / deviceCount;
+}
+/*!
+    @brief Moves the errors a shard of an operation recorded on its device to the device or context that started the operation, so getError() there reports them
+*/
+static void moveShardError(GPU *device, GPU *caller)
+{
+    if (device == caller)
+    {
+        return;
+    }
+    if (device->status != CL_SUCCESS && caller->status == CL_SUCCESS)
+    {
+        caller->status = device->status;
+    }
+    if (device->err != CL_SUCCESS)
+    {
+        caller->err = device->err;
+    }
+    device->status = CL_SUCCESS;
+    device->err = CL_SUCCESS;
+}
+/*!
+    @brief Runs a float elementwise operation split into ranges over every GPU and waits for all of them
+*/
+static void shardShapesF(const char *name, const ShapeOp op, const float *s1, const float *s2, float *s3, const size_t n)
+{
+    if (recordingHostOp(NULL))
+    {
+        return;
+    }
+    GPU *caller = current;
+    cl_event events[MAX_DEVICES];
+    for (unsigned int i = 0; i < deviceCount; i++)
+    {
+        const size_t start = shardStart(i, n);
+        current = &devices[i];
+        shapesAsync(name, &gpu.kernels, op, s1 + start, s2 + start, s3 + start, 1, (unsigned int)(shardStart(i + 1, n) - start), 0, NULL, &events[i]);
+        gpu.err = clFlush(gpu.queue);
+    }
+    for (unsigned int i = 0; i < deviceCount; i++)
+    {
+        current = &devices[i];
+        finishEvent(events[i]);
+        moveShardError(&devices[i], caller);
+    }
+    current = caller;
+}
+/*!
+    @brief Runs a float dot product with an epilogue split into row blocks of s1 and s3 over every GPU, each one multiplying its rows by all of s2, and waits for all of them
+*/
+static void shardGemmF(const char *op, const Transpose trans1, const Transpose trans2, const float *s1, const unsigned int ld1, const float *s2, const unsigned int ld2, float *s3, const unsigned int ld3, const unsigned int r, const unsigned int c, const unsigned int c2, const float alpha, const float beta, const float *bias, const Activation activation)
+{
+    if (recordingHostOp(NULL))
+    {
+        return;
+    }
+    GPU *caller = current;
+    cl_event events[MAX_DEVICES];
+    for (unsigned int i = 0; i < deviceCount; i++)
+    {
+        const size_t start = shardStart(i, r);
+        current = &devices[i];
+        /* The rows of a transposed s1 are its columns as it is stored */
+        const float *block1 = trans1 == TRANSPOSE ? s1 + start : s1 + start * ld1;
+        gemmAsync(op, trans1, trans2, block1, ld1, s2, ld2, s3 + start * ld3, ld3, (unsigned int)(shardStart(i + 1, r) - start), c, c2, alpha, beta, bias, activation, 0, NULL, &events[i]);
+        gpu.err = clFlush(gpu.queue);
+    }
+    for (unsigned int i = 0; i < deviceCount; i++)
+    {
+        current = &devices[i];
+        finishEvent(events[i]);
+        moveShardError(&devices[i], caller);
+    }
+    current = caller;
+}
+void addShapesF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c)
+{
+    if (shardCount((double)r * c, SHARD_MIN_ELEMENTS) > 1)
+    {
+        shardShapesF("addShapesF", SHAPE_ADD, s1, s2, s3, (size_t)r * c);
+        return;
+    }
+    cl_event event;
+    addShapesFAsync(s1, s2, s3, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void subtractShapesF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c)
+{
+    if (shardCount((double)r * c, SHARD_MIN_ELEMENTS) > 1)
+    {
+        shardShapesF("subtractShapesF", SHAPE_SUBTRACT, s1, s2, s3, (size_t)r * c);
+        return;
+    }
+    cl_event event;
+    subtractShapesFAsync(s1, s2, s3, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void crossShapesF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c)
+{
+    if (shardCount((double)r * c, SHARD_MIN_ELEMENTS) > 1)
+    {
+        shardShapesF("crossShapesF", SHAPE_CROSS, s1, s2, s3, (size_t)r * c);
+        return;
+    }
+    cl_event event;
+    crossShapesFAsync(s1, s2, s3, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void divideShapesF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c)
+{
+    if (shardCount((double)r * c, SHARD_MIN_ELEMENTS) > 1)
+    {
+        shardShapesF("divideShapesF", SHAPE_DIVIDE, s1, s2, s3, (size_t)r * c);
+        return;
+    }
+    cl_event event;
+    divideShapesFAsync(s1, s2, s3, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void dotMatricesFAsync(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    dotMatricesAsync("dotMatricesF", &gpu.kernels, s1, s2, s3, r, c, c2, 1, 0, 0, num_events, wait_list, event);
+}
+void dotMatricesF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2)
+{
+    if (shardCount(r, SHARD_MIN_ROWS) > 1)
+    {
+        shardGemmF("dotMatricesF", NO_TRANSPOSE, NO_TRANSPOSE, s1, c, s2, c2, s3, c2, r, c, c2, 1.0f, 0.0f, NULL, ACTIVATION_NONE);
+        return;
+    }
+    cl_event event;
+    dotMatricesFAsync(s1, s2, s3, r, c, c2, 0, NULL, &event);
+    finishEvent(event);
+}
+void gemmFAsync(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2, const float alpha, const float beta, const float *bias, const Activation activation, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    gemmAsync("gemmF", NO_TRANSPOSE, NO_TRANSPOSE, s1, c, s2, c2, s3, c2, r, c, c2, alpha, beta, bias, activation, num_events, wait_list, event);
+}
+void gemmF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2, const float alpha, const float beta, const float *bias, const Activation activation)
+{
+    if (shardCount(r, SHARD_MIN_ROWS) > 1)
+    {
+        shardGemmF("gemmF", NO_TRANSPOSE, NO_TRANSPOSE, s1, c, s2, c2, s3, c2, r, c, c2, alpha, beta, bias, activation);
+        return;
+    }
+    cl_event event;
+    gemmFAsync(s1, s2, s3, r, c, c2, alpha, beta, bias, activation, 0, NULL, &event);
+    finishEvent(event);
+}
+void gemmStridedFAsync(const Transpose trans1, const Transpose trans2, const float *s1, const unsigned int ld1, const float *s2, const unsigned int ld2, float *s3, const unsigned int ld3, const unsigned int r, const unsigned int c, const unsigned int c2, const float alpha, const float beta, const float *bias, const Activation activation, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    gemmAsync("gemmStridedF", trans1, trans2, s1, ld1, s2, ld2, s3, ld3, r, c, c2, alpha, beta, bias, activation, num_events, wait_list, event);
+}
+void gemmStridedF(const Transpose trans1, const Transpose trans2, const float *s1, const unsigned int ld1, const float *s2, const unsigned int ld2, float *s3, const unsigned int ld3, const unsigned int r, const unsigned int c, const unsigned int c2, const float alpha, const float beta, const float *bias, const Activation activation)
+{
+    if (shardCount(r, SHARD_MIN_ROWS) > 1)
+    {
+        shardGemmF("gemmStridedF", trans1, trans2, s1, ld1, s2, ld2, s3, ld3, r, c, c2, alpha, beta, bias, activation);
+        return;
+    }
+    cl_event event;
+    gemmStridedFAsync(trans1, trans2, s1, ld1, s2, ld2, s3, ld3, r, c, c2, alpha, beta, bias, activation, 0, NULL, &event);
+    finishEvent(event);
+}
+void dotMatricesStridedFAsync(const Transpose trans1, const Transpose trans2, const float *s1, const unsigned int ld1, const float *s2, const unsigned int ld2, float *s3, const unsigned int ld3, const unsigned int r, const unsigned int c, const unsigned int c2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    gemmAsync("dotMatricesStridedF", trans1, trans2, s1, ld1, s2, ld2, s3, ld3, r, c, c2, 1.0f, 0.0f, NULL, ACTIVATION_NONE, num_events, wait_list, event);
+}
+void dotMatricesStridedF(const Transpose trans1, const Transpose trans2, const float *s1, const unsigned int ld1, const float *s2, const unsigned int ld2, float *s3, const unsigned int ld3, const unsigned int r, const unsigned int c, const unsigned int c2)
+{
+    if (shardCount(r, SHARD_MIN_ROWS) > 1)
+    {
+        shardGemmF("dotMatricesStridedF", trans1, trans2, s1, ld1, s2, ld2, s3, ld3, r, c, c2, 1.0f, 0.0f, NULL, ACTIVATION_NONE);
+        return;
+    }
+    cl_event event;
+    dotMatricesStridedFAsync(trans1, trans2, s1, ld1, s2, ld2, s3, ld3, r, c, c2, 0, NULL, &event);
+    finishEvent(event);
+}
+void matVecFAsync(const float *m, const float *v, float *out, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    matVecAsync("matVecF", &gpu.kernels, m, v, out, r, c, 1, 0, 0, num_events, wait_list, event);
+}
+void matVecF(const float *m, const float *v, float *out, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    matVecFAsync(m, v, out, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void matVecStridedFAsync(const Transpose trans, const float *m, const unsigned int ld, const float *v, float *out, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    matVecStridedAsync("matVecStridedF", trans, m, ld, v, out, r, c, num_events, wait_list, event);
+}
+void matVecStridedF(const Transpose trans, const float *m, const unsigned int ld, const float *v, float *out, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    matVecStridedFAsync(trans, m, ld, v, out, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+/*!
+    @brief Copies a host sparse matrix and a vector or dense matrix to the GPU, multiplies them and copies the result back without waiting for any of it, c2 is 0 for the matrix vector product
+*/
+static void csrAsync(const char *op, const unsigned int *row_ptr, const unsigned int *cols, const float *values, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (recordingHostOp(event))
+    {
+        return;
+    }
+    const unsigned int nnz = row_ptr[r];
+    const unsigned int columns = c2 > 0 ? c2 : 1;
+    const size_t index_size = sizeof(unsigned int) * (r + 1);
+    const size_t nonzero_size = sizeof(unsigned int) * nnz;
+    const size_t value_size = sizeof(float) * nnz;
+    const size_t in_size = sizeof(float) * c * columns;
+    const size_t out_size = sizeof(float) * r * columns;
+    const double upload_bytes = copiedBytes(row_ptr, index_size) + copiedBytes(cols, nonzero_size) + copiedBytes(values, value_size) + copiedBytes(s2, in_size);
+    /* Sparse products are bound by gathering memory like the matrix vector product, so they use its rates */
+    if (useCpu(&gpu.kernels, &gpu.costs.gpuMatVecRate, &gpu.costs.cpuMatVecRate, (double)nnz * columns, 4, upload_bytes, copiedBytes(s3, out_size)))
+    {
+        cpuWaitEvents(num_events, wait_list);
+        if (c2 > 0)
+        {
+            cpuCsrDotMatricesF(row_ptr, cols, values, s2, s3, r, c2);
+        }
+        else
+        {
+            cpuCsrMatVecF(row_ptr, cols, values, s2, s3, r);
+        }
+        cpuCompleteEvent(event);
+        return;
+    }
+    profileOp(op, r, c);
+    cl_mem row_buffer = uploadBuffer(row_ptr, index_size, num_events, wait_list);
+    /* Copies of 0 bytes are invalid, so a matrix without nonzeros or columns gets small pooled buffers that the kernels never read */
+    cl_mem col_buffer = nnz > 0 ? uploadBuffer(cols, nonzero_size, 0, NULL) : acquireBuffer(0);
+    cl_mem value_buffer = nnz > 0 ? uploadBuffer(values, value_size, 0, NULL) : acquireBuffer(0);
+    cl_mem in = in_size > 0 ? uploadBuffer(s2, in_size, 0, NULL) : acquireBuffer(0);
+    cl_mem out = outputBuffer(s3, out_size, 0, NULL);
+    if (c2 > 0)
+    {
+        enqueueCsrDotMatrices(&gpu.kernels, row_buffer, col_buffer, value_buffer, in, out, r, c2, 0, NULL, NULL);
+    }
+    else
+    {
+        enqueueCsrMatVec(&gpu.kernels, row_buffer, col_buffer, value_buffer, in, out, r, nnz, 0, NULL, NULL);
+    }
+    downloadBuffer(out, s3, out_size, event);
+
+    releaseBuffer(row_buffer);
+    releaseBuffer(col_buffer);
+    releaseBuffer(value_buffer);
+    releaseBuffer(in);
+    releaseBuffer(out);
+}
+void csrMatVecFAsync(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const float *v, float *out, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    csrAsync("csrMatVecF", row_ptr, cols, values, v, out, r, c, 0, num_events, wait_list, event);
+}
+void csrMatVecF(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const float *v, float *out, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    csrMatVecFAsync(row_ptr, cols, values, v, out, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void csrDotMatricesFAsync(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    csrAsync("csrDotMatricesF", row_ptr, cols, values, s2, s3, r, c, c2, num_events, wait_list, event);
+}
+void csrDotMatricesF(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2)
+{
+    cl_event event;
+    csrDotMatricesFAsync(row_ptr, cols, values, s2, s3, r, c, c2, 0, NULL, &event);
+    finishEvent(event);
+}
+void dotMatricesBatchedFAsync(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2, const unsigned int batch, const unsigned int stride1, const unsigned int stride2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    dotMatricesAsync("dotMatricesBatchedF", &gpu.kernels, s1, s2, s3, r, c, c2, batch, stride1, stride2, num_events, wait_list, event);
+}
+void dotMatricesBatchedF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2, const unsigned int batch, const unsigned int stride1, const unsigned int stride2)
+{
+    cl_event event;
+    dotMatricesBatchedFAsync(s1, s2, s3, r, c, c2, batch, stride1, stride2, 0, NULL, &event);
+    finishEvent(event);
+}
+void matVecBatchedFAsync(const float *m, const float *v, float *out, const unsigned int r, const unsigned int c, const unsigned int batch, const unsigned int stride_m, const unsigned int stride_v, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    matVecAsync("matVecBatchedF", &gpu.kernels, m, v, out, r, c, batch, stride_m, stride_v, num_events, wait_list, event);
+}
+void matVecBatchedF(const float *m, const float *v, float *out, const unsigned int r, const unsigned int c, const unsigned int batch, const unsigned int stride_m, const unsigned int stride_v)
+{
+    cl_event event;
+    matVecBatchedFAsync(m, v, out, r, c, batch, stride_m, stride_v, 0, NULL, &event);
+    finishEvent(event);
+}
+void addShapesDAsync(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    shapesAsync("addShapesD", &gpu.kernelsD, SHAPE_ADD, s1, s2, s3, r, c, num_events, wait_list, event);
+}
+void subtractShapesDAsync(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    shapesAsync("subtractShapesD", &gpu.kernelsD, SHAPE_SUBTRACT, s1, s2, s3, r, c, num_events, wait_list, event);
+}
+void crossShapesDAsync(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    shapesAsync("crossShapesD", &gpu.kernelsD, SHAPE_CROSS, s1, s2, s3, r, c, num_events, wait_list, event);
+}
+void divideShapesDAsync(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    shapesAsync("divideShapesD", &gpu.kernelsD, SHAPE_DIVIDE, s1, s2, s3, r, c, num_events, wait_list, event);
+}
+void addShapesD(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    addShapesDAsync(s1, s2, s3, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void subtractShapesD(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    subtractShapesDAsync(s1, s2, s3, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void crossShapesD(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    crossShapesDAsync(s1, s2, s3, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void divideShapesD(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    divideShapesDAsync(s1, s2, s3, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void dotMatricesDAsync(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c, const unsigned int c2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    dotMatricesAsync("dotMatricesD", &gpu.kernelsD, s1, s2, s3, r, c, c2, 1, 0, 0, num_events, wait_list, event);
+}
+void dotMatricesD(const double *s1, const double *s2, double *s3, const unsigned int r, const unsigned int c, const unsigned int c2)
+{
+    cl_event event;
+    dotMatricesDAsync(s1, s2, s3, r, c, c2, 0, NULL, &event);
+    finishEvent(event);
+}
+void matVecDAsync(const double *m, const double *v, double *out, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    matVecAsync("matVecD", &gpu.kernelsD, m, v, out, r, c, 1, 0, 0, num_events, wait_list, event);
+}
+void matVecD(const double *m, const double *v, double *out, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    matVecDAsync(m, v, out, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void addShapesHAsync(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    shapesAsync("addShapesH", &gpu.kernelsH, SHAPE_ADD, s1, s2, s3, r, c, num_events, wait_list, event);
+}
+void subtractShapesHAsync(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    shapesAsync("subtractShapesH", &gpu.kernelsH, SHAPE_SUBTRACT, s1, s2, s3, r, c, num_events, wait_list, event);
+}
+void crossShapesHAsync(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    shapesAsync("crossShapesH", &gpu.kernelsH, SHAPE_CROSS, s1, s2, s3, r, c, num_events, wait_list, event);
+}
+void divideShapesHAsync(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    shapesAsync("divideShapesH", &gpu.kernelsH, SHAPE_DIVIDE, s1, s2, s3, r, c, num_events, wait_list, event);
+}
+void addShapesH(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    addShapesHAsync(s1, s2, s3, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void subtractShapesH(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    subtractShapesHAsync(s1, s2, s3, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void crossShapesH(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    crossShapesHAsync(s1, s2, s3, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void divideShapesH(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    divideShapesHAsync(s1, s2, s3, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void dotMatricesHAsync(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c, const unsigned int c2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    dotMatricesAsync("dotMatricesH", &gpu.kernelsH, s1, s2, s3, r, c, c2, 1, 0, 0, num_events, wait_list, event);
+}
+void dotMatricesH(const cl_half *s1, const cl_half *s2, cl_half *s3, const unsigned int r, const unsigned int c, const unsigned int c2)
+{
+    cl_event event;
+    dotMatricesHAsync(s1, s2, s3, r, c, c2, 0, NULL, &event);
+    finishEvent(event);
+}
+void matVecHAsync(const cl_half *m, const cl_half *v, cl_half *out, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    matVecAsync("matVecH", &gpu.kernelsH, m, v, out, r, c, 1, 0, 0, num_events, wait_list, event);
+}
+void matVecH(const cl_half *m, const cl_half *v, cl_half *out, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    matVecHAsync(m, v, out, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+unsigned int gpuDeviceCount()
+{
+    return deviceCount;
+}
+GPU *gpuDevice(const unsigned int index)
+{
+    return index < deviceCount ? &devices[index] : NULL;
+}
+GPU *gpuCurrentDevice()
+{
+    return current;
+}
+void gpuUseDevice(GPU *device)
+{
+    if (device != NULL)
+    {
+        current = device;
+    }
+}
+void setMultiDevice(const int enabled)
+{
+    multiDevice = enabled;
+}
+int gpuFound()
+{
+    return gpu.hasDevice;
+}
+int gpuSupportsDouble()
+{
+    return gpu.kernelsD.dotFKernel != NULL;
+}
+int gpuSupportsHalf()
+{
+    return gpu.kernelsH.dotFKernel != NULL;
+}
+/*!
+    @brief Flushes all three queues so that commands waiting on each other across queues can start
+*/
+static void flushQueues()
+{
+    clFlush(gpu.uploadQueue);
+    clFlush(gpu.queue);
+    clFlush(gpu.downloadQueue);
+}
+void streamShapesF(const ShapeOp op, const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, unsigned int chunk_rows)
+{
+    if (recordingHostOp(NULL))
+    {
+        return;
+    }
+    if (r == 0 || c == 0)
+    {
+        return;
+    }
+    if (chunk_rows == 0 || chunk_rows > r)
+    {
+        chunk_rows = r;
+    }
+    if (!gpu.hasDevice)
+    {
+        cpuShapesF(op, s1, s2, s3, (size_t)r * c);
+        return;
+    }
+    profileOp("streamShapesF", r, c);
+    const unsigned int chunks = (r + chunk_rows - 1) / chunk_rows;
+    const size_t chunk_size = sizeof(float) * chunk_rows * c;
+    cl_mem buffers1[STREAM_SLOTS];
+    cl_mem buffers2[STREAM_SLOTS];
+    cl_mem buffers3[STREAM_SLOTS];
+    cl_event downloaded[STREAM_SLOTS] = {NULL};
+    const unsigned int slots = chunks < STREAM_SLOTS ? chunks : STREAM_SLOTS;
+    /* Pooled buffers may still be in use by commands on gpu.queue, which the other queues do not wait for */
+    gpu.err = clEnqueueMarkerWithWaitList(gpu.queue, 0, NULL, &downloaded[0]);
+    for (unsigned int i = 0; i < slots; i++)
+    {
+        if (i > 0)
+        {
+            downloaded[i] = downloaded[0];
+            clRetainEvent(downloaded[i]);
+        }
+        buffers1[i] = acquireBuffer(chunk_size);
+        buffers2[i] = acquireBuffer(chunk_size);
+        buffers3[i] = acquireBuffer(chunk_size);
+    }
+    for (unsigned int i = 0; i < chunks; i++)
+    {
+        const unsigned int slot = i % STREAM_SLOTS;
+        const unsigned int rows = r - i * chunk_rows < chunk_rows ? r - i * chunk_rows : chunk_rows;
+        const size_t offset = (size_t)i * chunk_rows * c;
+        const size_t size = sizeof(float) * rows * c;
+        cl_event uploaded;
+        cl_event computed;
+        /* A slot can only be refilled once the chunk that used it last has been downloaded */
+        const cl_uint slot_waits = downloaded[slot] != NULL ? 1 : 0;
+        enqueueWrite(gpu.uploadQueue, buffers1[slot], size, s1 + offset, slot_waits, &downloaded[slot], NULL);
+        enqueueWrite(gpu.uploadQueue, buffers2[slot], size, s2 + offset, 0, NULL, &uploaded);
+        if (downloaded[slot] != NULL)
+        {
+            clReleaseEvent(downloaded[slot]);
+        }
+        enqueueShapesF(&gpu.kernels, shapeKernel(&gpu.kernels, op), buffers1[slot], buffers2[slot], buffers3[slot], rows * c, 1, &uploaded, &computed);
+        enqueueRead(gpu.downloadQueue, buffers3[slot], CL_FALSE, size, s3 + offset, 1, &computed, &downloaded[slot]);
+        clReleaseEvent(uploaded);
+        clReleaseEvent(computed);
+        flushQueues();
+    }
+    for (unsigned int i = 0; i < slots; i++)
+    {
+        finishEvent(downloaded[i]);
+        releaseBuffer(buffers1[i]);
+        releaseBuffer(buffers2[i]);
+        releaseBuffer(buffers3[i]);
+    }
+}
+void streamMatVecF(const float *m, const float *v, float *out, const unsigned int r, const unsigned int c, unsigned int chunk_rows)
+{
+    if (recordingHostOp(NULL))
+    {
+        return;
+    }
+    if (r == 0)
+    {
+        return;
+    }
+    if (chunk_rows == 0 || chunk_rows > r)
+    {
+        chunk_rows = r;
+    }
+    /* Without columns every element of out is an empty sum, which the CPU writes without a copy */
+    if (!gpu.hasDevice || c == 0)
+    {
+        cpuMatVecF(m, v, out, r, c);
+        return;
+    }
+    profileOp("streamMatVecF", r, c);
+    const unsigned int chunks = (r + chunk_rows - 1) / chunk_rows;
+    cl_mem matrices[STREAM_SLOTS];
+    cl_mem outs[STREAM_SLOTS];
+    cl_event downloaded[STREAM_SLOTS] = {NULL};
+    const unsigned int slots = chunks < STREAM_SLOTS ? chunks : STREAM_SLOTS;
+    /* Pooled buffers may still be in use by commands on gpu.queue, which the other queues do not wait for */
+    gpu.err = clEnqueueMarkerWithWaitList(gpu.queue, 0, NULL, &downloaded[0]);
+    for (unsigned int i = 0; i < slots; i++)
+    {
+        if (i > 0)
+        {
+            downloaded[i] = downloaded[0];
+            clRetainEvent(downloaded[i]);
+        }
+        matrices[i] = acquireBuffer(sizeof(float) * chunk_rows * c);
+        outs[i] = acquireBuffer(sizeof(float) * chunk_rows);
+    }
+    cl_mem vector = acquireBuffer(sizeof(float) * c);
+    enqueueWrite(gpu.uploadQueue, vector, sizeof(float) * c, v, 1, &downloaded[0], NULL);
+    for (unsigned int i = 0; i < chunks; i++)
+    {
+        const unsigned int slot = i % STREAM_SLOTS;
+        const unsigned int rows = r - i * chunk_rows < chunk_rows ? r - i * chunk_rows : chunk_rows;
+        cl_event uploaded;
+        cl_event computed;
+        /* The upload queue is in order so waiting on this chunk also waits on the vector */
+        const cl_uint slot_waits = downloaded[slot] != NULL ? 1 : 0;
+        enqueueWrite(gpu.uploadQueue, matrices[slot], sizeof(float) * rows * c, m + (size_t)i * chunk_rows * c, slot_waits, &downloaded[slot], &uploaded);
+        if (downloaded[slot] != NULL)
+        {
+            clReleaseEvent(downloaded[slot]);
+        }
+        enqueueMatVec(&gpu.kernels, matrices[slot], vector, outs[slot], rows, c, 1, 0, 0, 0, 1, &uploaded, &computed);
+        enqueueRead(gpu.downloadQueue, outs[slot], CL_FALSE, sizeof(float) * rows, out + (size_t)i * chunk_rows, 1, &computed, &downloaded[slot]);
+        clReleaseEvent(uploaded);
+        clReleaseEvent(computed);
+        flushQueues();
+    }
+    for (unsigned int i = 0; i < slots; i++)
+    {
+        finishEvent(downloaded[i]);
+        releaseBuffer(matrices[i]);
+        releaseBuffer(outs[i]);
+    }
+    releaseBuffer(vector);
+}
+DeviceShapeF *createDeviceShapeFAsync(const float *s, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    DeviceShapeF *d = malloc(sizeof(DeviceShapeF));
+    d->r = r;
+    d->c = c;
+    d->buffer = acquireBuffer(sizeof(float) * r * c);
+    if (s != NULL)
+    {
+        profileOp("createDeviceShapeF", r, c);
+        enqueueWrite(gpu.queue, d->buffer, sizeof(float) * r * c, s, num_events, wait_list, event);
+    }
+    else if (event != NULL)
+    {
+        gpu.err = clEnqueueMarkerWithWaitList(gpu.queue, num_events, wait_list, event);
+    }
+    return d;
+}
+DeviceShapeF *createDeviceShapeF(const float *s, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    DeviceShapeF *d = createDeviceShapeFAsync(s, r, c, 0, NULL, s != NULL ? &event : NULL);
+    if (s != NULL)
+    {
+        finishEvent(event);
+    }
+    return d;
+}
+void downloadDeviceShapeFAsync(const DeviceShapeF *s, float *out, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    profileOp("downloadDeviceShapeF", s->r, s->c);
+    enqueueRead(gpu.queue, s->buffer, CL_FALSE, sizeof(float) * s->r * s->c, out, num_events, wait_list, event);
+}
+void downloadDeviceShapeF(const DeviceShapeF *s, float *out)
+{
+    profileOp("downloadDeviceShapeF", s->r, s->c);
+    enqueueRead(gpu.queue, s->buffer, CL_TRUE, sizeof(float) * s->r * s->c, out, 0, NULL, NULL);
+}
+void getDeviceShapeSizeF(const DeviceShapeF *s, unsigned int *r, unsigned int *c)
+{
+    *r = s->r;
+    *c = s->c;
+}
+void freeDeviceShapeF(DeviceShapeF *s)
+{
+    if (s == NULL)
+    {
+        return;
+    }
+    releaseBuffer(s->buffer);
+    free(s);
+}
+float *mapDeviceShapeF(DeviceShapeF *s)
+{
+    return clEnqueueMapBuffer(gpu.queue, s->buffer, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, sizeof(float) * s->r * s->c, 0, NULL, NULL, &gpu.err);
+}
+void unmapDeviceShapeF(DeviceShapeF *s, float *mapped)
+{
+    gpu.err = clEnqueueUnmapMemObject(gpu.queue, s->buffer, mapped, 0, NULL, NULL);
+}
+/*!
+    @brief Runs one of the elementwise kernels on two device shapes and returns a new device shape with the result
+*/
+static DeviceShapeF *elementwiseDeviceShapesF(cl_kernel kernel, const DeviceShapeF *s1, const DeviceShapeF *s2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    DeviceShapeF *s3 = createDeviceShapeFAsync(NULL, s1->r, s1->c, 0, NULL, NULL);
+    profileOp("elementwiseDeviceShapesF", s1->r, s1->c);
+    enqueueShapesF(&gpu.kernels, kernel, s1->buffer, s2->buffer, s3->buffer, s1->r * s1->c, num_events, wait_list, event);
+    return s3;
+}
+DeviceShapeF *addDeviceShapesFAsync(const DeviceShapeF *s1, const DeviceShapeF *s2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    return elementwiseDeviceShapesF(gpu.kernels.addFKernel, s1, s2, num_events, wait_list, event);
+}
+DeviceShapeF *subtractDeviceShapesFAsync(const DeviceShapeF *s1, const DeviceShapeF *s2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    return elementwiseDeviceShapesF(gpu.kernels.subtractFKernel, s1, s2, num_events, wait_list, event);
+}
+DeviceShapeF *crossDeviceShapesFAsync(const DeviceShapeF *s1, const DeviceShapeF *s2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    return elementwiseDeviceShapesF(gpu.kernels.crossFKernel, s1, s2, num_events, wait_list, event);
+}
+DeviceShapeF *divideDeviceShapesFAsync(const DeviceShapeF *s1, const DeviceShapeF *s2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    return elementwiseDeviceShapesF(gpu.kernels.divideFKernel, s1, s2, num_events, wait_list, event);
+}
+DeviceShapeF *dotDeviceMatricesFAsync(const DeviceShapeF *s1, const DeviceShapeF *s2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    DeviceShapeF *s3 = createDeviceShapeFAsync(NULL, s1->r, s2->c, 0, NULL, NULL);
+    profileOp("dotDeviceMatricesF", s1->r, s2->c);
+    enqueueDotMatrices(&gpu.kernels, s1->buffer, s2->buffer, s3->buffer, s1->r, s1->c, s2->c, 1, 0, 0, 0, NULL, num_events, wait_list, event);
+    return s3;
+}
+DeviceShapeF *gemmDeviceFAsync(const DeviceShapeF *s1, const DeviceShapeF *s2, const DeviceShapeF *s3, const float alpha, const float beta, const DeviceShapeF *bias, const Activation activation, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    DeviceShapeF *out = createDeviceShapeFAsync(NULL, s1->r, s2->c, 0, NULL, NULL);
+    profileOp("gemmDeviceF", s1->r, s2->c);
+    const Epilogue epilogue = {alpha, beta, beta != 0.0f ? s3->buffer : NULL, bias != NULL ? bias->buffer : NULL, activation};
+    enqueueDotMatrices(&gpu.kernels, s1->buffer, s2->buffer, out->buffer, s1->r, s1->c, s2->c, 1, 0, 0, 0, &epilogue, num_events, wait_list, event);
+    return out;
+}
+DeviceShapeF *matVecDeviceFAsync(const DeviceShapeF *m, const DeviceShapeF *v, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    DeviceShapeF *out = createDeviceShapeFAsync(NULL, 1, m->r, 0, NULL, NULL);
+    profileOp("matVecDeviceF", m->r, m->c);
+    enqueueMatVec(&gpu.kernels, m->buffer, v->buffer, out->buffer, m->r, m->c, 1, 0, 0, 0, num_events, wait_list, event);
+    return out;
+}
+DeviceShapeF *dotDeviceMatricesBatchedF(const DeviceShapeF *s1, const DeviceShapeF *s2, const unsigned int r, const unsigned int c, const unsigned int c2, const unsigned int batch, const unsigned int stride1, const unsigned int stride2)
+{
+    DeviceShapeF *s3 = createDeviceShapeFAsync(NULL, batch * r, c2, 0, NULL, NULL);
+    profileOp("dotDeviceMatricesBatchedF", batch * r, c2);
+    if (batch > 0)
+    {
+        enqueueDotMatrices(&gpu.kernels, s1->buffer, s2->buffer, s3->buffer, r, c, c2, batch, stride1, stride2, r * c2, NULL, 0, NULL, NULL);
+    }
+    return s3;
+}
+DeviceShapeF *matVecDeviceBatchedF(const DeviceShapeF *m, const DeviceShapeF *v, const unsigned int r, const unsigned int c, const unsigned int batch, const unsigned int stride_m, const unsigned int stride_v)
+{
+    DeviceShapeF *out = createDeviceShapeFAsync(NULL, batch, r, 0, NULL, NULL);
+    profileOp("matVecDeviceBatchedF", batch * r, c);
+    if (batch > 0)
+    {
+        enqueueMatVec(&gpu.kernels, m->buffer, v->buffer, out->buffer, r, c, batch, stride_m, stride_v, r, 0, NULL, NULL);
+    }
+    return out;
+}
+DeviceShapeF *addDeviceShapesF(const DeviceShapeF *s1, const DeviceShapeF *s2)
+{
+    return addDeviceShapesFAsync(s1, s2, 0, NULL, NULL);
+}
+DeviceShapeF *subtractDeviceShapesF(const DeviceShapeF *s1, const DeviceShapeF *s2)
+{
+    return subtractDeviceShapesFAsync(s1, s2, 0, NULL, NULL);
+}
+DeviceShapeF *crossDeviceShapesF(const DeviceShapeF *s1, const DeviceShapeF *s2)
+{
+    return crossDeviceShapesFAsync(s1, s2, 0, NULL, NULL);
+}
+DeviceShapeF *divideDeviceShapesF(const DeviceShapeF *s1, const DeviceShapeF *s2)
+{
+    return divideDeviceShapesFAsync(s1, s2, 0, NULL, NULL);
+}
+DeviceShapeF *dotDeviceMatricesF(const DeviceShapeF *s1, const DeviceShapeF *s2)
+{
+    return dotDeviceMatricesFAsync(s1, s2, 0, NULL, NULL);
+}
+DeviceShapeF *gemmDeviceF(const DeviceShapeF *s1, const DeviceShapeF *s2, const DeviceShapeF *s3, const float alpha, const float beta, const DeviceShapeF *bias, const Activation activation)
+{
+    return gemmDeviceFAsync(s1, s2, s3, alpha, beta, bias, activation, 0, NULL, NULL);
+}
+DeviceShapeF *matVecDeviceF(const DeviceShapeF *m, const DeviceShapeF *v)
+{
+    return matVecDeviceFAsync(m, v, 0, NULL, NULL);
+}
+DeviceCsrF *createDeviceCsrFAsync(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    DeviceCsrF *d = malloc(sizeof(DeviceCsrF));
+    d->r = r;
+    d->c = c;
+    d->nnz = row_ptr[r];
+    d->rowPtr = acquireBuffer(sizeof(unsigned int) * (r + 1));
+    d->cols = acquireBuffer(sizeof(unsigned int) * d->nnz);
+    d->values = acquireBuffer(sizeof(float) * d->nnz);
+    profileOp("createDeviceCsrF", r, c);
+    /* The queue runs in order, so the event of the last copy completes after all three */
+    enqueueWrite(gpu.queue, d->rowPtr, sizeof(unsigned int) * (r + 1), row_ptr, num_events, wait_list, d->nnz > 0 ? NULL : event);
+    if (d->nnz > 0)
+    {
+        enqueueWrite(gpu.queue, d->cols, sizeof(unsigned int) * d->nnz, cols, 0, NULL, NULL);
+        enqueueWrite(gpu.queue, d->values, sizeof(float) * d->nnz, values, 0, NULL, event);
+    }
+    return d;
+}
+DeviceCsrF *createDeviceCsrF(const unsigned int *row_ptr, const unsigned int *cols, const float *values, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    DeviceCsrF *d = createDeviceCsrFAsync(row_ptr, cols, values, r, c, 0, NULL, &event);
+    finishEvent(event);
+    return d;
+}
+void downloadDeviceCsrF(const DeviceCsrF *s, unsigned int *row_ptr, unsigned int *cols, float *values)
+{
+    profileOp("downloadDeviceCsrF", s->r, s->c);
+    if (row_ptr != NULL)
+    {
+        enqueueRead(gpu.queue, s->rowPtr, CL_TRUE, sizeof(unsigned int) * (s->r + 1), row_ptr, 0, NULL, NULL);
+    }
+    if (cols != NULL)
+    {
+        enqueueRead(gpu.queue, s->cols, CL_TRUE, sizeof(unsigned int) * s->nnz, cols, 0, NULL, NULL);
+    }
+    if (values != NULL)
+    {
+        enqueueRead(gpu.queue, s->values, CL_TRUE, sizeof(float) * s->nnz, values, 0, NULL, NULL);
+    }
+}
+void getDeviceCsrSizeF(const DeviceCsrF *s, unsigned int *r, unsigned int *c, unsigned int *nnz)
+{
+    *r = s->r;
+    *c = s->c;
+    *nnz = s->nnz;
+}
+void freeDeviceCsrF(DeviceCsrF *s)
+{
+    if (s == NULL)
+    {
+        return;
+    }
+    releaseBuffer(s->rowPtr);
+    releaseBuffer(s->cols);
+    releaseBuffer(s->values);
+    free(s);
+}
+DeviceShapeF *csrMatVecDeviceFAsync(const DeviceCsrF *m, const DeviceShapeF *v, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    DeviceShapeF *out = createDeviceShapeFAsync(NULL, 1, m->r, 0, NULL, NULL);
+    profileOp("csrMatVecDeviceF", m->r, m->c);
+    enqueueCsrMatVec(&gpu.kernels, m->rowPtr, m->cols, m->values, v->buffer, out->buffer, m->r, m->nnz, num_events, wait_list, event);
+    return out;
+}
+DeviceShapeF *csrMatVecDeviceF(const DeviceCsrF *m, const DeviceShapeF *v)
+{
+    return csrMatVecDeviceFAsync(m, v, 0, NULL, NULL);
+}
+DeviceShapeF *csrDotDeviceMatricesFAsync(const DeviceCsrF *s1, const DeviceShapeF *s2, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    DeviceShapeF *s3 = createDeviceShapeFAsync(NULL, s1->r, s2->c, 0, NULL, NULL);
+    profileOp("csrDotDeviceMatricesF", s1->r, s2->c);
+    enqueueCsrDotMatrices(&gpu.kernels, s1->rowPtr, s1->cols, s1->values, s2->buffer, s3->buffer, s1->r, s2->c, num_events, wait_list, event);
+    return s3;
+}
+DeviceShapeF *csrDotDeviceMatricesF(const DeviceCsrF *s1, const DeviceShapeF *s2)
+{
+    return csrDotDeviceMatricesFAsync(s1, s2, 0, NULL, NULL);
+}
+void beginCommandGraph()
+{
+    if (!gpu.hasDevice || gpu.graph != NULL)
+    {
+        return;
+    }
+    gpu.graph = calloc(1, sizeof(CommandGraph));
+    if (gpu.graph != NULL)
+    {
+        gpu.graph->device = current;
+    }
+}
+/*!
+    @brief Bakes a graph of kernels into a cl_khr_command_buffer when the GPU has the extension, otherwise the graph keeps its list of commands
+*/
+static void bakeCommandGraph(CommandGraph *graph)
+{
+#ifdef cl_khr_command_buffer
+    for (unsigned int i = 0; i < graph->count; i++)
+    {
+        if (graph->commands[i].kind != GRAPH_KERNEL)
+        {
+            /* The base extension only records kernels and copies between buffers */
+            return;
+        }
+    }
+    size_t extensions_size = 0;
+    gpu.err = clGetDeviceInfo(gpu.device, CL_DEVICE_EXTENSIONS, 0, NULL, &extensions_size);
+    char *extensions = calloc(extensions_size + 1, 1);
+    gpu.err = clGetDeviceInfo(gpu.device, CL_DEVICE_EXTENSIONS, extensions_size, extensions, NULL);
+    const int supported = strstr(extensions, "cl_khr_command_buffer") != NULL;
+    free(extensions);
+    if (graph->count == 0 || !supported)
+    {
+        return;
+    }
+    clCreateCommandBufferKHR_fn create = (clCreateCommandBufferKHR_fn)clGetExtensionFunctionAddressForPlatform(gpu.platform, "clCreateCommandBufferKHR");
+    clCommandNDRangeKernelKHR_fn command = (clCommandNDRangeKernelKHR_fn)clGetExtensionFunctionAddressForPlatform(gpu.platform, "clCommandNDRangeKernelKHR");
+    clFinalizeCommandBufferKHR_fn finalize = (clFinalizeCommandBufferKHR_fn)clGetExtensionFunctionAddressForPlatform(gpu.platform, "clFinalizeCommandBufferKHR");
+    clEnqueueCommandBufferKHR_fn enqueue = (clEnqueueCommandBufferKHR_fn)clGetExtensionFunctionAddressForPlatform(gpu.platform, "clEnqueueCommandBufferKHR");
+    clReleaseCommandBufferKHR_fn release = (clReleaseCommandBufferKHR_fn)clGetExtensionFunctionAddressForPlatform(gpu.platform, "clReleaseCommandBufferKHR");
+    if (create == NULL || command == NULL || finalize == NULL || enqueue == NULL || release == NULL)
+    {
+        return;
+    }
+    cl_int err = CL_SUCCESS;
+    cl_command_buffer_khr buffer = create(1, &gpu.queue, NULL, &err);
+    if (err != CL_SUCCESS)
+    {
+        return;
+    }
+    for (unsigned int i = 0; i < graph->count && err == CL_SUCCESS; i++)
+    {
+        const GraphCommand *c = &graph->commands[i];
+        /* Commands of a command buffer run in the order they were recorded when no sync points are given, like the in order queue */
+        err = command(buffer, NULL, NULL, c->kernel, c->dims, NULL, c->global, c->local[0] > 0 ? c->local : NULL, 0, NULL, NULL, NULL);
+    }
+    if (err == CL_SUCCESS)
+    {
+        err = finalize(buffer);
+    }
+    if (err != CL_SUCCESS)
+    {
+        release(buffer);
+        return;
+    }
+    graph->commandBuffer = buffer;
+    graph->enqueueCommandBuffer = enqueue;
+    graph->releaseCommandBuffer = release;
+#else
+    (void)graph;
+#endif
+}
+CommandGraph *endCommandGraph()
+{
+    CommandGraph *graph = gpu.graph;
+    if (graph == NULL)
+    {
+        return NULL;
+    }
+    gpu.graph = NULL;
+    if (graph->failed)
+    {
+        releaseCommandGraph(graph);
+        failCommand(CL_OUT_OF_HOST_MEMORY, NULL);
+        return NULL;
+    }
+    bakeCommandGraph(graph);
+    return graph;
+}
+/*!
+    @brief Enqueues the commands of a graph, the device the graph was recorded on must be current
+*/
+static void replayCommands(const CommandGraph *graph, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+#ifdef cl_khr_command_buffer
+    if (graph->commandBuffer != NULL)
+    {
+        gpu.err = graph->enqueueCommandBuffer(0, NULL, graph->commandBuffer, num_events, wait_list, event);
+        return;
+    }
+#endif
+    if (graph->count == 0)
+    {
+        gpu.err = clEnqueueMarkerWithWaitList(gpu.queue, num_events, wait_list, event);
+        return;
+    }
+    profileOp("replayCommandGraph", graph->count, 1);
+    /* The queue runs in order, so only the first command waits for the wait list and only the last one gives the event */
+    for (unsigned int i = 0; i < graph->count; i++)
+    {
+        const GraphCommand *c = &graph->commands[i];
+        const cl_uint waits = i == 0 ? num_events : 0;
+        const cl_event *list = i == 0 ? wait_list : NULL;
+        cl_event *done = i == graph->count - 1 ? event : NULL;
+        if (c->kind == GRAPH_KERNEL)
+        {
+            enqueueKernel(c->kernel, c->dims, c->global, c->local[0] > 0 ? c->local : NULL, waits, list, done);
+        }
+        else if (c->kind == GRAPH_WRITE)
+        {
+            enqueueWrite(gpu.queue, c->buffer, c->size, c->host, waits, list, done);
+        }
+        else
+        {
+            enqueueRead(gpu.queue, c->buffer, CL_FALSE, c->size, c->host, waits, list, done);
+        }
+    }
+}
+void replayCommandGraphAsync(const CommandGraph *graph, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    /* The kernels and buffers belong to the device the graph was recorded on, so they go to its queue whichever device or context is current */
+    GPU *caller = current;
+    current = graph->device;
+    replayCommands(graph, num_events, wait_list, event);
+    const cl_int err = gpu.err;
+    current = caller;
+    if (caller != graph->device)
+    {
+        gpu.err = err;
+        recordError(err);
+    }
+}
+void replayCommandGraph(const CommandGraph *graph)
+{
+    cl_event event;
+    replayCommandGraphAsync(graph, 0, NULL, &event);
+    finishEvent(event);
+}
+void getCommandGraphInfo(const CommandGraph *graph, unsigned int *commands, int *command_buffer)
+{
+    *commands = graph->count;
+#ifdef cl_khr_command_buffer
+    *command_buffer = graph->commandBuffer != NULL;
+#else
+    *command_buffer = 0;
+#endif
+}
+void releaseCommandGraph(CommandGraph *graph)
+{
+    if (graph == NULL)
+    {
+        return;
+    }
+    GPU *caller = current;
+    current = graph->device;
+#ifdef cl_khr_command_buffer
+    if (graph->commandBuffer != NULL)
+    {
+        graph->releaseCommandBuffer(graph->commandBuffer);
+    }
+#endif
+    for (unsigned int i = 0; i < graph->count; i++)
+    {
+        if (graph->commands[i].kind == GRAPH_KERNEL)
+        {
+            clReleaseKernel(graph->commands[i].kernel);
+        }
+    }
+    for (unsigned int i = 0; i < graph->bufferCount; i++)
+    {
+        releaseBuffer(graph->buffers[i]);
+    }
+    free(graph->commands);
+    free(graph->args);
+    free(graph->buffers);
+    free(graph);
+    current = caller;
+}
+/*!
+    @brief Applies an elementwise operation to a host shape and a scalar on the GPU or the CPU backend without waiting for it
+*/
+static void scalarAsync(const char *op_name, const ShapeOp op, const float *s, const float k, float *out, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (recordingHostOp(event))
+    {
+        return;
+    }
+    const size_t size = sizeof(float) * r * c;
+    if (useCpu(&gpu.kernels, &gpu.costs.gpuElementwiseRate, &gpu.costs.cpuElementwiseRate, (double)r * c, 1, copiedBytes(s, size), copiedBytes(out, size)))
+    {
+        cpuWaitEvents(num_events, wait_list);
+        cpuScalarShapesF(op, s, k, out, (size_t)r * c);
+        cpuCompleteEvent(event);
+        return;
+    }
+    profileOp(op_name, r, c);
+    cl_mem buffer1 = uploadBuffer(s, size, num_events, wait_list);
+    cl_mem buffer2 = outputBuffer(out, size, 1, &buffer1);
+    enqueueScalarShapesF(&gpu.kernels, buffer1, k, buffer2, r * c, op, 0, NULL, NULL);
+    downloadBuffer(buffer2, out, size, event);
+
+    releaseBuffer(buffer1);
+    releaseBuffer(buffer2);
+}
+/*!
+    @brief Applies an elementwise operation to a host shape and a host vector lined up with its rows or columns on the GPU or the CPU backend without waiting for it
+*/
+static void broadcastAsync(const char *op_name, const ShapeOp op, const float *s, const float *v, float *out, const unsigned int r, const unsigned int c, const BroadcastAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (recordingHostOp(event))
+    {
+        return;
+    }
+    const size_t size = sizeof(float) * r * c;
+    const size_t vector_size = sizeof(float) * (axis == BROADCAST_ROWS ? c : r);
+    if (useCpu(&gpu.kernels, &gpu.costs.gpuElementwiseRate, &gpu.costs.cpuElementwiseRate, (double)r * c, 2, copiedBytes(s, size) + copiedBytes(v, vector_size), copiedBytes(out, size)))
+    {
+        cpuWaitEvents(num_events, wait_list);
+        cpuBroadcastShapesF(op, s, v, out, r, c, axis);
+        cpuCompleteEvent(event);
+        return;
+    }
+    profileOp(op_name, r, c);
+    cl_mem buffer1 = uploadBuffer(s, size, num_events, wait_list);
+    cl_mem buffer2 = uploadBuffer(v, vector_size, 0, NULL);
+    const cl_mem inputs[2] = {buffer1, buffer2};
+    cl_mem buffer3 = outputBuffer(out, size, 2, inputs);
+    enqueueBroadcastShapesF(&gpu.kernels, buffer1, buffer2, buffer3, r, c, axis, op, 0, NULL, NULL);
+    downloadBuffer(buffer3, out, size, event);
+
+    releaseBuffer(buffer1);
+    releaseBuffer(buffer2);
+    releaseBuffer(buffer3);
+}
+void scalarShapesFAsync(const ShapeOp op, const float *s, const float k, float *out, const unsigned int r, const unsigned int c, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    scalarAsync("scalarShapesF", op, s, k, out, r, c, num_events, wait_list, event);
+}
+void scalarShapesF(const ShapeOp op, const float *s, const float k, float *out, const unsigned int r, const unsigned int c)
+{
+    cl_event event;
+    scalarShapesFAsync(op, s, k, out, r, c, 0, NULL, &event);
+    finishEvent(event);
+}
+void broadcastShapesFAsync(const ShapeOp op, const float *s, const float *v, float *out, const unsigned int r, const unsigned int c, const BroadcastAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    broadcastAsync("broadcastShapesF", op, s, v, out, r, c, axis, num_events, wait_list, event);
+}
+void broadcastShapesF(const ShapeOp op, const float *s, const float *v, float *out, const unsigned int r, const unsigned int c, const BroadcastAxis axis)
+{
+    cl_event event;
+    broadcastShapesFAsync(op, s, v, out, r, c, axis, 0, NULL, &event);
+    finishEvent(event);
+}
+DeviceShapeF *scalarDeviceShapesFAsync(const ShapeOp op, const DeviceShapeF *s, const float k, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    DeviceShapeF *out = createDeviceShapeFAsync(NULL, s->r, s->c, 0, NULL, NULL);
+    profileOp("scalarDeviceShapesF", s->r, s->c);
+    enqueueScalarShapesF(&gpu.kernels, s->buffer, k, out->buffer, s->r * s->c, op, num_events, wait_list, event);
+    return out;
+}
+DeviceShapeF *scalarDeviceShapesF(const ShapeOp op, const DeviceShapeF *s, const float k)
+{
+    return scalarDeviceShapesFAsync(op, s, k, 0, NULL, NULL);
+}
+DeviceShapeF *broadcastDeviceShapesFAsync(const ShapeOp op, const DeviceShapeF *s, const DeviceShapeF *v, const BroadcastAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    DeviceShapeF *out = createDeviceShapeFAsync(NULL, s->r, s->c, 0, NULL, NULL);
+    profileOp("broadcastDeviceShapesF", s->r, s->c);
+    enqueueBroadcastShapesF(&gpu.kernels, s->buffer, v->buffer, out->buffer, s->r, s->c, axis, op, num_events, wait_list, event);
+    return out;
+}
+DeviceShapeF *broadcastDeviceShapesF(const ShapeOp op, const DeviceShapeF *s, const DeviceShapeF *v, const BroadcastAxis axis)
+{
+    return broadcastDeviceShapesFAsync(op, s, v, axis, 0, NULL, NULL);
+}
+/*!
+    @brief Gives the number of results a reduction of an r by c shape along an axis has
+*/
+static unsigned int reduceLines(const unsigned int r, const unsigned int c, const ReduceAxis axis)
+{
+    return axis == REDUCE_ALL ? 1 : axis == REDUCE_ROWS ? r : c;
+}
+/*!
+    @brief Queues one reduction of an r by c buffer, op is a ReduceOp or REDUCE_DOT and shift must hold the largest element of every line for REDUCE_LOG_SUM_EXP
+
+    @details
+    The first pass splits every line over several work groups, or every column over several work items, when there are too few lines to fill the GPU and writes one partial result for each part.
+    The second pass combines the parts of every line into out.
+*/
+static void enqueueReducePass(const Kernels *kernels, cl_mem s, cl_mem s2, cl_mem shift, cl_mem out, const unsigned int r, const unsigned int c, const cl_uint op, const ReduceAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    const unsigned int lines = reduceLines(r, c, axis);
+    const unsigned int length = axis == REDUCE_ALL ? r * c : axis == REDUCE_ROWS ? c : r;
+    size_t localSize = 1;
+    unsigned int max_splits = (length + REDUCE_COLUMN_MIN_ROWS - 1) / REDUCE_COLUMN_MIN_ROWS;
+    unsigned int splits = (gpu.computeUnits * REDUCE_COLUMN_ITEMS_PER_UNIT + lines - 1) / lines;
+    if (axis != REDUCE_COLUMNS)
+    {
+        while (localSize * 2 <= gpu.maxWorkGroupSize && localSize * 2 <= 256 && localSize < length)
+        {
+            localSize *= 2;
+        }
+        max_splits = (length + localSize * 4 - 1) / (localSize * 4);
+        splits = (gpu.computeUnits * REDUCE_GROUPS_PER_UNIT + lines - 1) / lines;
+    }
+    splits = splits > max_splits ? max_splits : splits;
+    splits = splits < 1 ? 1 : splits;
+    unsigned int chunk = (length + splits - 1) / splits;
+    chunk = chunk < 1 ? 1 : chunk;
+    splits = length > 0 ? (length + chunk - 1) / chunk : 1;
+    cl_mem partials = acquireBuffer(kernels->accumulatorSize * lines * splits);
+    cl_mem indices = acquireBuffer(sizeof(cl_uint) * lines * splits);
+    if (axis == REDUCE_COLUMNS)
+    {
+        gpu.err = setKernelArg(kernels->reduceColumnsFKernel, 0, sizeof(cl_mem), &s);
+        gpu.err = setKernelArg(kernels->reduceColumnsFKernel, 1, sizeof(cl_mem), &s2);
+        gpu.err = setKernelArg(kernels->reduceColumnsFKernel, 2, sizeof(cl_mem), &shift);
+        gpu.err = setKernelArg(kernels->reduceColumnsFKernel, 3, sizeof(cl_mem), &partials);
+        gpu.err = setKernelArg(kernels->reduceColumnsFKernel, 4, sizeof(cl_mem), &indices);
+        gpu.err = setKernelArg(kernels->reduceColumnsFKernel, 5, sizeof(const unsigned int), &r);
+        gpu.err = setKernelArg(kernels->reduceColumnsFKernel, 6, sizeof(const unsigned int), &c);
+        gpu.err = setKernelArg(kernels->reduceColumnsFKernel, 7, sizeof(const unsigned int), &chunk);
+        gpu.err = setKernelArg(kernels->reduceColumnsFKernel, 8, sizeof(const cl_uint), &op);
+        const size_t global_work_size[2] = {c, splits};
+        enqueueKernel(kernels->reduceColumnsFKernel, 2, global_work_size, NULL, num_events, wait_list, NULL);
+    }
+    else
+    {
+        gpu.err = setKernelArg(kernels->reduceFKernel, 0, sizeof(cl_mem), &s);
+        gpu.err = setKernelArg(kernels->reduceFKernel, 1, sizeof(cl_mem), &s2);
+        gpu.err = setKernelArg(kernels->reduceFKernel, 2, sizeof(cl_mem), &shift);
+        gpu.err = setKernelArg(kernels->reduceFKernel, 3, sizeof(cl_mem), &partials);
+        gpu.err = setKernelArg(kernels->reduceFKernel, 4, sizeof(cl_mem), &indices);
+        gpu.err = setKernelArg(kernels->reduceFKernel, 5, kernels->accumulatorSize * localSize, NULL);
+        gpu.err = setKernelArg(kernels->reduceFKernel, 6, sizeof(cl_uint) * localSize, NULL);
+        gpu.err = setKernelArg(kernels->reduceFKernel, 7, sizeof(const unsigned int), &length);
+        gpu.err = setKernelArg(kernels->reduceFKernel, 8, sizeof(const unsigned int), &chunk);
+        gpu.err = setKernelArg(kernels->reduceFKernel, 9, sizeof(const cl_uint), &op);
+        const size_t global_work_size[2] = {localSize * splits, lines};
+        const size_t local_work_size[2] = {localSize, 1};
+        enqueueKernel(kernels->reduceFKernel, 2, global_work_size, local_work_size, num_events, wait_list, NULL);
+    }
+    gpu.err = setKernelArg(kernels->reduceFinalFKernel, 0, sizeof(cl_mem), &partials);
+    gpu.err = setKernelArg(kernels->reduceFinalFKernel, 1, sizeof(cl_mem), &indices);
+    gpu.err = setKernelArg(kernels->reduceFinalFKernel, 2, sizeof(cl_mem), &shift);
+    gpu.err = setKernelArg(kernels->reduceFinalFKernel, 3, sizeof(cl_mem), &out);
+    gpu.err = setKernelArg(kernels->reduceFinalFKernel, 4, sizeof(const unsigned int), &lines);
+    gpu.err = setKernelArg(kernels->reduceFinalFKernel, 5, sizeof(const unsigned int), &splits);
+    gpu.err = setKernelArg(kernels->reduceFinalFKernel, 6, sizeof(const cl_uint), &op);
+    const size_t finalLocalSize[1] = {32};
+    const size_t finalGlobalSize[1] = {(lines + finalLocalSize[0] - 1) / finalLocalSize[0] * finalLocalSize[0]};
+    enqueueKernel(kernels->reduceFinalFKernel, 1, finalGlobalSize, finalLocalSize, 0, NULL, event);
+    releaseBuffer(partials);
+    releaseBuffer(indices);
+}
+/*!
+    @brief Queues a reduction of an r by c buffer into out, REDUCE_LOG_SUM_EXP first finds the largest element of every line so the exponentials cannot overflow
+*/
+static void enqueueReduce(const Kernels *kernels, cl_mem s, cl_mem s2, cl_mem out, const unsigned int r, const unsigned int c, const cl_uint op, const ReduceAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (reduceLines(r, c, axis) == 0)
+    {
+        if (event != NULL)
+        {
+            gpu.err = clEnqueueMarkerWithWaitList(gpu.queue, num_events, wait_list, event);
+        }
+        return;
+    }
+    if (op != REDUCE_LOG_SUM_EXP)
+    {
+        enqueueReducePass(kernels, s, s2, s, out, r, c, op, axis, num_events, wait_list, event);
+        return;
+    }
+    cl_mem shift = acquireBuffer(kernels->elementSize * reduceLines(r, c, axis));
+    enqueueReducePass(kernels, s, s2, s, shift, r, c, REDUCE_MAX, axis, num_events, wait_list, NULL);
+    enqueueReducePass(kernels, s, s2, shift, out, r, c, REDUCE_LOG_SUM_EXP, axis, 0, NULL, event);
+    releaseBuffer(shift);
+}
+/*!
+    @brief Reduces a host shape, or the products of the elements of two host shapes when s2 is not NULL, on the GPU or the CPU backend without waiting for it
+*/
+static void reduceAsync(const char *op_name, const float *s1, const float *s2, float *out, const unsigned int r, const unsigned int c, const cl_uint op, const ReduceAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    if (recordingHostOp(event))
+    {
+        return;
+    }
+    const unsigned int lines = reduceLines(r, c, axis);
+    const size_t size = sizeof(float) * r * c;
+    if (size == 0 || useCpu(&gpu.kernels, &gpu.costs.gpuElementwiseRate, &gpu.costs.cpuElementwiseRate, (double)r * c, s2 != NULL ? 2 : 1, copiedBytes(s1, size) + (s2 != NULL ? copiedBytes(s2, size) : 0), copiedBytes(out, sizeof(float) * lines)))
+    {
+        cpuWaitEvents(num_events, wait_list);
+        cpuReduceF(op, axis, s1, s2, out, r, c);
+        cpuCompleteEvent(event);
+        return;
+    }
+    profileOp(op_name, r, c);
+    cl_mem buffer1 = uploadBuffer(s1, size, num_events, wait_list);
+    cl_mem buffer2 = s2 != NULL ? uploadBuffer(s2, size, 0, NULL) : buffer1;
+    cl_mem buffer3 = outputBuffer(out, sizeof(float) * lines, 0, NULL);
+    enqueueReduce(&gpu.kernels, buffer1, buffer2, buffer3, r, c, op, axis, 0, NULL, NULL);
+    downloadBuffer(buffer3, out, sizeof(float) * lines, event);
+
+    releaseBuffer(buffer1);
+    if (s2 != NULL)
+    {
+        releaseBuffer(buffer2);
+    }
+    releaseBuffer(buffer3);
+}
+void reduceShapeFAsync(const float *s, float *out, const unsigned int r, const unsigned int c, const ReduceOp op, const ReduceAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    reduceAsync("reduceShapeF", s, NULL, out, r, c, op, axis, num_events, wait_list, event);
+}
+void reduceShapeF(const float *s, float *out, const unsigned int r, const unsigned int c, const ReduceOp op, const ReduceAxis axis)
+{
+    cl_event event;
+    reduceShapeFAsync(s, out, r, c, op, axis, 0, NULL, &event);
+    finishEvent(event);
+}
+void dotVectorsFAsync(const float *s1, const float *s2, float *out, const unsigned int r, const unsigned int c, const ReduceAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    reduceAsync("dotVectorsF", s1, s2, out, r, c, REDUCE_DOT, axis, num_events, wait_list, event);
+}
+void dotVectorsF(const float *s1, const float *s2, float *out, const unsigned int r, const unsigned int c, const ReduceAxis axis)
+{
+    cl_event event;
+    dotVectorsFAsync(s1, s2, out, r, c, axis, 0, NULL, &event);
+    finishEvent(event);
+}
+DeviceShapeF *reduceDeviceShapeFAsync(const DeviceShapeF *s, const ReduceOp op, const ReduceAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    DeviceShapeF *out = createDeviceShapeFAsync(NULL, 1, reduceLines(s->r, s->c, axis), 0, NULL, NULL);
+    profileOp("reduceDeviceShapeF", s->r, s->c);
+    enqueueReduce(&gpu.kernels, s->buffer, s->buffer, out->buffer, s->r, s->c, op, axis, num_events, wait_list, event);
+    return out;
+}
+DeviceShapeF *reduceDeviceShapeF(const DeviceShapeF *s, const ReduceOp op, const ReduceAxis axis)
+{
+    return reduceDeviceShapeFAsync(s, op, axis, 0, NULL, NULL);
+}
+DeviceShapeF *dotDeviceVectorsFAsync(const DeviceShapeF *s1, const DeviceShapeF *s2, const ReduceAxis axis, cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+    DeviceShapeF *out = createDeviceShapeFAsync(NULL, 1, reduceLines(s1->r, s1->c, axis), 0, NULL, NULL);
+    profileOp("dotDeviceVectorsF", s1->r, s1->c);
+    enqueueReduce(&gpu.kernels, s1->buffer, s2->buffer, out->buffer, s1->r, s1->c, REDUCE_DOT, axis, num_events, wait_list, event);
+    return out;
+}
+DeviceShapeF *dotDeviceVectorsF(const DeviceShapeF *s1, const DeviceShapeF *s2, const ReduceAxis axis)
+{
+    return dotDeviceVectorsFAsync(s1, s2, axis, 0, NULL, NULL);
+}
+float *createAlignedShapeF(const unsigned int n, const float fill_val)
+{
+    const size_t size = (sizeof(float) * n + ZERO_COPY_ALIGNMENT - 1) / ZERO_COPY_ALIGNMENT * ZERO_COPY_ALIGNMENT;
+#ifdef _WIN32
+    float *s1 = _aligned_malloc(size, ZERO_COPY_ALIGNMENT);
+#else
+    float *s1 = aligned_alloc(ZERO_COPY_ALIGNMENT, size);
+#endif
+    if (s1 == NULL)
+    {
+        return NULL;
+    }
+    for (size_t i = 0; i < size / sizeof(float); i++)
+    {
+        s1[i] = i < n ? fill_val : 0.0f;
+    }
+    return s1;
+}
+void freeAlignedShapeF(float *s)
+{
+#ifdef _WIN32
+    _aligned_free(s);
+#else
+    free(s);
+#endif
+}
+float *createShapeF(const unsigned int n, const float fill_val)
+{
+    size_t size = sizeof(float) * n;
+    float *s1 = malloc(size);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        s1[i] = fill_val;
+    }
+    return s1;
+}
+/*!
+    @brief Gives the bytes in one element of a matrix file
+*/
+static size_t matrixElementSize(const MatrixType type)
+{
+    return type == MATRIX_DOUBLE ? sizeof(cl_double) : type == MATRIX_HALF ? sizeof(cl_half) : sizeof(cl_float);
+}
+/*!
+    @brief Writes zeros to a file until it is a multiple of the matrix file alignment long
+*/
+static int padMatrixFile(FILE *file, const size_t written)
+{
+    static const unsigned char zeros[MATRIX_FILE_ALIGNMENT] = {0};
+    const size_t padding = (MATRIX_FILE_ALIGNMENT - written % MATRIX_FILE_ALIGNMENT) % MATRIX_FILE_ALIGNMENT;
+    return fwrite(zeros, 1, padding, file) == padding;
+}
+int saveMatrixFile(const char *path, const void *s, const MatrixType type, const unsigned int r, const unsigned int c)
+{
+    MatrixFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+    header.version = MATRIX_FILE_VERSION;
+    header.byteOrder = MATRIX_FILE_BYTE_ORDER;
+    header.type = type;
+    header.rows = r;
+    header.cols = c;
+    header.alignment = MATRIX_FILE_ALIGNMENT;
+    header.dataOffset = MATRIX_FILE_ALIGNMENT;
+    header.dataBytes = matrixElementSize(type) * r * c;
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        return 0;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 && padMatrixFile(file, sizeof(header));
+    ok = ok && fwrite(s, 1, header.dataBytes, file) == header.dataBytes && padMatrixFile(file, header.dataBytes);
+    return fclose(file) == 0 && ok;
+}
+/*!
+    @brief Checks that the header of a mapped file is one this version reads and that the elements it points to are inside the file and page aligned
+*/
+static int validMatrixFile(const MatrixFileHeader *header, const size_t size)
+{
+    return memcmp(header->magic, MATRIX_FILE_MAGIC, sizeof(header->magic)) == 0 && header->version == MATRIX_FILE_VERSION && header->byteOrder == MATRIX_FILE_BYTE_ORDER && header->type <= MATRIX_HALF && header->dataOffset % MATRIX_FILE_ALIGNMENT == 0 && header->dataBytes == matrixElementSize(header->type) * header->rows * header->cols && header->dataOffset <= size && header->dataBytes <= size - header->dataOffset;
+}
+MatrixFile *mapMatrixFile(const char *path)
+{
+    void *mapping = NULL;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) && (size_t)file_size.QuadPart >= sizeof(MatrixFileHeader))
+    {
+        size = (size_t)file_size.QuadPart;
+        /* A copy on write view lets shapes made from the file be changed without changing the file */
+        HANDLE map = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if (map != NULL)
+        {
+            mapping = MapViewOfFile(map, FILE_MAP_COPY, 0, 0, 0);
+            CloseHandle(map);
+        }
+    }
+    CloseHandle(file);
+#else
+    const int file = open(path, O_RDONLY);
+    if (file < 0)
+    {
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(file, &info) == 0 && (size_t)info.st_size >= sizeof(MatrixFileHeader))
+    {
+        size = (size_t)info.st_size;
+        /* A private mapping lets shapes made from the file be changed without changing the file */
+        mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+        mapping = mapping == MAP_FAILED ? NULL : mapping;
+    }
+    close(file);
+#endif
+    if (mapping == NULL)
+    {
+        return NULL;
+    }
+    MatrixFile *m = malloc(sizeof(MatrixFile));
+    m->mapping = mapping;
+    m->size = size;
+    memcpy(&m->header, mapping, sizeof(MatrixFileHeader));
+    if (!validMatrixFile(&m->header, size))
+    {
+        unmapMatrixFile(m);
+        return NULL;
+    }
+    return m;
+}
+void *getMatrixFileData(const MatrixFile *file)
+{
+    return (char *)file->mapping + file->header.dataOffset;
+}
+void getMatrixFileInfo(const MatrixFile *file, MatrixType *type, unsigned int *r, unsigned int *c)
+{
+    *type = (MatrixType)file->header.type;
+    *r = file->header.rows;
+    *c = file->header.cols;
+}
+DeviceShapeF *createDeviceShapeFromFileF(const MatrixFile *file)
+{
+    if (file->header.type != MATRIX_FLOAT)
+    {
+        return NULL;
+    }
+    const unsigned int r = file->header.rows;
+    const unsigned int c = file->header.cols;
+    void *data = getMatrixFileData(file);
+    /* The padding after the elements is part of the file, so the whole padded range can be wrapped */
+    const size_t padded = (size_t)(file->header.dataBytes + MATRIX_FILE_ALIGNMENT - 1) / MATRIX_FILE_ALIGNMENT * MATRIX_FILE_ALIGNMENT;
+    if (padded <= file->size - file->header.dataOffset && canWrapHostPtr(data, padded))
+    {
+        cl_mem buffer = createBuffer(CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, padded, data);
+        if (gpu.err == CL_SUCCESS)
+        {
+            profileOp("createDeviceShapeFromFileF", r, c);
+            DeviceShapeF *d = malloc(sizeof(DeviceShapeF));
+            d->buffer = buffer;
+            d->r = r;
+            d->c = c;
+            return d;
+        }
+    }
+    return createDeviceShapeF(data, r, c);
+}
+void unmapMatrixFile(MatrixFile *file)
+{
+    if (file == NULL)
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(file->mapping);
+#else
+    munmap(file->mapping, file->size);
+#endif
+    free(file);
+}
+/*!
+    @brief Tries to make a program from a binary in the kernel cache
+
+    @returns The built program or NULL if the binary is missing, stale or does not build
+*/
+static cl_program loadCachedProgram(const char *path, const uint64_t key, const char *options)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    char magic[4];
+    uint64_t file_key;
+    uint64_t size;
+    unsigned char *binary = NULL;
+    if (fread(magic, 1, 4, file) == 4 && memcmp(magic, "LACB", 4) == 0 &&
+        fread(&file_key, sizeof(uint64_t), 1, file) == 1 && file_key == key &&
+        fread(&size, sizeof(uint64_t), 1, file) == 1 && size > 0)
+    {
+        binary = malloc(size);
+        if (binary != NULL && fread(binary, 1, size, file) != size)
+        {
+            free(binary);
+            binary = NULL;
+        }
+    }
+    fclose(file);
+    if (binary == NULL)
+    {
+        return NULL;
+    }
+    const size_t binary_size = size;
+    cl_int binary_status;
+    cl_program program = clCreateProgramWithBinary(gpu.context, 1, &gpu.device, &binary_size, (const unsigned char **)&binary, &binary_status, &gpu.err);
+    free(binary);
+    if (gpu.err != CL_SUCCESS || binary_status != CL_SUCCESS)
+    {
+        if (program != NULL)
+        {
+            clReleaseProgram(program);
+        }
+        return NULL;
+    }
+    gpu.err = clBuildProgram(program, 1, &gpu.device, options, NULL, NULL);
+    if (gpu.err != CL_SUCCESS)
+    {
+        clReleaseProgram(program);
+        return NULL;
+    }
+    return program;
+}
+/*!
+    @brief Writes the binary of a built program to the kernel cache
+
+    @details
+    The binary is written to a temporary file which is then renamed so that other processes never load a half written binary.
+*/
+static void saveCachedProgram(cl_program program, const char *path, const uint64_t key)
+{
+    size_t binary_size = 0;
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binary_size, NULL) != CL_SUCCESS || binary_size == 0)
+    {
+        return;
+    }
+    unsigned char *binary = malloc(binary_size);
+    if (binary == NULL)
+    {
+        return;
+    }
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char *), &binary, NULL) == CL_SUCCESS)
+    {
+        char temp_path[1100];
+        snprintf(temp_path, sizeof(temp_path), "%s.%lx%p.tmp", path, (unsigned long)time(NULL), (void *)binary);
+        FILE *file = fopen(temp_path, "wb");
+        if (file != NULL)
+        {
+            const uint64_t size = binary_size;
+            const int written = fwrite("LACB", 1, 4, file) == 4 &&
+                                fwrite(&key, sizeof(uint64_t), 1, file) == 1 &&
+                                fwrite(&size, sizeof(uint64_t), 1, file) == 1 &&
+                                fwrite(binary, 1, binary_size, file) == binary_size;
+            if (fclose(file) == 0 && written)
+            {
+                /* rename does not replace an existing file on Windows */
+                if (rename(temp_path, path) != 0 && (remove(path) != 0 || rename(temp_path, path) != 0))
+                {
+                    remove(temp_path);
+                }
+            }
+            else
+            {
+                remove(temp_path);
+            }
+        }
+    }
+    free(binary);
+}
+/*!
+    @brief Keeps the compiler output of a program that failed to build for getBuildLog()
+*/
+static void saveBuildLog(cl_program program)
+{
+    size_t size = 0;
+    if (clGetProgramBuildInfo(program, gpu.device, CL_PROGRAM_BUILD_LOG, 0, NULL, &size) != CL_SUCCESS || size == 0)
+    {
+        return;
+    }
+    char *log = malloc(size);
+    if (log == NULL)
+    {
+        return;
+    }
+    if (clGetProgramBuildInfo(program, gpu.device, CL_PROGRAM_BUILD_LOG, size, log, NULL) != CL_SUCCESS)
+    {
+        free(log);
+        return;
+    }
+    log[size - 1] = '\0';
+    free(gpu.buildLog);
+    gpu.buildLog = log;
+}
+/*!
+    @brief Builds a program for the GPU, loading it from the kernel cache if it has already been built with the same device, driver, options and source
+
+    @details
+    When the cached binary is missing or stale the program is compiled from source and the new binary is saved for next time.
+*/
+static cl_program buildProgram(const char *source, const char *options)
+{
+    const uint64_t key = programKey(source, options);
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/linearalgebra-%016llx.bin", cacheDirectory(), (unsigned long long)key);
+    cl_program program = loadCachedProgram(path, key, options);
+    if (program != NULL)
+    {
+        return program;
+    }
+    program = clCreateProgramWithSource(gpu.context, 1, &source, NULL, &gpu.err);
+    gpu.err = clBuildProgram(program, 1, &gpu.device, options, NULL, NULL);
+    if (gpu.err == CL_SUCCESS)
+    {
+        saveCachedProgram(program, path, key);
+    }
+    else
+    {
+        saveBuildLog(program);
+    }
+    return program;
+}
+ShapeExprF *exprInputF(const unsigned int index)
+{
+    ShapeExprF *e = calloc(1, sizeof(ShapeExprF));
+    e->kind = EXPR_INPUT;
+    e->index = index;
+    return e;
+}
+ShapeExprF *exprScalarF(const float value)
+{
+    ShapeExprF *e = calloc(1, sizeof(ShapeExprF));
+    e->kind = EXPR_SCALAR;
+    e->value = value;
+    return e;
+}
+ShapeExprF *exprOpF(const ShapeOp op, ShapeExprF *a, ShapeExprF *b)
+{
+    ShapeExprF *e = calloc(1, sizeof(ShapeExprF));
+    e->kind = EXPR_OP;
+    e->op = op;
+    e->a = a;
+    e->b = b;
+    return e;
+}
+void freeExprF(ShapeExprF *e)
+{
+    if (e == NULL)
+    {
+        return;
+    }
+    freeExprF(e->a);
+    freeExprF(e->b);
+    free(e);
+}
+/*!
+    @brief A growing string used to generate kernel source
+*/
+typedef struct
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+} Source;
+/*!
+    @brief Appends formatted text to a Source
+*/
+static void appendSource(Source *src, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    const int needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (needed < 0)
+    {
+        return;
+    }
+    if (src->length + needed + 1 > src->capacity)
+    {
+        size_t capacity = src->capacity == 0 ? 256 : src->capacity;
+        while (src->length + needed + 1 > capacity)
+        {
+            capacity *= 2;
+        }
+        char *data = realloc(src->data, capacity);
+        if (data == NULL)
+        {
+            return;
+        }
+        src->data = data;
+        src->capacity = capacity;
+    }
+    va_start(args, format);
+    vsnprintf(src->data + src->length, src->capacity - src->length, format, args);
+    va_end(args);
+    src->length += needed;
+}
+/*!
+    @brief Gives the amount of inputs and scalars an expression uses
+*/
+static void countExprF(const ShapeExprF *e, unsigned int *inputs, unsigned int *scalars)
+{
+    if (e->kind == EXPR_INPUT)
+    {
+        if (e->index + 1 > *inputs)
+        {
+            *inputs = e->index + 1;
+        }
+    }
+    else if (e->kind == EXPR_SCALAR)
+    {
+        (*scalars)++;
+    }
+    else
+    {
+        countExprF(e->a, inputs, scalars);
+        countExprF(e->b, inputs, scalars);
+    }
+}
+/*!
+    @brief Writes an expression as OpenCL C, scalars are numbered in the order they are found so the same order is used to set them as kernel arguments
+*/
+static void appendExprF(Source *src, const ShapeExprF *e, unsigned int *scalar)
+{
+    static const char symbols[4] = {'+', '-', '*', '/'};
+    if (e->kind == EXPR_INPUT)
+    {
+        appendSource(src, "x%u", e->index);
+    }
+    else if (e->kind == EXPR_SCALAR)
+    {
+        appendSource(src, "k%u", (*scalar)++);
+    }
+    else
+    {
+        appendSource(src, "(");
+        appendExprF(src, e->a, scalar);
+        appendSource(src, " %c ", symbols[e->op]);
+        appendExprF(src, e->b, scalar);
+        appendSource(src, ")");
+    }
+}
+/*!
+    @brief Collects the values of the scalars of an expression in the same order appendExprF() numbers them
+*/
+static void collectScalarsF(const ShapeExprF *e, float *values, unsigned int *scalar)
+{
+    if (e->kind == EXPR_SCALAR)
+    {
+        values[(*scalar)++] = e->value;
+    }
+    else if (e->kind == EXPR_OP)
+    {
+        collectScalarsF(e->a, values, scalar);
+        collectScalarsF(e->b, values, scalar);
+    }
+}
+/*!
+    @brief Gives the fused kernel of an expression, generating and building it the first time the expression's shape is seen
+
+    @details
+    Scalars are kernel arguments instead of being written into the source, so expressions that only differ in their scalars share a kernel.
+    Every input is read once into a register before the expression is evaluated.
+*/
+static cl_kernel fusedKernelF(const ShapeExprF *e, const unsigned int inputs, const unsigned int scalars)
+{
+    Source src = {NULL, 0, 0};
+    appendSource(&src, "__kernel void fusedF(");
+    for (unsigned int i = 0; i < inputs; i++)
+    {
+        appendSource(&src, "__global const float *in%u, ", i);
+    }
+    appendSource(&src, "__global float *out, ");
+    for (unsigned int i = 0; i < scalars; i++)
+    {
+        appendSource(&src, "const float k%u, ", i);
+    }
+    appendSource(&src, "const unsigned int n)\n{\n    __private int index = get_global_id(0);\n    if (index < n)\n    {\n");
+    for (unsigned int i = 0; i < inputs; i++)
+    {
+        appendSource(&src, "        __private const float x%u = in%u[index];\n", i, i);
+    }
+    appendSource(&src, "        out[index] = ");
+    unsigned int scalar = 0;
+    appendExprF(&src, e, &scalar);
+    appendSource(&src, ";\n    }\n}\n");
+    if (src.data == NULL)
+    {
+        return NULL;
+    }
+    for (unsigned int i = 0; i < gpu.fusedCount; i++)
+    {
+        if (strcmp(gpu.fusedKernels[i].source, src.data) == 0)
+        {
+            free(src.data);
+            if (gpu.fusedKernels[i].kernel == NULL)
+            {
+                failCommand(CL_BUILD_PROGRAM_FAILURE, NULL);
+            }
+            return gpu.fusedKernels[i].kernel;
+        }
+    }
+    FusedKernel *kernels = realloc(gpu.fusedKernels, sizeof(FusedKernel) * (gpu.fusedCount + 1));
+    if (kernels == NULL)
+    {
+        free(src.data);
+        return NULL;
+    }
+    gpu.fusedKernels = kernels;
+    FusedKernel *fused = &gpu.fusedKernels[gpu.fusedCount];
+    fused->source = src.data;
+    fused->program = buildProgram(src.data, "");
+    fused->kernel = clCreateKernel(fused->program, "fusedF", &gpu.err);
+    if (gpu.err != CL_SUCCESS)
+    {
+        /* The failure is kept so the same expression is not compiled again on every call */
+        recordError(gpu.err);
+        clReleaseProgram(fused->program);
+        fused->program = NULL;
+        fused->kernel = NULL;
+    }
+    gpu.fusedCount++;
+    return fused->kernel;
+}
+/*!
+    @brief Enqueues the fused kernel of an expression on buffers that are already on the GPU
+*/
+static void enqueueExprF(const ShapeExprF *e, const cl_mem *inputs, const unsigned int num_inputs, cl_mem out, const unsigned int n)
+{
+    unsigned int needed_inputs = 0;
+    unsigned int scalars = 0;
+    countExprF(e, &needed_inputs, &scalars);
+    if (needed_inputs > num_inputs)
+    {
+        failCommand(CL_INVALID_VALUE, NULL);
+        return;
+    }
+    cl_kernel kernel = fusedKernelF(e, needed_inputs, scalars);
+    if (kernel == NULL)
+    {
+        return;
+    }
+    float *values = malloc(sizeof(float) * (scalars + 1));
+    unsigned int scalar = 0;
+    collectScalarsF(e, values, &scalar);
+    cl_uint arg = 0;
+    for (unsigned int i = 0; i < needed_inputs; i++)
+    {
+        gpu.err = setKernelArg(kernel, arg++, sizeof(cl_mem), &inputs[i]);
+    }
+    gpu.err = setKernelArg(kernel, arg++, sizeof(cl_mem), &out);
+    for (unsigned int i = 0; i < scalars; i++)
+    {
+        gpu.err = setKernelArg(kernel, arg++, sizeof(float), &values[i]);
+    }
+    gpu.err = setKernelArg(kernel, arg++, sizeof(const unsigned int), &n);
+    free(values);
+    const size_t localSize[1] = {tunedGroup(gpu.tune.elementwiseGroup, n)};
+    const size_t globalSize[1] = {(n + localSize[0] - 1) / localSize[0] * localSize[0]};
+    enqueueKernel(kernel, 1, globalSize, localSize, 0, NULL, NULL);
+}
+void evalExprF(const ShapeExprF *e, const float **inputs, const unsigned int num_inputs, float *out, const unsigned int r, const unsigned int c)
+{
+    if (recordingHostOp(NULL))
+    {
+        return;
+    }
+    if (!gpu.hasDevice)
+    {
+        unsigned int needed_inputs = 0;
+        unsigned int scalars = 0;
+        countExprF(e, &needed_inputs, &scalars);
+        if (needed_inputs > num_inputs)
+        {
+            failCommand(CL_INVALID_VALUE, NULL);
+            return;
+        }
+        cpuExprF(e, inputs, out, (size_t)r * c);
+        return;
+    }
+    profileOp("evalExprF", r, c);
+    const unsigned int vals = r * c;
+    const size_t size = sizeof(float) * vals;
+    cl_mem *buffers = malloc(sizeof(cl_mem) * (num_inputs + 1));
+    for (unsigned int i = 0; i < num_inputs; i++)
+    {
+        buffers[i] = uploadBuffer(inputs[i], size, 0, NULL);
+    }
+    cl_mem buffer = outputBuffer(out, size, num_inputs, buffers);
+    enqueueExprF(e, buffers, num_inputs, buffer, vals);
+    cl_event event;
+    downloadBuffer(buffer, out, size, &event);
+    finishEvent(event);
+    for (unsigned int i = 0; i < num_inputs; i++)
+    {
+        releaseBuffer(buffers[i]);
+    }
+    releaseBuffer(buffer);
+    free(buffers);
+}
+DeviceShapeF *evalDeviceExprF(const ShapeExprF *e, const DeviceShapeF **inputs, const unsigned int num_inputs)
+{
+    if (num_inputs == 0)
+    {
+        failCommand(CL_INVALID_VALUE, NULL);
+        return NULL;
+    }
+    /* The kernel reads the same element of every input, so they must all have the shape of the output */
+    for (unsigned int i = 1; i < num_inputs; i++)
+    {
+        if (inputs[i]->r != inputs[0]->r || inputs[i]->c != inputs[0]->c)
+        {
+            failCommand(CL_INVALID_VALUE, NULL);
+            return NULL;
+        }
+    }
+    cl_mem *buffers = malloc(sizeof(cl_mem) * num_inputs);
+    for (unsigned int i = 0; i < num_inputs; i++)
+    {
+        buffers[i] = inputs[i]->buffer;
+    }
+    DeviceShapeF *out = createDeviceShapeFAsync(NULL, inputs[0]->r, inputs[0]->c, 0, NULL, NULL);
+    enqueueExprF(e, buffers, num_inputs, out->buffer, out->r * out->c);
+    free(buffers);
+    return out;
+}
+/*!
+    @brief Creates the kernels of one build of kernel_code
+*/
+static void createKernels(cl_program program, const size_t element_size, const size_t accumulator_size, const unsigned int vector_width, const unsigned int dot_tile, const unsigned int dot_work, Kernels *kernels)
+{
+    kernels->elementSize = element_size;
+    kernels->accumulatorSize = accumulator_size;
+    kernels->vectorWidth = vector_width;
+    kernels->dotTile = dot_tile;
+    kernels->dotWork = dot_work;
+    kernels->addFKernel = clCreateKernel(program, "addShapesF", &gpu.err);
+    kernels->subtractFKernel = clCreateKernel(program, "subtractShapesF", &gpu.err);
+    kernels->crossFKernel = clCreateKernel(program, "crossShapesF", &gpu.err);
+    kernels->divideFKernel = clCreateKernel(program, "divideShapesF", &gpu.err);
+    kernels->dotFKernel = clCreateKernel(program, "dotMatricesF", &gpu.err);
+    kernels->matVecFkernel = clCreateKernel(program, "MatrixFMulVecF", &gpu.err);
+    kernels->matVecSumFKernel = clCreateKernel(program, "MatrixFMulVecSumF", &gpu.err);
+    kernels->matVecTransposedFKernel = clCreateKernel(program, "MatrixFMulVecTransposedF", &gpu.err);
+    kernels->dot4x4FKernel = clCreateKernel(program, "dotMatrices4x4F", &gpu.err);
+    kernels->dot16x16FKernel = clCreateKernel(program, "dotMatrices16x16F", &gpu.err);
+    kernels->matVec4x4FKernel = clCreateKernel(program, "MatrixFMulVec4x4F", &gpu.err);
+    kernels->reduceFKernel = clCreateKernel(program, "reduceF", &gpu.err);
+    kernels->reduceColumnsFKernel = clCreateKernel(program, "reduceColumnsF", &gpu.err);
+    kernels->reduceFinalFKernel = clCreateKernel(program, "reduceFinalF", &gpu.err);
+    kernels->scalarFKernel = clCreateKernel(program, "scalarShapesF", &gpu.err);
+    kernels->broadcastFKernel = clCreateKernel(program, "broadcastShapesF", &gpu.err);
+    kernels->csrMatVecFKernel = clCreateKernel(program, "csrMatVecF", &gpu.err);
+    kernels->csrDotFKernel = clCreateKernel(program, "csrDotMatricesF", &gpu.err);
+}
+/*!
+    @brief Picks the vector width of the elementwise kernels for a precision from the preferred vector width of the GPU
+
+    @details
+    GPUs which prefer scalars still get 4 wide vectors because 16 byte loads and stores use the memory bus better than single elements.
+*/
+static unsigned int vectorWidth(const cl_device_info param)
+{
+    cl_uint preferred = 1;
+    gpu.err = clGetDeviceInfo(gpu.device, param, sizeof(cl_uint), &preferred, NULL);
+    return preferred >= 8 ? 8 : 4;
+}
+/*!
+    @brief Releases the kernels made by createKernels()
+*/
+static void releaseKernels(Kernels *kernels)
 {
-    if (gpu.err != CL_SUCCESS)
+    clReleaseKernel(kernels->addFKernel);
+    clReleaseKernel(kernels->subtractFKernel);
+    clReleaseKernel(kernels->crossFKernel);
+    clReleaseKernel(kernels->divideFKernel);
+    clReleaseKernel(kernels->dotFKernel);
+    clReleaseKernel(kernels->matVecFkernel);
+    clReleaseKernel(kernels->matVecSumFKernel);
+    clReleaseKernel(kernels->matVecTransposedFKernel);
+    clReleaseKernel(kernels->dot4x4FKernel);
+    clReleaseKernel(kernels->dot16x16FKernel);
+    clReleaseKernel(kernels->matVec4x4FKernel);
+    clReleaseKernel(kernels->reduceFKernel);
+    clReleaseKernel(kernels->reduceColumnsFKernel);
+    clReleaseKernel(kernels->reduceFinalFKernel);
+    clReleaseKernel(kernels->scalarFKernel);
+    clReleaseKernel(kernels->broadcastFKernel);
+    clReleaseKernel(kernels->csrMatVecFKernel);
+    clReleaseKernel(kernels->csrDotFKernel);
+    memset(kernels, 0, sizeof(Kernels));
+}
+/*!
+    @brief Operations tuneKernels() times
+*/
+typedef enum
+{
+    TUNE_ADD,
+    TUNE_DOT,
+    TUNE_MATVEC
+} TuneOp;
+/*!
+    @brief Elements in the operations that time each size class, one in the middle of each class
+*/
+static const size_t tuneElements[TUNE_SIZE_CLASSES] = {1 << 14, 1 << 18, CALIBRATION_ELEMENTS};
+/*!
+    @brief Checks if the tiled dot product kernel can be built with some tile sizes on the current GPU
+
+    @details
+    The work group has to fit on the GPU, every work item has to load the same amount of both tiles and the tiles have to fit in local memory.
+*/
+static int validDotTile(const unsigned int tile, const unsigned int tile_k, const unsigned int work)
+{
+    cl_ulong local_mem_size = 0;
+    gpu.err = clGetDeviceInfo(gpu.device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &local_mem_size, NULL);
+    if (work == 0 || tile % work != 0)
     {
-        printf("Error code: %i \n", gpu.err);
-        exit(1);
+        return 0;
     }
+    const unsigned int threads = (tile / work) * (tile / work);
+    return threads <= gpu.maxWorkGroupSize && (tile_k * tile) % threads == 0 && sizeof(cl_float) * tile_k * (2 * tile + 2) <= local_mem_size;
 }
-void addShapesF(float **base_s1, float **base_s2, float **base_s3, unsigned int r, unsigned int c)
+/*!
+    @brief Tile sizes of the dot product kernel as {tile, tileK, work} that tuneConfig() tries, the first one is the default
+*/
+static const unsigned int dotTiles[DOT_TILE_CONFIGS][3] = {{DOT_TILE_M, DOT_TILE_K, DOT_WORK_M}, {32, 16, 2}, {32, 16, 4}, {64, 8, 4}, {64, 16, 8}, {128, 16, 8}, {128, 8, 8}};
+/*!
+    @brief Gives the settings the kernels use before the device is tuned
+
+    @details
+    The dot product tile is the first one of dotTiles whose work group fits on the GPU, so devices with small work groups can run the tiled kernel without being tuned.
+*/
+static void defaultTuneConfig(TuneConfig *config)
 {
-    const size_t old_size = sizeof(float) * r * c;
-    if (r == 1)
+    memset(config, 0, sizeof(TuneConfig));
+    config->vectorWidth = vectorWidth(CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT);
+    config->dotTile = DOT_TILE_M;
+    config->dotTileK = DOT_TILE_K;
+    config->dotWork = DOT_WORK_M;
+    for (unsigned int i = 0; i < DOT_TILE_CONFIGS; i++)
     {
-        if (c < 32)
+        if (validDotTile(dotTiles[i][0], dotTiles[i][1], dotTiles[i][2]))
         {
-            c = 32;
-        }
-        else if (c < 64 && c > 32)
-        {
-            c = 64;
-        }
-        else if (c < 128 && c > 64)
-        {
-            c = 128;
-        }
-        else if (c < 256 && c > 128)
-        {
-            c = 256;
+            config->dotTile = dotTiles[i][0];
+            config->dotTileK = dotTiles[i][1];
+            config->dotWork = dotTiles[i][2];
+            break;
         }
     }
-    else if (c == 1)
+    for (unsigned int i = 0; i < TUNE_SIZE_CLASSES; i++)
     {
-        if (r < 32)
-        {
-            r = 32;
-        }
-        else if (r < 64 && r > 32)
-        {
-            r = 64;
-        }
-        else if (r < 128 && r > 64)
-        {
-            r = 128;
-        }
-        else if (r < 256 && r > 128)
-        {
-            r = 256;
-        }
+        config->elementwiseGroup[i] = DEFAULT_ELEMENTWISE_GROUP;
+        config->matVecGroup[i] = DEFAULT_MATVEC_GROUP;
     }
-    else
+}
+/*!
+    @brief Checks if vector width is one OpenCL has vload and vstore functions for
+*/
+static int validVectorWidth(const unsigned int width)
+{
+    return width == 2 || width == 4 || width == 8 || width == 16;
+}
+/*!
+    @brief Gives the names and fields of a tuned config in the order they are saved in
+*/
+static unsigned int tuneFields(TuneConfig *config, const char **names, unsigned int **fields)
+{
+    const char *field_names[TUNE_CONFIG_FIELDS] = {"vectorWidth", "dotTile", "dotTileK", "dotWork", "elementwiseGroupSmall", "elementwiseGroupMedium", "elementwiseGroupLarge", "matVecGroupSmall", "matVecGroupMedium", "matVecGroupLarge"};
+    unsigned int *field_values[TUNE_CONFIG_FIELDS] = {&config->vectorWidth, &config->dotTile, &config->dotTileK, &config->dotWork, &config->elementwiseGroup[0], &config->elementwiseGroup[1], &config->elementwiseGroup[2], &config->matVecGroup[0], &config->matVecGroup[1], &config->matVecGroup[2]};
+    for (unsigned int i = 0; i < TUNE_CONFIG_FIELDS; i++)
     {
-        if (c < 32)
-        {
-            c = 32;
-        }
-        else if (c < 64 && c > 32)
-        {
-            c = 64;
-        }
-        else if (c < 128 && c > 64)
-        {
-            c = 128;
-        }
-        else if (c < 256 && c > 128)
-        {
-            c = 256;
-        }
-        if (r < 32)
-        {
-            r = 32;
-        }
-        else if (r < 64 && r > 32)
-        {
-            r = 64;
-        }
-        else if (r < 128 && r > 64)
-        {
-            r = 128;
-        }
-        else if (r < 256 && r > 128)
-        {
-            r = 256;
-        }
+        names[i] = field_names[i];
+        fields[i] = field_values[i];
     }
-    const size_t size = sizeof(float) * r * c;
-    *base_s1 = realloc(*base_s1, size);
-    *base_s2 = realloc(*base_s2, size);
-    *base_s3 = realloc(*base_s3, size);
-    gpu.buffers.s1 = clCreateBuffer(gpu.context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, size, NULL, &gpu.err);
-    gpu.buffers.s2 = clCreateBuffer(gpu.context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, size, NULL, &gpu.err);
-    gpu.buffers.s3 = clCreateBuffer(gpu.context, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR, size, NULL, &gpu.err);
-    gpu.err = clEnqueueWriteBuffer(gpu.queue, gpu.buffers.s1, CL_TRUE, 0, size, *base_s1, 0, NULL, &gpu.events.s1Write);
-    gpu.err = clEnqueueWriteBuffer(gpu.queue, gpu.buffers.s2, CL_TRUE, 0, size, *base_s2, 0, NULL, &gpu.events.s2Write);
-    const cl_event bufferEvents[2] = {gpu.events.s1Write, gpu.events.s2Write};
-    const unsigned int vals = r * c;
-    gpu.err = clWaitForEvents(2, bufferEvents);
-    gpu.err = clSetKernelArg(gpu.kernels.addFKernel, 0, sizeof(cl_mem), &gpu.buffers.s1);
-    gpu.err = clSetKernelArg(gpu.kernels.addFKernel, 1, sizeof(cl_mem), &gpu.buffers.s2);
-    gpu.err = clSetKernelArg(gpu.kernels.addFKernel, 2, sizeof(cl_mem), &gpu.buffers.s3);
-    gpu.err = clSetKernelArg(gpu.kernels.addFKernel, 3, sizeof(const unsigned int), &vals);
-    if (r == 1 || c == 1)
+    return TUNE_CONFIG_FIELDS;
+}
+/*!
+    @brief Gives the path of the saved tuned config, which is keyed by the device, the driver and kernel_code like the kernel cache
+*/
+static void tunePath(char *path, const size_t size)
+{
+    const uint64_t key = programKey(kernel_code, "auto-tuning");
+    snprintf(path, size, "%s/linearalgebra-%016llx.tune", cacheDirectory(), (unsigned long long)key);
+}
+/*!
+    @brief Tries to read a saved tuned config
+
+    @returns 1 if every field was read and the settings can run on the current GPU, in which case config is replaced, otherwise 0 and config is not changed
+*/
+static int loadTuneConfig(TuneConfig *config)
+{
+    char path[1024];
+    tunePath(path, sizeof(path));
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
     {
-        size_t globalSize[1];
-        if (r == 1)
-        {
-            globalSize[0] = c;
-        }
-        else
+        return 0;
+    }
+    TuneConfig loaded = *config;
+    const char *names[TUNE_CONFIG_FIELDS];
+    unsigned int *fields[TUNE_CONFIG_FIELDS];
+    const unsigned int count = tuneFields(&loaded, names, fields);
+    unsigned int found = 0;
+    char name[64];
+    unsigned int value;
+    while (fscanf(file, "%63s %u", name, &value) == 2)
+    {
+        for (unsigned int i = 0; i < count; i++)
         {
-            globalSize[0] = r;
+            if (strcmp(name, names[i]) == 0 && value > 0)
+            {
+                *fields[i] = value;
+                found |= 1u << i;
+            }
         }
-        const size_t localSize[1] = {32};
-        gpu.err = clEnqueueNDRangeKernel(gpu.queue, gpu.kernels.addFKernel, 1, NULL, globalSize, localSize, 0, NULL, &gpu.events.addFEvent);
     }
-    else
+    fclose(file);
+    int valid = found == (1u << count) - 1 && validVectorWidth(loaded.vectorWidth) && validDotTile(loaded.dotTile, loaded.dotTileK, loaded.dotWork);
+    for (unsigned int i = 0; i < TUNE_SIZE_CLASSES; i++)
     {
-        const size_t globalSize[2] = {r, c};
-        const size_t localSize[2] = {32, 32};
-        gpu.err = clEnqueueNDRangeKernel(gpu.queue, gpu.kernels.addFKernel, 1, NULL, globalSize, localSize, 0, NULL, &gpu.events.addFEvent);
+        valid = valid && loaded.elementwiseGroup[i] <= gpu.maxWorkGroupSize && loaded.matVecGroup[i] <= gpu.maxWorkGroupSize;
     }
-    gpu.err = clWaitForEvents(1, &gpu.events.addFEvent);
-    gpu.err = clEnqueueReadBuffer(gpu.queue, gpu.buffers.s3, CL_TRUE, 0, size, *base_s3, 0, NULL, &gpu.events.s3Write);
-    gpu.err = clWaitForEvents(1, &gpu.events.s3Write);
-
-    clReleaseMemObject(gpu.buffers.s1);
-    clReleaseMemObject(gpu.buffers.s2);
-    clReleaseMemObject(gpu.buffers.s3);
-
-    *base_s1 = realloc(*base_s1, old_size);
-    *base_s2 = realloc(*base_s2, old_size);
-    *base_s3 = realloc(*base_s3, old_size);
+    if (!valid)
+    {
+        return 0;
+    }
+    loaded.tuned = 1;
+    *config = loaded;
+    return 1;
 }
-void subtractShapesF(float **base_s1, float **base_s2, float **base_s3, unsigned int r, unsigned int c)
+static void saveTuneConfig(TuneConfig *config)
 {
-    const size_t old_size = sizeof(float) * r * c;
-    if (r == 1)
+    char path[1024];
+    tunePath(path, sizeof(path));
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
     {
-        if (c < 32)
-        {
-            c = 32;
-        }
-        else if (c < 64 && c > 32)
-        {
-            c = 64;
-        }
-        else if (c < 128 && c > 64)
-        {
-            c = 128;
-        }
-        else if (c < 256 && c > 128)
-        {
-            c = 256;
-        }
+        return;
     }
-    else if (c == 1)
+    const char *names[TUNE_CONFIG_FIELDS];
+    unsigned int *fields[TUNE_CONFIG_FIELDS];
+    const unsigned int count = tuneFields(config, names, fields);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        fprintf(file, "%s %u\n", names[i], *fields[i]);
+    }
+    fclose(file);
+}
+/*!
+    @brief Gives the shortest time out of a few runs of an operation on the GPU, or a huge time if it could not be enqueued
+
+    @details
+    The work group sizes are read from gpu.tune as usual, so the caller sets the candidate there first.
+*/
+static double timeTuned(const Kernels *kernels, const TuneOp op, cl_mem buffer1, cl_mem buffer2, cl_mem buffer3, const size_t n)
+{
+    double best = 1e30;
+    for (int i = 0; i < CALIBRATION_RUNS; i++)
     {
-        if (r < 32)
+        const double start = now();
+        if (op == TUNE_ADD)
         {
-            r = 32;
+            enqueueShapesF(kernels, kernels->addFKernel, buffer1, buffer2, buffer3, (unsigned int)n, 0, NULL, NULL);
         }
-        else if (r < 64 && r > 32)
+        else if (op == TUNE_DOT)
         {
-            r = 64;
+            enqueueDotMatrices(kernels, buffer1, buffer2, buffer3, CALIBRATION_DOT_SIZE, CALIBRATION_DOT_SIZE, CALIBRATION_DOT_SIZE, 1, 0, 0, 0, NULL, 0, NULL, NULL);
         }
-        else if (r < 128 && r > 64)
+        else
         {
-            r = 128;
+            enqueueMatVec(kernels, buffer1, buffer2, buffer3, (unsigned int)(n / CALIBRATION_MATVEC_COLUMNS), CALIBRATION_MATVEC_COLUMNS, 1, 0, 0, 0, 0, NULL, NULL);
         }
-        else if (r < 256 && r > 128)
+        if (gpu.err != CL_SUCCESS)
         {
-            r = 256;
+            gpu.err = clFinish(gpu.queue);
+            return 1e30;
         }
+        gpu.err = clFinish(gpu.queue);
+        const double time = now() - start;
+        best = time < best ? time : best;
     }
-    else
+    return best;
+}
+/*!
+    @brief Builds the float kernels with a candidate config, the program is NULL if the build failed
+*/
+static cl_program buildTuned(const TuneConfig *config, Kernels *kernels)
+{
+    char options[128];
+    tuneOptions(config, options, sizeof(options));
+    cl_program program = buildProgram(kernel_code, options);
+    if (gpu.err != CL_SUCCESS)
     {
-        if (c < 32)
-        {
-            c = 32;
-        }
-        else if (c < 64 && c > 32)
-        {
-            c = 64;
-        }
-        else if (c < 128 && c > 64)
-        {
-            c = 128;
-        }
-        else if (c < 256 && c > 128)
+        clReleaseProgram(program);
+        return NULL;
+    }
+    createKernels(program, sizeof(cl_float), sizeof(cl_float), config->vectorWidth, config->dotTile, config->dotWork, kernels);
+    return program;
+}
+/*!
+    @brief Times every candidate on the current GPU and gives the fastest settings
+
+    @details
+    Every candidate vector width and tile size needs its own build of kernel_code, so those are tried one at a time with the other one at its default.
+    The work group sizes only change the launch, so they are tried with the kernels that are already built once the tuned program is picked.
+*/
+static void tuneConfig(TuneConfig *config)
+{
+    const int profiling = gpu.profiler.enabled;
+    gpu.profiler.enabled = 0;
+    const TuneConfig previous = gpu.tune;
+    defaultTuneConfig(config);
+    gpu.tune = *config;
+    const size_t n = CALIBRATION_ELEMENTS;
+    const size_t size = sizeof(float) * n;
+    float *host = malloc(size);
+    for (size_t i = 0; i < n; i++)
+    {
+        host[i] = 1.0f;
+    }
+    cl_mem buffer1 = acquireBuffer(size);
+    cl_mem buffer2 = acquireBuffer(size);
+    cl_mem buffer3 = acquireBuffer(size);
+    gpu.err = clEnqueueWriteBuffer(gpu.queue, buffer1, CL_TRUE, 0, size, host, 0, NULL, NULL);
+    gpu.err = clEnqueueWriteBuffer(gpu.queue, buffer2, CL_TRUE, 0, size, host, 0, NULL, NULL);
+
+    const unsigned int widths[4] = {2, 4, 8, 16};
+    double best = 1e30;
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        TuneConfig candidate = *config;
+        candidate.vectorWidth = widths[i];
+        Kernels kernels;
+        cl_program program = buildTuned(&candidate, &kernels);
+        if (program == NULL)
         {
-            c = 256;
+            continue;
         }
-        if (r < 32)
+        const double time = timeTuned(&kernels, TUNE_ADD, buffer1, buffer2, buffer3, n);
+        releaseKernels(&kernels);
+        clReleaseProgram(program);
+        if (time < best)
         {
-            r = 32;
+            best = time;
+            config->vectorWidth = widths[i];
         }
-        else if (r < 64 && r > 32)
+    }
+
+    best = 1e30;
+    for (unsigned int i = 0; i < DOT_TILE_CONFIGS; i++)
+    {
+        if (!validDotTile(dotTiles[i][0], dotTiles[i][1], dotTiles[i][2]))
         {
-            r = 64;
+            continue;
         }
-        else if (r < 128 && r > 64)
+        TuneConfig candidate = *config;
+        candidate.dotTile = dotTiles[i][0];
+        candidate.dotTileK = dotTiles[i][1];
+        candidate.dotWork = dotTiles[i][2];
+        Kernels kernels;
+        cl_program program = buildTuned(&candidate, &kernels);
+        if (program == NULL)
         {
-            r = 128;
+            continue;
         }
-        else if (r < 256 && r > 128)
+        const double time = timeTuned(&kernels, TUNE_DOT, buffer1, buffer2, buffer3, n);
+        releaseKernels(&kernels);
+        clReleaseProgram(program);
+        if (time < best)
         {
-            r = 256;
+            best = time;
+            config->dotTile = dotTiles[i][0];
+            config->dotTileK = dotTiles[i][1];
+            config->dotWork = dotTiles[i][2];
         }
     }
-    const size_t size = sizeof(float) * r * c;
-    *base_s1 = realloc(*base_s1, size);
-    *base_s2 = realloc(*base_s2, size);
-    *base_s3 = realloc(*base_s3, size);
-    gpu.buffers.s1 = clCreateBuffer(gpu.context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, size, NULL, &gpu.err);
-    gpu.buffers.s2 = clCreateBuffer(gpu.context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, size, NULL, &gpu.err);
-    gpu.buffers.s3 = clCreateBuffer(gpu.context, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR, size, NULL, &gpu.err);
-    gpu.err = clEnqueueWriteBuffer(gpu.queue, gpu.buffers.s1, CL_TRUE, 0, size, *base_s1, 0, NULL, &gpu.events.s1Write);
-    gpu.err = clEnqueueWriteBuffer(gpu.queue, gpu.buffers.s2, CL_TRUE, 0, size, *base_s2, 0, NULL, &gpu.events.s2Write);
-    const cl_event bufferEvents[2] = {gpu.events.s1Write, gpu.events.s2Write};
-    const unsigned int vals = r * c;
-    gpu.err = clWaitForEvents(2, bufferEvents);
-    gpu.err = clSetKernelArg(gpu.kernels.subtractFKernel, 0, sizeof(cl_mem), &gpu.buffers.s1);
-    gpu.err = clSetKernelArg(gpu.kernels.subtractFKernel, 1, sizeof(cl_mem), &gpu.buffers.s2);
-    gpu.err = clSetKernelArg(gpu.kernels.subtractFKernel, 2, sizeof(cl_mem), &gpu.buffers.s3);
-    gpu.err = clSetKernelArg(gpu.kernels.subtractFKernel, 3, sizeof(const unsigned int), &vals);
-    if (r == 1 || c == 1)
+
+    Kernels kernels;
+    cl_program program = buildTuned(config, &kernels);
+    if (program != NULL)
     {
-        size_t globalSize[1];
-        if (r == 1)
+        size_t elementwise_limit = gpu.maxWorkGroupSize;
+        size_t matvec_limit = gpu.maxWorkGroupSize;
+        gpu.err = clGetKernelWorkGroupInfo(kernels.addFKernel, gpu.device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &elementwise_limit, NULL);
+        gpu.err = clGetKernelWorkGroupInfo(kernels.matVecFkernel, gpu.device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &matvec_limit, NULL);
+        const unsigned int groups[4] = {32, 64, 128, 256};
+        for (unsigned int c = 0; c < TUNE_SIZE_CLASSES; c++)
         {
-            globalSize[0] = c;
+            double best_elementwise = 1e30;
+            double best_matvec = 1e30;
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                if (groups[i] <= elementwise_limit)
+                {
+                    gpu.tune.elementwiseGroup[c] = groups[i];
+                    const double time = timeTuned(&kernels, TUNE_ADD, buffer1, buffer2, buffer3, tuneElements[c]);
+                    if (time < best_elementwise)
+                    {
+                        best_elementwise = time;
+                        config->elementwiseGroup[c] = groups[i];
+                    }
+                }
+                if (groups[i] <= matvec_limit)
+                {
+                    gpu.tune.matVecGroup[c] = groups[i];
+                    const double time = timeTuned(&kernels, TUNE_MATVEC, buffer1, buffer2, buffer3, tuneElements[c]);
+                    if (time < best_matvec)
+                    {
+                        best_matvec = time;
+                        config->matVecGroup[c] = groups[i];
+                    }
+                }
+            }
+            gpu.tune.elementwiseGroup[c] = config->elementwiseGroup[c];
+            gpu.tune.matVecGroup[c] = config->matVecGroup[c];
         }
-        else
-        {
-            globalSize[0] = r;
-        }
-        const size_t localSize[1] = {32};
-        gpu.err = clEnqueueNDRangeKernel(gpu.queue, gpu.kernels.subtractFKernel, 1, NULL, globalSize, localSize, 0, NULL, &gpu.events.subtractFEvent);
+        releaseKernels(&kernels);
+        clReleaseProgram(program);
     }
-    else
+    config->tuned = 1;
+
+    releaseBuffer(buffer1);
+    releaseBuffer(buffer2);
+    releaseBuffer(buffer3);
+    free(host);
+    gpu.tune = previous;
+    gpu.profiler.enabled = profiling;
+}
+void tuneKernels()
+{
+    if (recordingHostOp(NULL))
     {
-        const size_t globalSize[2] = {r, c};
-        const size_t localSize[2] = {32, 32};
-        gpu.err = clEnqueueNDRangeKernel(gpu.queue, gpu.kernels.subtractFKernel, 1, NULL, globalSize, localSize, 0, NULL, &gpu.events.subtractFEvent);
+        return;
     }
-    gpu.err = clWaitForEvents(1, &gpu.events.subtractFEvent);
-    gpu.err = clEnqueueReadBuffer(gpu.queue, gpu.buffers.s3, CL_TRUE, 0, size, *base_s3, 0, NULL, &gpu.events.s3Write);
-    gpu.err = clWaitForEvents(1, &gpu.events.s3Write);
-
-    clReleaseMemObject(gpu.buffers.s1);
-    clReleaseMemObject(gpu.buffers.s2);
-    clReleaseMemObject(gpu.buffers.s3);
-    *base_s1 = realloc(*base_s1, old_size);
-    *base_s2 = realloc(*base_s2, old_size);
-    *base_s3 = realloc(*base_s3, old_size);
+    if (!gpu.hasDevice)
+    {
+        return;
+    }
+    TuneConfig config;
+    tuneConfig(&config);
+    Kernels kernels;
+    cl_program program = buildTuned(&config, &kernels);
+    if (program == NULL)
+    {
+        return;
+    }
+    gpu.err = clFinish(gpu.queue);
+    releaseKernels(&gpu.kernels);
+    clReleaseProgram(gpu.program);
+    gpu.program = program;
+    gpu.kernels = kernels;
+    gpu.tune = config;
+    saveTuneConfig(&config);
+    /* The rates of the old kernels no longer hold */
+    gpu.costs.calibrated = 0;
+}
+void getTuneConfig(TuneConfig *config)
+{
+    *config = gpu.tune;
 }
-void crossShapesF(float **base_s1, float **base_s2, float **base_s3, unsigned int r, unsigned int c)
+/*!
+    @brief Sets up the current GPU for a device, creating its context, queues and kernels
+*/
+static void initDevice(cl_platform_id platform, cl_device_id device)
 {
-    const size_t old_size = sizeof(float) * r * c;
-    if (r == 1)
+    gpu.platform = platform;
+    gpu.device = device;
+    gpu.hasDevice = CL_TRUE;
+    gpu.err = clGetDeviceInfo(gpu.device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &gpu.maxWorkGroupSize, NULL);
+    gpu.err = clGetDeviceInfo(gpu.device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &gpu.computeUnits, NULL);
+    cl_ulong global_mem_size = 0;
+    gpu.err = clGetDeviceInfo(gpu.device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), &global_mem_size, NULL);
+    gpu.pool.limit = global_mem_size / 4;
+    gpu.err = clGetDeviceInfo(gpu.device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &gpu.unifiedMemory, NULL);
+    gpu.context = clCreateContext(0, 1, &gpu.device, NULL, NULL, &gpu.err);
+    gpu.queue = clCreateCommandQueue(gpu.context, gpu.device, CL_QUEUE_PROFILING_ENABLE, &gpu.err);
+    gpu.uploadQueue = clCreateCommandQueue(gpu.context, gpu.device, CL_QUEUE_PROFILING_ENABLE, &gpu.err);
+    gpu.downloadQueue = clCreateCommandQueue(gpu.context, gpu.device, CL_QUEUE_PROFILING_ENABLE, &gpu.err);
+    char options[128];
+    defaultTuneConfig(&gpu.tune);
+    if (loadTuneConfig(&gpu.tune))
     {
-        if (c < 32)
-        {
-            c = 32;
-        }
-        else if (c < 64 && c > 32)
-        {
-            c = 64;
-        }
-        else if (c < 128 && c > 64)
-        {
-            c = 128;
-        }
-        else if (c < 256 && c > 128)
+        tuneOptions(&gpu.tune, options, sizeof(options));
+        gpu.program = buildProgram(kernel_code, options);
+        if (gpu.err != CL_SUCCESS)
         {
-            c = 256;
+            /* A saved config the driver no longer builds is dropped for the defaults */
+            clReleaseProgram(gpu.program);
+            defaultTuneConfig(&gpu.tune);
         }
     }
-    else if (c == 1)
+    if (!gpu.tune.tuned)
     {
-        if (r < 32)
-        {
-            r = 32;
-        }
-        else if (r < 64 && r > 32)
-        {
-            r = 64;
-        }
-        else if (r < 128 && r > 64)
-        {
-            r = 128;
-        }
-        else if (r < 256 && r > 128)
-        {
-            r = 256;
-        }
+        tuneOptions(&gpu.tune, options, sizeof(options));
+        gpu.program = buildProgram(kernel_code, options);
     }
-    else
+    createKernels(gpu.program, sizeof(cl_float), sizeof(cl_float), gpu.tune.vectorWidth, gpu.tune.dotTile, gpu.tune.dotWork, &gpu.kernels);
+    size_t extensions_size = 0;
+    gpu.err = clGetDeviceInfo(gpu.device, CL_DEVICE_EXTENSIONS, 0, NULL, &extensions_size);
+    char *extensions = calloc(extensions_size + 1, 1);
+    gpu.err = clGetDeviceInfo(gpu.device, CL_DEVICE_EXTENSIONS, extensions_size, extensions, NULL);
+    /* The double and half kernels are not tuned, but they use the default tile that fits on the GPU */
+    TuneConfig defaults;
+    defaultTuneConfig(&defaults);
+    char tile_options[96];
+    if (strstr(extensions, "cl_khr_fp64") != NULL)
     {
-        if (c < 32)
-        {
-            c = 32;
-        }
-        else if (c < 64 && c > 32)
-        {
-            c = 64;
-        }
-        else if (c < 128 && c > 64)
-        {
-            c = 128;
-        }
-        else if (c < 256 && c > 128)
-        {
-            c = 256;
-        }
-        if (r < 32)
-        {
-            r = 32;
-        }
-        else if (r < 64 && r > 32)
-        {
-            r = 64;
-        }
-        else if (r < 128 && r > 64)
-        {
-            r = 128;
-        }
-        else if (r < 256 && r > 128)
-        {
-            r = 256;
-        }
+        defaults.vectorWidth = vectorWidth(CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE);
+        tuneOptions(&defaults, tile_options, sizeof(tile_options));
+        snprintf(options, sizeof(options), "-DPRECISION_DOUBLE %s", tile_options);
+        gpu.programD = buildProgram(kernel_code, options);
+        createKernels(gpu.programD, sizeof(cl_double), sizeof(cl_double), defaults.vectorWidth, defaults.dotTile, defaults.dotWork, &gpu.kernelsD);
     }
-    const size_t size = sizeof(float) * r * c;
-    *base_s1 = realloc(*base_s1, size);
-    *base_s2 = realloc(*base_s2, size);
-    *base_s3 = realloc(*base_s3, size);
-    gpu.buffers.s1 = clCreateBuffer(gpu.context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, size, NULL, &gpu.err);
-    gpu.buffers.s2 = clCreateBuffer(gpu.context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, size, NULL, &gpu.err);
-    gpu.buffers.s3 = clCreateBuffer(gpu.context, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR, size, NULL, &gpu.err);
-    gpu.err = clEnqueueWriteBuffer(gpu.queue, gpu.buffers.s1, CL_TRUE, 0, size, *base_s1, 0, NULL, &gpu.events.s1Write);
-    gpu.err = clEnqueueWriteBuffer(gpu.queue, gpu.buffers.s2, CL_TRUE, 0, size, *base_s2, 0, NULL, &gpu.events.s2Write);
-    const cl_event bufferEvents[2] = {gpu.events.s1Write, gpu.events.s2Write};
-    const unsigned int vals = r * c;
-    gpu.err = clWaitForEvents(2, bufferEvents);
-    gpu.err = clSetKernelArg(gpu.kernels.crossFKernel, 0, sizeof(cl_mem), &gpu.buffers.s1);
-    gpu.err = clSetKernelArg(gpu.kernels.crossFKernel, 1, sizeof(cl_mem), &gpu.buffers.s2);
-    gpu.err = clSetKernelArg(gpu.kernels.crossFKernel, 2, sizeof(cl_mem), &gpu.buffers.s3);
-    gpu.err = clSetKernelArg(gpu.kernels.crossFKernel, 3, sizeof(const unsigned int), &vals);
-    if (r == 1 || c == 1)
+    if (strstr(extensions, "cl_khr_fp16") != NULL)
     {
-        size_t globalSize[1];
-        if (r == 1)
-        {
-            globalSize[0] = c;
-        }
-        else
-        {
-            globalSize[0] = r;
-        }
-        const size_t localSize[1] = {32};
-        gpu.err = clEnqueueNDRangeKernel(gpu.queue, gpu.kernels.crossFKernel, 1, NULL, globalSize, localSize, 0, NULL, &gpu.events.crossFEvent);
+        defaults.vectorWidth = vectorWidth(CL_DEVICE_PREFERRED_VECTOR_WIDTH_HALF);
+        tuneOptions(&defaults, tile_options, sizeof(tile_options));
+        snprintf(options, sizeof(options), "-DPRECISION_HALF %s", tile_options);
+        gpu.programH = buildProgram(kernel_code, options);
+        createKernels(gpu.programH, sizeof(cl_half), sizeof(cl_float), defaults.vectorWidth, defaults.dotTile, defaults.dotWork, &gpu.kernelsH);
     }
-    else
+    free(extensions);
+    if (!gpu.tune.tuned && getenv("LINEARALGEBRA_TUNE") != NULL)
     {
-        const size_t globalSize[2] = {r, c};
-        const size_t localSize[2] = {32, 32};
-        gpu.err = clEnqueueNDRangeKernel(gpu.queue, gpu.kernels.crossFKernel, 1, NULL, globalSize, localSize, 0, NULL, &gpu.events.crossFEvent);
+        tuneKernels();
     }
-    gpu.err = clWaitForEvents(1, &gpu.events.crossFEvent);
-    gpu.err = clEnqueueReadBuffer(gpu.queue, gpu.buffers.s3, CL_TRUE, 0, size, *base_s3, 0, NULL, &gpu.events.s3Write);
-    gpu.err = clWaitForEvents(1, &gpu.events.s3Write);
-
-    clReleaseMemObject(gpu.buffers.s1);
-    clReleaseMemObject(gpu.buffers.s2);
-    clReleaseMemObject(gpu.buffers.s3);
-    *base_s1 = realloc(*base_s1, old_size);
-    *base_s2 = realloc(*base_s2, old_size);
-    *base_s3 = realloc(*base_s3, old_size);
 }
-void divideShapesF(float **base_s1, float **base_s2, float **base_s3, unsigned int r, unsigned int c)
+void gpuInit()
 {
-    const size_t old_size = sizeof(float) * r * c;
-    if (r == 1)
+    cpuInit();
+    memset(devices, 0, sizeof(devices));
+    deviceCount = 0;
+    cl_uint platform_count = 0;
+    cl_platform_id platforms[MAX_DEVICES];
+    if (clGetPlatformIDs(MAX_DEVICES, platforms, &platform_count) != CL_SUCCESS)
     {
-        if (c < 32)
-        {
-            c = 32;
-        }
-        else if (c < 64 && c > 32)
-        {
-            c = 64;
-        }
-        else if (c < 128 && c > 64)
-        {
-            c = 128;
-        }
-        else if (c < 256 && c > 128)
-        {
-            c = 256;
-        }
+        platform_count = 0;
     }
-    else if (c == 1)
+    for (cl_uint i = 0; i < platform_count && i < MAX_DEVICES; i++)
     {
-        if (r < 32)
-        {
-            r = 32;
-        }
-        else if (r < 64 && r > 32)
-        {
-            r = 64;
-        }
-        else if (r < 128 && r > 64)
+        cl_uint count = 0;
+        cl_device_id ids[MAX_DEVICES];
+        if (clGetDeviceIDs(platforms[i], CL_DEVICE_TYPE_GPU, MAX_DEVICES - deviceCount, ids, &count) != CL_SUCCESS)
         {
-            r = 128;
+            continue;
         }
-        else if (r < 256 && r > 128)
+        for (cl_uint j = 0; j < count && deviceCount < MAX_DEVICES; j++)
         {
-            r = 256;
+            current = &devices[deviceCount++];
+            initDevice(platforms[i], ids[j]);
         }
     }
-    else
+    /* Without a GPU devices[0] stays empty and every float operation on host shapes runs on the CPU backend instead */
+    current = &devices[0];
+}
+/*!
+    @brief Releases everything the current GPU holds
+*/
+static void cleanDevice()
+{
+    if (gpu.deferred != NULL && gpu.deferred->pending > 0)
     {
-        if (c < 32)
-        {
-            c = 32;
-        }
-        else if (c < 64 && c > 32)
-        {
-            c = 64;
-        }
-        else if (c < 128 && c > 64)
-        {
-            c = 128;
-        }
-        else if (c < 256 && c > 128)
-        {
-            c = 256;
-        }
-        if (r < 32)
-        {
-            r = 32;
-        }
-        else if (r < 64 && r > 32)
-        {
-            r = 64;
-        }
-        else if (r < 128 && r > 64)
-        {
-            r = 128;
-        }
-        else if (r < 256 && r > 128)
+        clFinish(gpu.queue);
+        clFinish(gpu.uploadQueue);
+        clFinish(gpu.downloadQueue);
+        for (unsigned int waited = 0; gpu.deferred->pending > 0 && waited < DEFERRED_CHECK_TIMEOUT; waited++)
         {
-            r = 256;
+            sleepMilliseconds(1);
         }
     }
-    const size_t size = sizeof(float) * r * c;
-    *base_s1 = realloc(*base_s1, size);
-    *base_s2 = realloc(*base_s2, size);
-    *base_s3 = realloc(*base_s3, size);
-    gpu.buffers.s1 = clCreateBuffer(gpu.context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, size, NULL, &gpu.err);
-    gpu.buffers.s2 = clCreateBuffer(gpu.context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, size, NULL, &gpu.err);
-    gpu.buffers.s3 = clCreateBuffer(gpu.context, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR, size, NULL, &gpu.err);
-    gpu.err = clEnqueueWriteBuffer(gpu.queue, gpu.buffers.s1, CL_TRUE, 0, size, *base_s1, 0, NULL, &gpu.events.s1Write);
-    gpu.err = clEnqueueWriteBuffer(gpu.queue, gpu.buffers.s2, CL_TRUE, 0, size, *base_s2, 0, NULL, &gpu.events.s2Write);
-    const cl_event bufferEvents[2] = {gpu.events.s1Write, gpu.events.s2Write};
-    const unsigned int vals = r * c;
-    gpu.err = clWaitForEvents(2, bufferEvents);
-    gpu.err = clSetKernelArg(gpu.kernels.divideFKernel, 0, sizeof(cl_mem), &gpu.buffers.s1);
-    gpu.err = clSetKernelArg(gpu.kernels.divideFKernel, 1, sizeof(cl_mem), &gpu.buffers.s2);
-    gpu.err = clSetKernelArg(gpu.kernels.divideFKernel, 2, sizeof(cl_mem), &gpu.buffers.s3);
-    gpu.err = clSetKernelArg(gpu.kernels.divideFKernel, 3, sizeof(const unsigned int), &vals);
-    if (r == 1 || c == 1)
+    /* Callbacks the driver has still not delivered would write to freed memory, so then the checks are left allocated */
+    if (gpu.deferred != NULL && gpu.deferred->pending <= 0)
     {
-        size_t globalSize[1];
-        if (r == 1)
-        {
-            globalSize[0] = c;
-        }
-        else
+        free(gpu.deferred);
+    }
+    if (gpu.graph != NULL)
+    {
+        CommandGraph *graph = gpu.graph;
+        gpu.graph = NULL;
+        releaseCommandGraph(graph);
+    }
+    releaseKernels(&gpu.kernels);
+    clReleaseProgram(gpu.program);
+    if (gpu.programD != NULL)
+    {
+        releaseKernels(&gpu.kernelsD);
+        clReleaseProgram(gpu.programD);
+        gpu.programD = NULL;
+    }
+    if (gpu.programH != NULL)
+    {
+        releaseKernels(&gpu.kernelsH);
+        clReleaseProgram(gpu.programH);
+        gpu.programH = NULL;
+    }
+    for (unsigned int i = 0; i < gpu.fusedCount; i++)
+    {
+        if (gpu.fusedKernels[i].kernel != NULL)
         {
-            globalSize[0] = r;
+            clReleaseKernel(gpu.fusedKernels[i].kernel);
+            clReleaseProgram(gpu.fusedKernels[i].program);
         }
-        const size_t localSize[1] = {32};
-        gpu.err = clEnqueueNDRangeKernel(gpu.queue, gpu.kernels.divideFKernel, 1, NULL, globalSize, localSize, 0, NULL, &gpu.events.divideFEvent);
+        free(gpu.fusedKernels[i].source);
     }
-    else
+    free(gpu.fusedKernels);
+    gpu.fusedKernels = NULL;
+    gpu.fusedCount = 0;
+    clearProfiler();
+    gpu.profiler.enabled = 0;
+    trimBufferPool();
+    for (unsigned int i = 0; i < BUFFER_POOL_BUCKETS; i++)
     {
-        const size_t globalSize[2] = {r, c};
-        const size_t localSize[2] = {32, 32};
-        gpu.err = clEnqueueNDRangeKernel(gpu.queue, gpu.kernels.divideFKernel, 1, NULL, globalSize, localSize, 0, NULL, &gpu.events.divideFEvent);
+        free(gpu.pool.buffers[i]);
+        gpu.pool.buffers[i] = NULL;
+        gpu.pool.capacities[i] = 0;
     }
-    gpu.err = clWaitForEvents(1, &gpu.events.divideFEvent);
-    gpu.err = clEnqueueReadBuffer(gpu.queue, gpu.buffers.s3, CL_TRUE, 0, size, *base_s3, 0, NULL, &gpu.events.s3Write);
-    gpu.err = clWaitForEvents(1, &gpu.events.s3Write);
-
-    clReleaseMemObject(gpu.buffers.s1);
-    clReleaseMemObject(gpu.buffers.s2);
-    clReleaseMemObject(gpu.buffers.s3);
-    *base_s1 = realloc(*base_s1, old_size);
-    *base_s2 = realloc(*base_s2, old_size);
-    *base_s3 = realloc(*base_s3, old_size);
-}
-void dotMatricesF(const float *s1, const float *s2, float *s3, const unsigned int r, const unsigned int c, const unsigned int c2)
-{
-    const size_t size1 = sizeof(float) * r * c;
-    const size_t size2 = sizeof(float) * c * c2;
-    const size_t size3 = sizeof(float) * r * c2;
-    gpu.buffers.s1 = clCreateBuffer(gpu.context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, size1, NULL, &gpu.err);
-    checkError();
-    gpu.buffers.s2 = clCreateBuffer(gpu.context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, size2, NULL, &gpu.err);
-    checkError();
-    gpu.buffers.s3 = clCreateBuffer(gpu.context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, size3, NULL, &gpu.err);
-    checkError();
-    gpu.err = clEnqueueWriteBuffer(gpu.queue, gpu.buffers.s1, CL_TRUE, 0, size1, s1, 0, NULL, &gpu.events.s1Write);
-    checkError();
-    gpu.err = clEnqueueWriteBuffer(gpu.queue, gpu.buffers.s2, CL_TRUE, 0, size2, s2, 0, NULL, &gpu.events.s2Write);
-    checkError();
-    cl_event bufferEvents[2] = {gpu.events.s1Write, gpu.events.s2Write};
-    gpu.err = clWaitForEvents(2, bufferEvents);
-    checkError();
-    gpu.err = clSetKernelArg(gpu.kernels.dotFKernel, 0, sizeof(cl_mem), &gpu.buffers.s1);
-    checkError();
-    gpu.err = clSetKernelArg(gpu.kernels.dotFKernel, 1, sizeof(cl_mem), &gpu.buffers.s2);
-    checkError();
-    gpu.err = clSetKernelArg(gpu.kernels.dotFKernel, 2, sizeof(cl_mem), &gpu.buffers.s3);
-    checkError();
-    gpu.err = clSetKernelArg(gpu.kernels.dotFKernel, 3, sizeof(float) * c, NULL);
-    checkError();
-    gpu.err = clSetKernelArg(gpu.kernels.dotFKernel, 4, sizeof(const unsigned int), &r);
-    checkError();
-    gpu.err = clSetKernelArg(gpu.kernels.dotFKernel, 5, sizeof(const unsigned int), &c);
-    checkError();
-    gpu.err = clSetKernelArg(gpu.kernels.dotFKernel, 6, sizeof(const unsigned int), &c2);
-    checkError();
-    const size_t global_work_size[3] = {r, c, c2};
-    const size_t local_work_size[3] = {1, c, 1};
-    gpu.err = clEnqueueNDRangeKernel(gpu.queue, gpu.kernels.dotFKernel, 3, NULL, global_work_size, local_work_size, 0, NULL, &gpu.events.dotFEvent);
-    checkError();
-    gpu.err = clWaitForEvents(1, &gpu.events.dotFEvent);
-    checkError();
-    gpu.err = clEnqueueReadBuffer(gpu.queue, gpu.buffers.s3, CL_TRUE, 0, size3, s3, 0, NULL, &gpu.events.s3Write);
-    checkError();
-    gpu.err = clWaitForEvents(1, &gpu.events.s3Write);
-    checkError();
-
-    clReleaseMemObject(gpu.buffers.s1);
-    clReleaseMemObject(gpu.buffers.s2);
-    clReleaseMemObject(gpu.buffers.s3);
-}
-void matVecF(float **base_s1, float **base_s2, float **base_s3, unsigned int r, unsigned int c)
-{
-    const size_t matrix_size = sizeof(float) * r * c;
-    const size_t vector_size = sizeof(float) * r;
-    gpu.buffers.s1 = clCreateBuffer(gpu.context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, matrix_size, NULL, &gpu.err);
-    gpu.buffers.s2 = clCreateBuffer(gpu.context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, vector_size, NULL, &gpu.err);
-    gpu.buffers.s3 = clCreateBuffer(gpu.context, CL_MEM_WRITE_ONLY | CL_MEM_ALLOC_HOST_PTR, vector_size, NULL, &gpu.err);
-    gpu.err = clEnqueueWriteBuffer(gpu.queue, gpu.buffers.s1, CL_TRUE, 0, matrix_size, *base_s1, 0, NULL, &gpu.events.s1Write);
-    gpu.err = clEnqueueWriteBuffer(gpu.queue, gpu.buffers.s2, CL_TRUE, 0, vector_size, *base_s2, 0, NULL, &gpu.events.s2Write);
-    const cl_event bufferEvents[2] = {gpu.events.s1Write, gpu.events.s2Write};
-    gpu.err = clWaitForEvents(2, bufferEvents);
-    gpu.err = clSetKernelArg(gpu.kernels.matVecFkernel, 0, sizeof(cl_mem), &gpu.buffers.s1);
-    gpu.err = clSetKernelArg(gpu.kernels.matVecFkernel, 1, sizeof(cl_mem), &gpu.buffers.s2);
-    gpu.err = clSetKernelArg(gpu.kernels.matVecFkernel, 2, sizeof(cl_mem), &gpu.buffers.s3);
-    gpu.err = clSetKernelArg(gpu.kernels.matVecFkernel, 3, sizeof(float) * c, NULL);
-    gpu.err = clSetKernelArg(gpu.kernels.matVecFkernel, 4, sizeof(const unsigned int), &r);
-    gpu.err = clSetKernelArg(gpu.kernels.matVecFkernel, 5, sizeof(const unsigned int), &c);
-    const size_t global_work_size[2] = {r, c};
-    const size_t local_work_size[2] = {1, c};
-    gpu.err = clEnqueueNDRangeKernel(gpu.queue, gpu.kernels.matVecFkernel, 2, NULL, global_work_size, local_work_size, 0, NULL, &gpu.events.matVecFEvent);
-    gpu.err = clWaitForEvents(1, &gpu.events.matVecFEvent);
-    gpu.err = clEnqueueReadBuffer(gpu.queue, gpu.buffers.s3, CL_TRUE, 0, vector_size, *base_s3, 0, NULL, &gpu.events.s3Write);
-    gpu.err = clWaitForEvents(1, &gpu.events.s3Write);
-
-    clReleaseMemObject(gpu.buffers.s1);
-    clReleaseMemObject(gpu.buffers.s2);
-    clReleaseMemObject(gpu.buffers.s3);
+    clReleaseCommandQueue(gpu.queue);
+    clReleaseCommandQueue(gpu.uploadQueue);
+    clReleaseCommandQueue(gpu.downloadQueue);
+    clReleaseContext(gpu.context);
+    clReleaseDevice(gpu.device);
+    free(gpu.buildLog);
+    memset(&gpu, 0, sizeof(GPU));
 }
-float *createShapeF(const unsigned int n, const float fill_val)
+void gpuClean()
 {
-    size_t size = sizeof(float) * n;
-    float *s1 = malloc(size);
-    for (int i = 0; i < n; i++)
+    cpuClean();
+    for (unsigned int i = 0; i < deviceCount; i++)
     {
-        s1[i] = fill_val;
+        current = &devices[i];
+        cleanDevice();
     }
-    return s1;
+    deviceCount = 0;
+    multiDevice = 0;
+    current = &devices[0];
 }
-void gpuInit()
+GPU *gpuCreateContext(GPU *device)
 {
-    gpu.err = clGetPlatformIDs(1, &gpu.platform, NULL);
-    gpu.err = clGetDeviceIDs(gpu.platform, CL_DEVICE_TYPE_GPU, 1, &gpu.device, NULL);
-    gpu.context = clCreateContext(0, 1, &gpu.device, NULL, NULL, &gpu.err);
+    if (device == NULL || !device->hasDevice)
+    {
+        return NULL;
+    }
+    GPU *context = calloc(1, sizeof(GPU));
+    if (context == NULL)
+    {
+        return NULL;
+    }
+    GPU *caller = current;
+    /* The device is calibrated first so contexts made at the same time do not all measure it and write its cost model file */
+    current = device;
+    CostModel costs;
+    getCostModel(&costs);
+    current = context;
+    /* Everything OpenCL lets threads share is retained, the queues and kernels which it does not are created again */
+    gpu.platform = device->platform;
+    gpu.device = device->device;
+    gpu.context = device->context;
+    gpu.program = device->program;
+    gpu.programD = device->programD;
+    gpu.programH = device->programH;
+    clRetainDevice(gpu.device);
+    clRetainContext(gpu.context);
+    clRetainProgram(gpu.program);
+    gpu.maxWorkGroupSize = device->maxWorkGroupSize;
+    gpu.computeUnits = device->computeUnits;
+    gpu.unifiedMemory = device->unifiedMemory;
+    gpu.hasDevice = CL_TRUE;
+    gpu.pool.limit = device->pool.limit;
+    gpu.costs = costs;
+    gpu.tune = device->tune;
+    gpu.dispatchMode = device->dispatchMode;
     gpu.queue = clCreateCommandQueue(gpu.context, gpu.device, CL_QUEUE_PROFILING_ENABLE, &gpu.err);
-    gpu.program = clCreateProgramWithSource(gpu.context, 1, (const char **)&kernel_code, NULL, &gpu.err);
-    clBuildProgram(gpu.program, 0, NULL, NULL, NULL, NULL);
-    gpu.kernels.addFKernel = clCreateKernel(gpu.program, "addShapesF", &gpu.err);
-    gpu.kernels.subtractFKernel = clCreateKernel(gpu.program, "subtractShapesF", &gpu.err);
-    gpu.kernels.crossFKernel = clCreateKernel(gpu.program, "crossShapesF", &gpu.err);
-    gpu.kernels.divideFKernel = clCreateKernel(gpu.program, "divideShapesF", &gpu.err);
-    gpu.kernels.dotFKernel = clCreateKernel(gpu.program, "dotMatricesF", &gpu.err);
-    gpu.kernels.matVecFkernel = clCreateKernel(gpu.program, "MatrixFMulVecF", &gpu.err);
+    gpu.uploadQueue = clCreateCommandQueue(gpu.context, gpu.device, CL_QUEUE_PROFILING_ENABLE, &gpu.err);
+    gpu.downloadQueue = clCreateCommandQueue(gpu.context, gpu.device, CL_QUEUE_PROFILING_ENABLE, &gpu.err);
+    createKernels(gpu.program, device->kernels.elementSize, device->kernels.accumulatorSize, device->kernels.vectorWidth, device->kernels.dotTile, device->kernels.dotWork, &gpu.kernels);
+    if (gpu.programD != NULL)
+    {
+        clRetainProgram(gpu.programD);
+        createKernels(gpu.programD, device->kernelsD.elementSize, device->kernelsD.accumulatorSize, device->kernelsD.vectorWidth, device->kernelsD.dotTile, device->kernelsD.dotWork, &gpu.kernelsD);
+    }
+    if (gpu.programH != NULL)
+    {
+        clRetainProgram(gpu.programH);
+        createKernels(gpu.programH, device->kernelsH.elementSize, device->kernelsH.accumulatorSize, device->kernelsH.vectorWidth, device->kernelsH.dotTile, device->kernelsH.dotWork, &gpu.kernelsH);
+    }
+    current = caller;
+    return context;
 }
-void gpuClean()
+void gpuReleaseContext(GPU *context)
 {
-    clReleaseKernel(gpu.kernels.addFKernel);
-    clReleaseKernel(gpu.kernels.subtractFKernel);
-    clReleaseKernel(gpu.kernels.crossFKernel);
-    clReleaseKernel(gpu.kernels.divideFKernel);
-    clReleaseKernel(gpu.kernels.dotFKernel);
-    clReleaseKernel(gpu.kernels.matVecFkernel);
-    clReleaseEvent(gpu.events.addFEvent);
-    clReleaseEvent(gpu.events.crossFEvent);
-    clReleaseEvent(gpu.events.subtractFEvent);
-    clReleaseEvent(gpu.events.crossFEvent);
-    clReleaseEvent(gpu.events.dotFEvent);
-    clReleaseEvent(gpu.events.matVecFEvent);
-    clReleaseEvent(gpu.events.s1Write);
-    clReleaseEvent(gpu.events.s2Write);
-    clReleaseEvent(gpu.events.s3Write);
-    clReleaseProgram(gpu.program);
-    clReleaseCommandQueue(gpu.queue);
-    clReleaseContext(gpu.context);
-    clReleaseDevice(gpu.device);
+    if (context == NULL)
+    {
+        return;
+    }
+    GPU *caller = current;
+    current = context;
+    cleanDevice();
+    current = caller == context ? &devices[0] : caller;
+    free(context);
 }